@@ -20,7 +20,7 @@ TMP_DIR       := $(TMP_ARCH_DIR)/$(CFG_DIR)/$(PROJECT)
 PCH_DIR       := $(TMP_DIR)/$(PROJECT).gch
 DEFINES       := $(CONFIG) -DTIXML_USE_STL -DSCI_NAMESPACE
 LFLAGS        := -Wl,-rpath,\$$ORIGIN,-rpath-link,$(QT_DIR)/lib
-LIBS          := $(SDK_LIBS) -L$(QT_DIR)/lib -lQt5Gui -lQt5Core -lQt5Help -lQt5Widgets -Wl,--no-as-needed  -L../bin -lVMProtectSDK$(ARCH_DIR) -ldl -Wl,--as-needed
+LIBS          := $(SDK_LIBS) -L$(QT_DIR)/lib -lQt5Gui -lQt5Core -lQt5Help -lQt5Widgets -Wl,--no-as-needed  -L../bin -lVMProtectSDK$(ARCH_DIR) -ldl -Wl,--as-needed -lpthread
 OBJCOMP       := ../bin/$(ARCH_DIR)/$(CFG_DIR)/core.a ../bin/$(ARCH_DIR)/invariant_core.a ../third-party/libffi/libffi$(ARCH_DIR).a /usr/lib/$(ARCH)/libcrypto.a
 DYLIBS        :=
 PCH_DIR       := $(TMP_DIR)
@@ -78,7 +78,9 @@ MainWindow::MainWindow()
 
 	project_model_ = new ProjectModel(this);
 	connect(project_model_, SIGNAL(modified()), this, SLOT(projectModified()));
+	connect(project_model_, SIGNAL(nodeUpdated(ProjectNode *)), this, SLOT(projectNodeUpdated(ProjectNode *)));
 	connect(project_model_, SIGNAL(nodeRemoved(ProjectNode *)), this, SLOT(projectNodeRemoved(ProjectNode *)));
+	connect(project_model_, SIGNAL(rowsInserted(const QModelIndex &, int, int)), this, SLOT(projectRowsInserted(const QModelIndex &, int, int)));
 	connect(project_model_, SIGNAL(objectRemoved(void *)), this, SLOT(projectObjectRemoved(void *)));
 
 	search_model_ = new SearchModel(this);
@@ -88,8 +90,10 @@ MainWindow::MainWindow()
 	core_property_manager_ = new CorePropertyManager(this);
 #ifndef LITE
 	functions_model_ = new FunctionsModel(this);
+	connect(functions_model_, SIGNAL(nodeUpdated(ProjectNode *)), this, SLOT(projectNodeUpdated(ProjectNode *)));
 	info_model_ = new InfoModel(this);
 	connect(info_model_, SIGNAL(modified()), this, SLOT(projectModified()));
+	connect(info_model_, SIGNAL(nodeUpdated(ProjectNode *)), this, SLOT(projectNodeUpdated(ProjectNode *)));
 
 	dump_model_ = new DumpModel(this);
 	disasm_model_ = new DisasmModel(this);
@@ -1286,6 +1290,7 @@ void MainWindow::localize()
 	internal_file_property_manager_->localize();
 	assembly_property_manager_->localize();
 #endif
+	search_model_->resetIndex();
 }
 
 void MainWindow::dragEnterEvent(QDragEnterEvent *event)
@@ -1416,6 +1421,7 @@ void MainWindow::loadFile(const QString &filename)
 	info_model_->setCore(core_);
 	info_tree_->setCurrentIndex(info_model_->index(0, 0));
 #endif
+	search_model_->resetIndex();
 
 	script_editor_->setText(QString(core_->script()->text().c_str()));
 	connect(script_editor_, SIGNAL(notify(SCNotification *)), this, SLOT(scriptNotify(SCNotification *)));
@@ -1805,12 +1811,24 @@ void MainWindow::projectModified()
 	updateCaption();
 }
 
+void MainWindow::projectNodeUpdated(ProjectNode *node)
+{
+	search_model_->updateNode(node);
+}
+
 void MainWindow::projectNodeRemoved(ProjectNode *node)
 {
 	directory_model_->removeNode(node);
 	search_model_->removeNode(node);
 }
 
+void MainWindow::projectRowsInserted(const QModelIndex &parent, int first, int last)
+{
+	for (int i = first; i <= last; i++) {
+		search_model_->updateNode(project_model_->indexToNode(project_model_->index(i, 0, parent)));
+	}
+}
+
 void MainWindow::projectObjectRemoved(void *object)
 {
 	if (function_property_manager_->value() && function_property_manager_->value() == object)
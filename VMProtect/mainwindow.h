@@ -80,7 +80,9 @@ private slots:
 	void help();
 	void about();
 	void projectModified();
+	void projectNodeUpdated(ProjectNode *node);
 	void projectNodeRemoved(ProjectNode *node);
+	void projectRowsInserted(const QModelIndex &parent, int first, int last);
 	void projectObjectRemoved(void *object);
 	void compile();
 	void execute();
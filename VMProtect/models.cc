@@ -2221,7 +2221,7 @@ QVariant InfoModel::headerData(int section, Qt::Orientation /*orientation*/, int
  */
 
 SearchModel::SearchModel(QObject *parent)
-	: QAbstractItemModel(parent)
+	: QAbstractItemModel(parent), indexRoot_(NULL)
 {
 
 }
@@ -2230,15 +2230,43 @@ void SearchModel::clear()
 {
 	if (items_.count())
 		removeRows(0, items_.count());
+	resetIndex();
 }
 
-void SearchModel::search(ProjectNode *directory, const QString &text, bool protectedFunctionsOnly)
+void SearchModel::resetIndex()
+{
+	indexRoot_ = NULL;
+	index_.clear();
+	volatileNodes_.clear();
+}
+
+void SearchModel::indexNode(ProjectNode *node)
+{
+	QString text = node->text(0) + '\n' + node->text(1);
+	index_.Add(node, text.toUtf8().constData());
+	// the second column of these nodes is the script or a property value, it changes without notifications
+	switch (node->type()) {
+	case NODE_SCRIPT:
+	case NODE_SCRIPT_BOOKMARK:
+	case NODE_PROPERTY:
+		if (!volatileNodes_.contains(node))
+			volatileNodes_.append(node);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Nodes are indexed in the order of the tree walk, so results keep the tree order. Later changes
+ * come from updateNode/removeNode.
+ */
+void SearchModel::buildIndex(ProjectNode *directory)
 {
-	beginResetModel();
 	QList<ProjectNode *> list;
-	QRegExp filter(text, Qt::CaseInsensitive, QRegExp::Wildcard);
 
-	items_.clear();
+	resetIndex();
+	indexRoot_ = directory;
 	list.append(directory);
 	for (int i = 0; i < list.count(); i++) {
 		ProjectNode *node = list[i];
@@ -2249,7 +2277,27 @@ void SearchModel::search(ProjectNode *directory, const QString &text, bool prote
 		if (node->properties())
 			list.insert(i + 1, node->properties());
 
-		if (node->parent() && node->contains(filter)) {
+		if (node->parent())
+			indexNode(node);
+	}
+}
+
+void SearchModel::search(ProjectNode *directory, const QString &text, bool protectedFunctionsOnly)
+{
+	beginResetModel();
+	QRegExp filter(text, Qt::CaseInsensitive, QRegExp::Wildcard);
+
+	items_.clear();
+	if (indexRoot_ != directory)
+		buildIndex(directory);
+	for (int i = 0; i < volatileNodes_.count(); i++) {
+		indexNode(volatileNodes_[i]);
+	}
+
+	std::vector<const void *> list = index_.Find(text.toUtf8().constData());
+	for (size_t i = 0; i < list.size(); i++) {
+		ProjectNode *node = static_cast<ProjectNode *>(const_cast<void *>(list[i]));
+		if (node->contains(filter)) {
 			if (protectedFunctionsOnly) {
 				switch (node->type()) {
 				case NODE_MAP_FUNCTION:
@@ -2354,6 +2402,22 @@ QModelIndex SearchModel::nodeToIndex(ProjectNode *node) const
 
 void SearchModel::updateNode(ProjectNode *node)
 {
+	if (indexRoot_) {
+		ProjectNode *parent = node->parent();
+		while (parent && parent != indexRoot_) {
+			parent = parent->parent();
+		}
+		if (parent) {
+			// new nodes come here too, index them with their children
+			QList<ProjectNode *> list;
+			list.append(node);
+			for (int j = 0; j < list.count(); j++) {
+				indexNode(list[j]);
+				list.append(list[j]->children());
+			}
+		}
+	}
+
 	int i = items_.indexOf(node);
 	if (i == -1)
 		return;
@@ -2381,6 +2445,16 @@ bool SearchModel::removeRows(int position, int rows, const QModelIndex &parent)
 
 void SearchModel::removeNode(ProjectNode *node)
 {
+	if (indexRoot_) {
+		QList<ProjectNode *> list;
+		list.append(node);
+		for (int j = 0; j < list.count(); j++) {
+			index_.Remove(list[j]);
+			volatileNodes_.removeOne(list[j]);
+			list.append(list[j]->children());
+		}
+	}
+
 	int i = items_.indexOf(node);
 	if (i == -1)
 		return;
@@ -251,9 +251,15 @@ public:
 	void updateNode(ProjectNode *node);
 	void removeNode(ProjectNode *node);
 	void clear();
+	void resetIndex();
 	ProjectNode *indexToNode(const QModelIndex &index) const;
 private:
+	void buildIndex(ProjectNode *directory);
+	void indexNode(ProjectNode *node);
 	QList<ProjectNode *> items_;
+	ProjectNode *indexRoot_;
+	SearchIndex index_;
+	QList<ProjectNode *> volatileNodes_;
 };
 
 class DirectoryModel : public QAbstractItemModel, public IProjectNodesModel
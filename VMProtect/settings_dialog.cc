@@ -47,6 +47,13 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 	autoSaveEdit_->setFrame(false);
 	autoSaveEdit_->setObjectName("editor");
 
+	QLabel *analysisCacheLabel = new QLabel(QString::fromUtf8(language[lsAnalysisCache].c_str()), this);
+	analysisCacheLabel->setObjectName("editor");
+
+	analysisCacheEdit_ = new BoolEdit(this);
+	analysisCacheEdit_->setFrame(false);
+	analysisCacheEdit_->setObjectName("editor");
+
 	QGridLayout *layout = new QGridLayout();
 	layout->setContentsMargins(0, 0, 0, 0);
 	layout->setHorizontalSpacing(0);
@@ -58,6 +65,8 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 	layout->addWidget(languageEdit_, 0, 1);
 	layout->addWidget(autoSaveLabel, 1, 0);
 	layout->addWidget(autoSaveEdit_, 1, 1);
+	layout->addWidget(analysisCacheLabel, 2, 0);
+	layout->addWidget(analysisCacheEdit_, 2, 1);
 	group->setLayout(layout);
 
 	QToolButton *helpButton = new QToolButton(this);
@@ -95,6 +104,7 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 
 	languageEdit_->setCurrentIndex((int)lang_index);
 	autoSaveEdit_->setCurrentIndex((int)settings_file().auto_save_project());
+	analysisCacheEdit_->setCurrentIndex((int)settings_file().analysis_cache());
 
 	resize(400 * Application::stylesheetScaleFactor(), 10);
 }
@@ -103,6 +113,7 @@ void SettingsDialog::okButtonClicked()
 {
 	std::string lang_id = settings_file().language_manager()->item(languageEdit_->currentIndex())->id();
 	bool auto_save_project = (autoSaveEdit_->currentIndex() == 1);
+	bool analysis_cache = (analysisCacheEdit_->currentIndex() == 1);
 
 	if (settings_file().language() != lang_id)
 		settings_file().set_language(lang_id);
@@ -110,6 +121,9 @@ void SettingsDialog::okButtonClicked()
 	if (settings_file().auto_save_project() != auto_save_project)
 		settings_file().set_auto_save_project(auto_save_project);
 
+	if (settings_file().analysis_cache() != analysis_cache)
+		settings_file().set_analysis_cache(analysis_cache);
+
 	accept();
 }
 
@@ -12,6 +12,7 @@ private slots:
 private:
 	EnumEdit *languageEdit_;
 	BoolEdit *autoSaveEdit_;
+	BoolEdit *analysisCacheEdit_;
 #ifndef VMP_GNU
 	BoolEdit *shellExtEdit_;
 	bool shellExt_;
@@ -27,7 +27,7 @@ bool IsUserFunction(const IFunction *func)
 	return (file && file->function_list()->IndexOf(func) != NOT_ID);
 }
 
-void ConsoleLog::Notify(MessageType type, IObject *sender, const std::string &message)
+static std::string FormatMessage(MessageType type, IObject *sender, const std::string &message)
 {
 	static const LangString message_lang_type[] = {
 		lsInformation,
@@ -39,14 +39,6 @@ void ConsoleLog::Notify(MessageType type, IObject *sender, const std::string &me
 		lsScript,
 	};
 
-	bool need_throw;
-	if (type == mtWarning && warnings_as_errors_) {
-		type = mtError;
-		need_throw = true;
-	} else {
-		need_throw = false;
-	}
-
 	std::string log_message, add;
 	std::string message_type = language[message_lang_type[type]];
 	if (sender) {
@@ -70,7 +62,20 @@ void ConsoleLog::Notify(MessageType type, IObject *sender, const std::string &me
 	}
 	if (type == mtInformation || type == mtWarning || type == mtError || type == mtScript)
 		log_message = string_format("[%s] %s%s", message_type.c_str(), add.c_str(), message.c_str());
+	return log_message;
+}
 
+void ConsoleLog::Notify(MessageType type, IObject *sender, const std::string &message)
+{
+	bool need_throw;
+	if (type == mtWarning && warnings_as_errors_) {
+		type = mtError;
+		need_throw = true;
+	} else {
+		need_throw = false;
+	}
+
+	std::string log_message = FormatMessage(type, sender, message);
 	if (!log_message.empty()) {
 		EndProgress();
 		PrintArch();
@@ -166,4 +171,50 @@ ConsoleLog &ConsoleLog::operator<<(const std::string &text)
 ConsoleLog &endl(ConsoleLog &log)
 {
 	return log << "\n";
-}
\ No newline at end of file
+}
+
+/**
+ * BatchLog
+ */
+
+static std::mutex print_mutex;
+
+BatchLog::BatchLog(const std::string &file_name)
+	: file_name_(file_name), warnings_as_errors_(false)
+{
+
+}
+
+void BatchLog::Notify(MessageType type, IObject *sender, const std::string &message)
+{
+	bool need_throw;
+	if (type == mtWarning && warnings_as_errors_) {
+		type = mtError;
+		need_throw = true;
+	} else {
+		need_throw = false;
+	}
+
+	if (type == mtWarning)
+		warnings_.push_back(message);
+	else if (type == mtError)
+		errors_.push_back(message);
+
+	// only messages are printed, the function list of every file would flood the output
+	if (type == mtInformation || type == mtWarning || type == mtError || type == mtScript)
+		Print(FormatMessage(type, sender, message));
+
+	if (need_throw)
+		throw abort_error("");
+}
+
+void BatchLog::Print(const std::string &text)
+{
+	std::string line = os::ExtractFileName(file_name_.c_str());
+	if (!arch_name_.empty())
+		line += " (" + arch_name_ + ")";
+	line += "> " + text + "\n";
+
+	std::lock_guard<std::mutex> lock(print_mutex);
+	os::Print(line.c_str());
+}
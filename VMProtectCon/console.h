@@ -31,4 +31,25 @@ private:
 
 ConsoleLog &endl(ConsoleLog &log);
 
+class BatchLog : public ILog
+{
+public:
+	explicit BatchLog(const std::string &file_name);
+	virtual void Notify(MessageType type, IObject *sender, const std::string &message = "");
+	virtual void StartProgress(const std::string & /*caption*/, unsigned long long /*max*/) {}
+	virtual void StepProgress(unsigned long long /*value*/, bool /*is_project*/) {}
+	virtual void EndProgress() {}
+	virtual void set_warnings_as_errors(bool value) { warnings_as_errors_ = value; }
+	virtual void set_arch_name(const std::string &arch_name) { arch_name_ = arch_name; }
+	void Print(const std::string &text);
+	std::vector<std::string> warnings() const { return warnings_; }
+	std::vector<std::string> errors() const { return errors_; }
+private:
+	std::string file_name_;
+	std::string arch_name_;
+	bool warnings_as_errors_;
+	std::vector<std::string> warnings_;
+	std::vector<std::string> errors_;
+};
+
 #endif
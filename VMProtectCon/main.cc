@@ -8,6 +8,111 @@
 #include "console.h"
 #include "main.h"
 
+// all allocations of the process go through Tracer to get allocation counters of the traced phases
+void *operator new(size_t size)
+{
+	return Tracer::Allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+	return Tracer::Allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &tag) noexcept
+{
+	return Tracer::Allocate(size, tag);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+	return Tracer::Allocate(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+	Tracer::Free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	Tracer::Free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	Tracer::Free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	Tracer::Free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, size_t) noexcept
+{
+	Tracer::Free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	Tracer::Free(p);
+}
+#endif
+
+#ifdef __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return Tracer::Allocate(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return Tracer::Allocate(size, alignment);
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+	return Tracer::Allocate(size, alignment, tag);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &tag) noexcept
+{
+	return Tracer::Allocate(size, alignment, tag);
+}
+
+void operator delete(void *p, std::align_val_t alignment) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+
+void operator delete[](void *p, std::align_val_t alignment) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+
+void operator delete(void *p, size_t, std::align_val_t alignment) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t alignment) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+
+void operator delete(void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+
+void operator delete[](void *p, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	Tracer::Free(p, alignment);
+}
+#endif
+
 #ifdef VMP_GNU
 int main(int argc, const char *argv[])
 #else
@@ -53,6 +158,12 @@ static bool checkdate(int y, int m, int d)
 }
 #endif
 
+static bool SaveToFile(const std::string &file_name, const std::string &text)
+{
+	FileStream stream;
+	return stream.Open(file_name.c_str(), fmCreate | fmOpenWrite | fmShareDenyWrite) && stream.Write(text.c_str(), text.size()) == text.size();
+}
+
 int ConsoleApplication::Run()
 {
 #ifdef DEMO
@@ -83,7 +194,7 @@ int ConsoleApplication::Run()
 								" [-lf %s]"
 								" [-bd %s]"
 #endif
-								" [-wm %s] [-we]",
+								" [-wm %s] [-we] [-th %s] [-tf %s] [-fr %s]",
 								language[lsUsage].c_str(),
 								os::ExtractFileName(args_[0].c_str()).c_str(),
 								language[lsFile].c_str(),
@@ -94,7 +205,30 @@ int ConsoleApplication::Run()
 								language[lsLicensingParametersFile].c_str(),
 								language[lsBuildDate].c_str(),
 #endif
-								language[lsWatermark].c_str()
+								language[lsWatermark].c_str(),
+								language[lsThreads].c_str(),
+								language[lsTraceFile].c_str(),
+								language[lsFunctionReportFile].c_str()
+								) << endl;
+		log_ << string_format("%s: %s -bf %s [-bj %s] [-bs %s] [-sf %s]"
+#ifdef ULTIMATE
+								" [-lf %s]"
+								" [-bd %s]"
+#endif
+								" [-wm %s] [-we] [-th %s] [-tf %s]",
+								language[lsUsage].c_str(),
+								os::ExtractFileName(args_[0].c_str()).c_str(),
+								language[lsBatchFile].c_str(),
+								language[lsJobs].c_str(),
+								language[lsSummaryFile].c_str(),
+								language[lsScriptFile].c_str(),
+#ifdef ULTIMATE
+								language[lsLicensingParametersFile].c_str(),
+								language[lsBuildDate].c_str(),
+#endif
+								language[lsWatermark].c_str(),
+								language[lsThreads].c_str(),
+								language[lsTraceFile].c_str()
 								) << endl;
 		return 1;
 	}
@@ -102,12 +236,11 @@ int ConsoleApplication::Run()
 	std::string input_file_name;
 	std::string output_file_name;
 	std::string project_file_name;
-	std::string script_file_name;
-	std::string watermark_name;
-#ifdef ULTIMATE
-	std::string licensing_params_file_name;
-	uint32_t build_date = 0;
-#endif
+	std::string batch_file_name;
+	std::string summary_file_name;
+	std::string trace_file_name;
+	size_t job_count = GetThreadCount();
+	ProtectOptions options;
 	//std::string invalid_param;
 	for (size_t i = 1; i < args_.size(); i++) {
 		std::string param = args_[i];
@@ -123,26 +256,66 @@ int ConsoleApplication::Run()
 			if (is_last)
 				invalid_value = true;
 			else
-				script_file_name = args_[++i];
+				options.script_file_name = args_[++i];
 		} else if (param == "-wm") {
 			if (is_last)
 				invalid_value = true;
 			else
-				watermark_name = args_[++i];
-		} 
+				options.watermark_name = args_[++i];
+		} else if (param == "-bf") {
+			if (is_last)
+				invalid_value = true;
+			else
+				batch_file_name = args_[++i];
+		} else if (param == "-bj") {
+			if (is_last)
+				invalid_value = true;
+			else {
+				int value;
+				if (sscanf_s(args_[++i].c_str(), "%d", &value) == 1 && value > 0)
+					job_count = value;
+				else
+					invalid_value = true;
+			}
+		} else if (param == "-th") {
+			if (is_last)
+				invalid_value = true;
+			else {
+				int value;
+				if (sscanf_s(args_[++i].c_str(), "%d", &value) == 1 && value > 0)
+					options.thread_count = value;
+				else
+					invalid_value = true;
+			}
+		} else if (param == "-bs") {
+			if (is_last)
+				invalid_value = true;
+			else
+				summary_file_name = args_[++i];
+		} else if (param == "-tf") {
+			if (is_last)
+				invalid_value = true;
+			else
+				trace_file_name = args_[++i];
+		} else if (param == "-fr") {
+			if (is_last)
+				invalid_value = true;
+			else
+				options.function_report_file_name = args_[++i];
+		}
 #ifdef ULTIMATE		
 		else if (param == "-lf") {
 			if (is_last)
 				invalid_value = true;
 			else
-				licensing_params_file_name = args_[++i];
+				options.licensing_params_file_name = args_[++i];
 		} else if (param == "-bd") {
 			if (is_last)
 				invalid_value = true;
 			else {
 				int y, m, d;
 				if (sscanf_s(args_[++i].c_str(), "%04d-%02d-%02d", &y, &m, &d) == 3 && checkdate(y, m, d))
-					build_date = (y << 16) + (static_cast<uint8_t>(m) << 8) + static_cast<uint8_t>(d);
+					options.build_date = (y << 16) + (static_cast<uint8_t>(m) << 8) + static_cast<uint8_t>(d);
 				else
 					invalid_value = true;
 			}
@@ -150,6 +323,7 @@ int ConsoleApplication::Run()
 #endif
 		else if (param == "-we") {
 			log_.set_warnings_as_errors(true);
+			options.warnings_as_errors = true;
 		} else {
 			switch (i) {
 			case 1:
@@ -170,6 +344,8 @@ int ConsoleApplication::Run()
 	std::string current_path = os::GetCurrentPath();
 	if (!input_file_name.empty())
 		input_file_name = os::CombinePaths(current_path.c_str(), input_file_name.c_str());
+	if (!output_file_name.empty())
+		output_file_name = os::CombinePaths(current_path.c_str(), output_file_name.c_str());
 	if (!project_file_name.empty()) {
 		project_file_name = os::CombinePaths(current_path.c_str(), project_file_name.c_str());
 		if (!os::FileExists(project_file_name.c_str())) {
@@ -177,55 +353,247 @@ int ConsoleApplication::Run()
 			return 1;
 		}
 	}
+	if (!options.script_file_name.empty())
+		options.script_file_name = os::CombinePaths(current_path.c_str(), options.script_file_name.c_str());
+	if (!options.function_report_file_name.empty())
+		options.function_report_file_name = os::CombinePaths(current_path.c_str(), options.function_report_file_name.c_str());
 #ifdef ULTIMATE
-	if (!licensing_params_file_name.empty()) {
-		licensing_params_file_name = os::CombinePaths(current_path.c_str(), licensing_params_file_name.c_str());
-		if (!os::FileExists(licensing_params_file_name.c_str())) {
-			log_.Notify(mtError, NULL, string_format(language[lsFileNotFound].c_str(), licensing_params_file_name.c_str()));
+	if (!options.licensing_params_file_name.empty()) {
+		options.licensing_params_file_name = os::CombinePaths(current_path.c_str(), options.licensing_params_file_name.c_str());
+		if (!os::FileExists(options.licensing_params_file_name.c_str())) {
+			log_.Notify(mtError, NULL, string_format(language[lsFileNotFound].c_str(), options.licensing_params_file_name.c_str()));
 			return 1;
 		}
 	}
 #endif
 
-	Core core(&log_);
+	if (!trace_file_name.empty()) {
+		trace_file_name = os::CombinePaths(current_path.c_str(), trace_file_name.c_str());
+		Tracer::set_enabled(true);
+	}
+
+	int res;
+	if (!batch_file_name.empty()) {
+		// every file of the batch has its own function report in the batch file
+		if (!options.function_report_file_name.empty()) {
+			log_.Notify(mtError, NULL, string_format(language[lsBatchInvalidParameter].c_str(), "-fr"));
+			return 1;
+		}
+		batch_file_name = os::CombinePaths(current_path.c_str(), batch_file_name.c_str());
+		if (!summary_file_name.empty())
+			summary_file_name = os::CombinePaths(current_path.c_str(), summary_file_name.c_str());
+		res = RunBatch(batch_file_name, job_count, summary_file_name, options);
+	} else if (Protect(log_, input_file_name, output_file_name, project_file_name, options)) {
+		log_ << endl << language[lsCompiled] << endl;
+		res = 0;
+	} else {
+		res = 1;
+	}
+
+	if (!trace_file_name.empty()) {
+		Tracer::set_enabled(false);
+		if (!SaveToFile(trace_file_name, Tracer::ToJSON())) {
+			log_.Notify(mtError, NULL, string_format(language[lsCreateFileError].c_str(), trace_file_name.c_str()));
+			res = 1;
+		}
+	}
+
+	return res;
+}
+
+bool ConsoleApplication::Protect(ILog &log, const std::string &input_file_name, const std::string &output_file_name, const std::string &project_file_name, 
+	const ProtectOptions &options, std::string *protected_file_name)
+{
+	Core core(&log);
 	try {
 		if (!core.Open(input_file_name, project_file_name
 #ifdef ULTIMATE
-			, licensing_params_file_name
+			, options.licensing_params_file_name
 #endif
 			))
-			return 1;
+			return false;
 
 		if (!output_file_name.empty())
-			core.set_output_file_name(os::CombinePaths(current_path.c_str(), output_file_name.c_str()));
+			core.set_output_file_name(output_file_name);
 
-		if (!script_file_name.empty()) {
-			script_file_name = os::CombinePaths(current_path.c_str(), script_file_name.c_str());
-			if (!core.script()->LoadFromFile(script_file_name)) {
-				log_.Notify(mtError, NULL, string_format(language[os::FileExists(script_file_name.c_str()) ? lsOpenFileError : lsFileNotFound].c_str(), script_file_name.c_str()));
-				return 1;
+		if (!options.script_file_name.empty()) {
+			if (!core.script()->LoadFromFile(options.script_file_name)) {
+				log.Notify(mtError, NULL, string_format(language[os::FileExists(options.script_file_name.c_str()) ? lsOpenFileError : lsFileNotFound].c_str(), options.script_file_name.c_str()));
+				return false;
 			}
 		}
 
-		if (!watermark_name.empty())
-			core.set_watermark_name(watermark_name);
+		if (!options.watermark_name.empty())
+			core.set_watermark_name(options.watermark_name);
+
+		core.set_function_report_file_name(options.function_report_file_name);
+		core.set_thread_count(options.thread_count);
 
 #ifdef ULTIMATE
-		if (build_date)
-			core.licensing_manager()->set_build_date(build_date);
+		if (options.build_date)
+			core.licensing_manager()->set_build_date(options.build_date);
 #endif
 
+		if (protected_file_name)
+			*protected_file_name = core.absolute_output_file_name();
+
 		if (!core.Compile())
-			return 1;
+			return false;
 
 	} catch (abort_error & /*error*/) {
-		return 1;
+		return false;
 	} catch (std::runtime_error &error) {
 		if (error.what())
-			log_.Notify(mtError, NULL, error.what());
-		return 1;
+			log.Notify(mtError, NULL, error.what());
+		return false;
+	}
+
+	return true;
+}
+
+struct BatchResult
+{
+	std::string output_file_name;
+	bool is_compiled;
+	uint32_t time;
+	uint64_t input_size;
+	uint64_t output_size;
+	std::vector<std::string> warnings;
+	std::vector<std::string> errors;
+	BatchResult() : is_compiled(false), time(0), input_size(0), output_size(0) {}
+};
+
+static uint64_t GetFileSize(const std::string &file_name)
+{
+	FileStream stream;
+	if (file_name.empty() || !stream.Open(file_name.c_str(), fmOpenRead | fmShareDenyNone))
+		return 0;
+	return stream.Size();
+}
+
+static std::string JSONStringList(const std::vector<std::string> &list)
+{
+	std::string res = "[";
+	for (size_t i = 0; i < list.size(); i++) {
+		if (i)
+			res += ", ";
+		res += JSONString(list[i]);
+	}
+	res += "]";
+	return res;
+}
+
+int ConsoleApplication::RunBatch(const std::string &batch_file_name, size_t job_count, const std::string &summary_file_name, const ProtectOptions &options)
+{
+	// every line of the batch file is "input[<TAB>output[<TAB>project[<TAB>function report]]]", relative names are taken from the folder of the batch file
+	std::vector<BatchItem> item_list;
+	{
+		FileStream stream;
+		if (!stream.Open(batch_file_name.c_str(), fmOpenRead | fmShareDenyWrite)) {
+			log_.Notify(mtError, NULL, string_format(language[os::FileExists(batch_file_name.c_str()) ? lsOpenFileError : lsFileNotFound].c_str(), batch_file_name.c_str()));
+			return 1;
+		}
+
+		std::string batch_path = os::ExtractFilePath(batch_file_name.c_str());
+		std::string line;
+		while (stream.ReadLine(line)) {
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::vector<std::string> column_list;
+			size_t pos = 0;
+			for (;;) {
+				size_t next_pos = line.find('\t', pos);
+				column_list.push_back(line.substr(pos, next_pos - pos));
+				if (next_pos == std::string::npos)
+					break;
+				pos = next_pos + 1;
+			}
+
+			BatchItem item;
+			for (size_t i = 0; i < column_list.size() && i < 4; i++) {
+				if (column_list[i].empty())
+					continue;
+				std::string file_name = os::CombinePaths(batch_path.c_str(), column_list[i].c_str());
+				switch (i) {
+				case 0:
+					item.input_file_name = file_name;
+					break;
+				case 1:
+					item.output_file_name = file_name;
+					break;
+				case 2:
+					item.project_file_name = file_name;
+					break;
+				case 3:
+					item.function_report_file_name = file_name;
+					break;
+				}
+			}
+			if (!item.input_file_name.empty())
+				item_list.push_back(item);
+		}
+	}
+
+	ProtectOptions item_options = options;
+	// the jobs share the processors unless the thread count is given explicitly
+	if (!item_options.thread_count && job_count > 1)
+		item_options.thread_count = std::max<size_t>(1, GetThreadCount() / job_count);
+
+	std::vector<BatchResult> result_list(item_list.size());
+	uint32_t start_time = os::GetTickCount();
+	ParallelFor(item_list.size(), std::min(job_count, item_list.size()), [&](size_t /*thread_index*/, size_t index) {
+		const BatchItem &item = item_list[index];
+		BatchResult &result = result_list[index];
+		BatchLog log(item.input_file_name);
+		log.set_warnings_as_errors(options.warnings_as_errors);
+		ProtectOptions protect_options = item_options;
+		protect_options.function_report_file_name = item.function_report_file_name;
+
+		uint32_t item_start_time = os::GetTickCount();
+		if (!item.project_file_name.empty() && !os::FileExists(item.project_file_name.c_str()))
+			log.Notify(mtError, NULL, string_format(language[lsFileNotFound].c_str(), item.project_file_name.c_str()));
+		else
+			result.is_compiled = Protect(log, item.input_file_name, item.output_file_name, item.project_file_name, protect_options, &result.output_file_name);
+		result.time = os::GetTickCount() - item_start_time;
+		result.input_size = GetFileSize(item.input_file_name);
+		if (result.is_compiled)
+			result.output_size = GetFileSize(result.output_file_name);
+		result.warnings = log.warnings();
+		result.errors = log.errors();
+		if (result.is_compiled)
+			log.Print(language[lsCompiled]);
+	});
+	uint32_t time = os::GetTickCount() - start_time;
+
+	size_t compiled_count = 0;
+	for (size_t i = 0; i < result_list.size(); i++) {
+		if (result_list[i].is_compiled)
+			compiled_count++;
+	}
+
+	if (!summary_file_name.empty()) {
+		std::string summary = "{\n";
+		summary += string_format("  \"time\": %u,\n  \"jobs\": %u,\n  \"compiled\": %u,\n  \"files\": [", time, static_cast<uint32_t>(job_count), static_cast<uint32_t>(compiled_count));
+		for (size_t i = 0; i < item_list.size(); i++) {
+			const BatchItem &item = item_list[i];
+			const BatchResult &result = result_list[i];
+			summary += (i ? ",\n    {" : "\n    {");
+			summary += "\"input\": " + JSONString(item.input_file_name);
+			summary += ", \"output\": " + JSONString(result.output_file_name);
+			summary += string_format(", \"status\": \"%s\", \"time\": %u, \"input_size\": %llu, \"output_size\": %llu", result.is_compiled ? "compiled" : "failed", result.time, static_cast<unsigned long long>(result.input_size), static_cast<unsigned long long>(result.output_size));
+			summary += ", \"warnings\": " + JSONStringList(result.warnings);
+			summary += ", \"errors\": " + JSONStringList(result.errors);
+			summary += "}";
+		}
+		summary += "\n  ]\n}\n";
+
+		if (!SaveToFile(summary_file_name, summary)) {
+			log_.Notify(mtError, NULL, string_format(language[lsCreateFileError].c_str(), summary_file_name.c_str()));
+			return 1;
+		}
 	}
 
-	log_ << endl << language[lsCompiled] << endl;
-	return 0;
-}
\ No newline at end of file
+	log_ << endl << string_format(language[lsBatchCompiled].c_str(), static_cast<int>(compiled_count), static_cast<int>(item_list.size())) << endl;
+	return (compiled_count == item_list.size()) ? 0 : 1;
+}
@@ -1,14 +1,45 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+struct ProtectOptions
+{
+	std::string script_file_name;
+	std::string watermark_name;
+	std::string function_report_file_name;
+#ifdef ULTIMATE
+	std::string licensing_params_file_name;
+	uint32_t build_date;
+#endif
+	bool warnings_as_errors;
+	size_t thread_count;
+	ProtectOptions()
+		: warnings_as_errors(false), thread_count(0)
+	{
+#ifdef ULTIMATE
+		build_date = 0;
+#endif
+	}
+};
+
+struct BatchItem
+{
+	std::string input_file_name;
+	std::string output_file_name;
+	std::string project_file_name;
+	std::string function_report_file_name;
+};
+
 class ConsoleApplication
 {
 public:
 	ConsoleApplication(const std::vector<std::string> &args);
 	int Run();
 private:
+	bool Protect(ILog &log, const std::string &input_file_name, const std::string &output_file_name, const std::string &project_file_name, 
+		const ProtectOptions &options, std::string *protected_file_name = NULL);
+	int RunBatch(const std::string &batch_file_name, size_t job_count, const std::string &summary_file_name, const ProtectOptions &options);
 	std::vector<std::string> args_;
 	ConsoleLog log_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -200,7 +200,7 @@ void Watermark::Compile()
 			b = c - 'a' + 0x0a;
 		} else {
 			m = 0;
-			b = rand();
+			b = Random();
 		}
 
 		if ((i & 1) == 0) {
@@ -411,12 +411,12 @@ std::string WatermarkManager::CreateValue() const
 	res.reserve(2 * (20 + 0xFF));
 	do {
 		res.clear();
-		size_t c = 20 + rand() % 0x100;
+		size_t c = 20 + Random() % 0x100;
 		for (size_t i = 0; i < 2 * c; i++) {
-			if (rand() & 1)
+			if (Random() & 1)
 				res += '?';
 			else
-				res += string_format("%x", rand() % 0x10);
+				res += string_format("%x", Random() % 0x10);
 		}
 	} while (!IsUniqueWatermark(res));
 	return res;
@@ -426,9 +426,12 @@ std::string WatermarkManager::CreateValue() const
  * Core
  */
 
+// the settings file is shared by all Core instances of the process
+static std::recursive_mutex settings_mutex;
+
 Core::Core(ILog *log /*=NULL*/)
 	: IObject(), log_(log), input_file_(NULL), output_file_(NULL), watermark_(NULL), output_architecture_(NULL),
-	options_(0), vm_options_(0)
+	options_(0), vm_options_(0), thread_count_(0)
 {
 #ifdef ULTIMATE
 	licensing_manager_ = new LicensingManager(this);
@@ -437,6 +440,8 @@ Core::Core(ILog *log /*=NULL*/)
 	watermark_manager_ = new WatermarkManager(this);
 	template_manager_ = new ProjectTemplateManager(this);
 	script_ = new Script(this);
+
+	std::lock_guard<std::recursive_mutex> lock(settings_mutex);
 #ifdef __APPLE__
 	watermark_manager_->ReadFromFile(settings_file());
 #else
@@ -548,9 +553,10 @@ bool Core::Open(const std::string &file_name, const std::string &user_project_fi
 			std::auto_ptr<IFile>(new ELFFile(log_))
 		};
 		std::string open_error;
+		AnalysisCache::set_max_size(settings_file().analysis_cache() ? static_cast<uint64_t>(settings_file().analysis_cache_size()) << 20 : 0);
 		for (i = 0; i < _countof(file); i++) {
 			open_error.clear();
-			OpenStatus status = file[i]->Open(exe_file_name.c_str(), foRead | foCopyToTemp, &open_error);
+			OpenStatus status = file[i]->Open(exe_file_name.c_str(), foRead | foCopyToTemp | foUseCache, &open_error);
 			if (status == osSuccess) {
 				IArchitecture *arch = file[i]->item(0);
 				ISection *code_segment = NULL;
@@ -646,15 +652,12 @@ bool Core::LoadFromXML(const char *project_file_name)
 	TiXmlElement *root_node, *script_node, *protection_node, *procedures_node, *procedure_node, *objects_node, *object_node,
 		*messages_node, *message_node, *folders_node, *folder_node, *ext_command_node;
 	size_t i, j;
-	CompilationType compilation_type;
 	uint64_t func_address, address;
 	bool need_compile;
-	std::string func_name, arch_name;
+	std::string arch_name;
 	IFunction *function;
 	IArchitecture *arch;
-	uint32_t compilation_options;
     unsigned int u, version;
-	unsigned int func_index;
 
 	if (!doc.LoadFile(project_file_name))
 		return false;
@@ -743,35 +746,59 @@ bool Core::LoadFromXML(const char *project_file_name)
 
 			procedures_node = protection_node->FirstChildElement("Procedures");
 			if (procedures_node) {
+				struct ProcedureInfo {
+					std::string name;
+					unsigned int index;
+					CompilationType compilation_type;
+					uint32_t compilation_options;
+					bool need_compile;
+					Folder *folder;
+					uint32_t break_offset;
+					std::vector<uint32_t> ext_offset_list;
+					std::vector<size_t> unknown_arch_list;
+					std::vector<std::pair<size_t, size_t> > load_index_list;
+				};
+
+				// functions with known addresses are read by one call per architecture so they can be disassembled in parallel
+				std::vector<ProcedureInfo> procedure_list;
+				std::vector<std::vector<FunctionLoadInfo> > load_list(input_file_->count());
 				std::vector<uint64_t> address_list;
 				procedure_node = procedures_node->FirstChildElement("Procedure");
 				while (procedure_node) {
-					arch_name.clear();
-					procedure_node->QueryStringAttribute("Architecture", &arch_name);
+					procedure_list.push_back(ProcedureInfo());
+					ProcedureInfo &procedure = procedure_list.back();
 					u = ctVirtualization;
 					procedure_node->QueryUnsignedAttribute("CompilationType", &u);
 					if (u > 2)
 						u = 0;
-					compilation_type = static_cast<CompilationType>(u);
+					procedure.compilation_type = static_cast<CompilationType>(u);
 					u = 0;
 					procedure_node->QueryUnsignedAttribute("Options", &u);
-					compilation_options = u;
-					need_compile = true;
-					procedure_node->QueryBoolAttribute("IncludedInCompilation", &need_compile);
+					procedure.compilation_options = u;
+					procedure.need_compile = true;
+					procedure_node->QueryBoolAttribute("IncludedInCompilation", &procedure.need_compile);
 					u = -1;
 					procedure_node->QueryUnsignedAttribute("Folder", &u);
-					parent_folder = (u < folder_list.size()) ? folder_list[u] : NULL;
-					func_name.clear();
-					procedure_node->QueryStringAttribute("MapAddress", &func_name);
+					procedure.folder = (u < folder_list.size()) ? folder_list[u] : NULL;
+					procedure_node->QueryStringAttribute("MapAddress", &procedure.name);
 					func_address = 0;
-					func_index = (unsigned int)-1;
-					if (func_name.empty()) {
+					procedure.index = (unsigned int)-1;
+					if (procedure.name.empty()) {
 						std::string str;
 						procedure_node->QueryStringAttribute("Address", &str);
 						func_address = StrToInt64Def(str.c_str(), 0);
 					}
 					else {
-						procedure_node->QueryUnsignedAttribute("Index", &func_index);
+						procedure_node->QueryUnsignedAttribute("Index", &procedure.index);
+					}
+					u = 0;
+					procedure_node->QueryUnsignedAttribute("BreakOffset", &u);
+					procedure.break_offset = u;
+					ext_command_node = procedure_node->FirstChildElement("ExtOffset");
+					while (ext_command_node) {
+						if (const char *str = ext_command_node->GetText())
+							procedure.ext_offset_list.push_back(strtoul(str, 0, 10));
+						ext_command_node = ext_command_node->NextSiblingElement("ExtOffset");
 					}
 
 					for (i = 0; i < input_file_->count(); i++) {
@@ -779,65 +806,57 @@ bool Core::LoadFromXML(const char *project_file_name)
 						if (!arch->visible())
 							continue;
 
-						struct AddressInfo {
-							IArchitecture *arch;
-							uint64_t address;
-						};
-
-						std::vector<AddressInfo> address_info_list;
-						AddressInfo address_info;
-
-						address_info.arch = arch;
-						if (func_name.empty()) {
-							address_info.address = func_address;
-							address_info_list.push_back(address_info);
+						address_list.clear();
+						if (procedure.name.empty()) {
+							address_list.push_back(func_address);
 						} else {
-							address_list = arch->map_function_list()->GetAddressListByName(func_name, true);
-							for (j = 0; j < address_list.size(); j++) {
-								address_info.address = address_list[j];
-								address_info_list.push_back(address_info);
+							address_list = arch->map_function_list()->GetAddressListByName(procedure.name, true);
+							if (address_list.empty())
+								procedure.unknown_arch_list.push_back(i);
+							else if (procedure.index != (unsigned int)-1) {
+								address = (procedure.index < address_list.size()) ? address_list[procedure.index] : 0;
+								address_list.clear();
+								if (address)
+									address_list.push_back(address);
 							}
 						}
-
-						if (!func_name.empty()) {
-							if (func_index != (unsigned int)-1) {
-								if (func_index < address_info_list.size()) {
-									address_info = address_info_list[func_index];
-									address_info_list.clear();
-									address_info_list.push_back(address_info);
-								}
-								else {
-									address_info_list.clear();
-								}
-							}
-							if (address_list.empty()) {
-								function = arch->function_list()->AddUnknown(func_name, compilation_type, compilation_options, need_compile, parent_folder);
-								function->set_tag(func_index);
-							}
+						for (j = 0; j < address_list.size(); j++) {
+							procedure.load_index_list.push_back(std::make_pair(i, load_list[i].size()));
+							load_list[i].push_back(FunctionLoadInfo(address_list[j], procedure.compilation_type, procedure.compilation_options, procedure.need_compile, procedure.folder));
 						}
+					}
 
-						for (j = 0; j < address_info_list.size(); j++) {
-							address_info = address_info_list[j];
-							address = address_info.address;
-							arch = address_info.arch;
-							function = arch->function_list()->AddByAddress(address_info.address, compilation_type, compilation_options, need_compile, parent_folder);
-							if (function) {
-								u = 0;
-								procedure_node->QueryUnsignedAttribute("BreakOffset", &u);
-								if (u)
-									function->set_break_address(address + u);
-
-								ext_command_node = procedure_node->FirstChildElement("ExtOffset");
-								while (ext_command_node) {
-									if (const char *str = ext_command_node->GetText())
-										function->ext_command_list()->Add(address + strtoul(str, 0, 10));
-									ext_command_node = ext_command_node->NextSiblingElement("ExtOffset");
-								}
-							}
+					procedure_node = procedure_node->NextSiblingElement(procedure_node->Value());
+				}
+
+				std::vector<std::vector<IFunction *> > loaded_list(input_file_->count());
+				for (i = 0; i < input_file_->count(); i++) {
+					if (!load_list[i].empty())
+						loaded_list[i] = input_file_->item(i)->function_list()->AddByAddressList(load_list[i]);
+				}
+
+				for (size_t k = 0; k < procedure_list.size(); k++) {
+					const ProcedureInfo &procedure = procedure_list[k];
+					for (j = 0; j < procedure.unknown_arch_list.size(); j++) {
+						function = input_file_->item(procedure.unknown_arch_list[j])->function_list()->AddUnknown(procedure.name, procedure.compilation_type, procedure.compilation_options, procedure.need_compile, procedure.folder);
+						function->set_tag(procedure.index);
+					}
+
+					for (j = 0; j < procedure.load_index_list.size(); j++) {
+						i = procedure.load_index_list[j].first;
+						size_t index = procedure.load_index_list[j].second;
+						function = loaded_list[i][index];
+						if (!function)
+							continue;
+
+						address = load_list[i][index].address;
+						if (procedure.break_offset)
+							function->set_break_address(address + procedure.break_offset);
+						for (size_t n = 0; n < procedure.ext_offset_list.size(); n++) {
+							function->ext_command_list()->Add(address + procedure.ext_offset_list[n]);
 						}
 					}
 
-					procedure_node = procedure_node->NextSiblingElement(procedure_node->Value());
 					if (log_)
 						log_->StepProgress(1ull, true);
 				}
@@ -1097,19 +1116,25 @@ void Core::LoadDefaultFunctions()
 		if (!arch->visible())
 			continue;
 
-		for (size_t j = 0; j < arch->map_function_list()->count(); j++) {
-			IFunctionList *function_list = arch->function_list();
+		IFunctionList *function_list = arch->function_list();
+		std::set<uint64_t> address_set;
+		for (size_t j = 0; j < function_list->count(); j++) {
+			address_set.insert(function_list->item(j)->address());
+		}
 
+		std::vector<FunctionLoadInfo> info_list;
+		for (size_t j = 0; j < arch->map_function_list()->count(); j++) {
 			MapFunction *map_function = arch->map_function_list()->item(j);
 			if ((map_function->type() == otMarker || map_function->type() == otAPIMarker || map_function->type() == otString) 
-				&& function_list->GetFunctionByAddress(map_function->address()) == NULL) {
+				&& address_set.find(map_function->address()) == address_set.end()) {
 				if (!parent_folder) {
 					parent_folder = input_file_->folder_list()->Add("New markers and strings");
 					parent_folder->set_read_only(true);
 				}
-				function_list->AddByAddress(map_function->address(), ctVirtualization, 0, true, parent_folder);
+				info_list.push_back(FunctionLoadInfo(map_function->address(), ctVirtualization, 0, true, parent_folder));
 			}
 		}
+		function_list->AddByAddressList(info_list);
 	}
 }
 
@@ -1702,7 +1727,7 @@ bool Core::Compile()
 	rand_seed = 0;
 	OutputDebugStringA(string_format("rand_seed:%d\n", rand_seed).c_str());
 
-	srand(rand_seed);
+	SetRandomSeed(rand_seed);
 	
 	output_file_ = NULL;
 	output_architecture_ = NULL;
@@ -1768,6 +1793,10 @@ bool Core::Compile()
 	options.watermark = watermark;
 	options.script = script_;
 	options.architecture = &output_architecture_;
+	FunctionReport function_report;
+	if (!function_report_file_name_.empty())
+		options.function_report = &function_report;
+	options.thread_count = thread_count_;
 #ifdef ULTIMATE
 	options.hwid = hwid_;
 	options.licensing_manager = licensing_manager_;
@@ -1802,6 +1831,15 @@ bool Core::Compile()
 			static_cast<int>(100.0 * output_file_size / input_file_->size())
 			));
 
+		if (options.function_report) {
+			std::string text = (_strcmpi(os::ExtractFileExt(function_report_file_name_.c_str()).c_str(), ".json") == 0) ? function_report.ToJSON() : function_report.ToCSV();
+			FileStream stream;
+			if (!stream.Open(function_report_file_name_.c_str(), fmCreate | fmOpenWrite | fmShareDenyWrite) || stream.Write(text.c_str(), text.size()) != text.size()) {
+				Notify(mtError, NULL, string_format(language[lsCreateFileError].c_str(), function_report_file_name_.c_str()));
+				return false;
+			}
+		}
+
 		if (options.script)
 			options.script->DoAfterCompilation();
 	}
@@ -1938,6 +1976,7 @@ void Core::Notify(MessageType type, IObject *sender, const std::string &message)
 	if (sender) {
 		Watermark *watermark = dynamic_cast<Watermark *>(sender);
 		if (watermark) {
+			std::lock_guard<std::recursive_mutex> lock(settings_mutex);
 			switch (type) {
 			case mtAdded:
 			case mtChanged:
@@ -1953,6 +1992,7 @@ void Core::Notify(MessageType type, IObject *sender, const std::string &message)
 		}
 		ProjectTemplate *pt = dynamic_cast<ProjectTemplate *>(sender);
 		if (pt) {
+			std::lock_guard<std::recursive_mutex> lock(settings_mutex);
 			switch (type) {
 			case mtAdded:
 			case mtChanged:
@@ -2150,9 +2190,9 @@ bool LicensingManager::Init(size_t key_len)
 	public_exp_ = rsa.public_exp();
 	private_exp_ = rsa.private_exp();
 	modulus_ = rsa.modulus();
-	srand(os::GetTickCount());
+	SetRandomSeed(os::GetTickCount());
 	for (size_t i = 0; i < 8; i++) {
-		product_code_.push_back(rand());
+		product_code_.push_back(Random());
 	}
 	changed();
 
@@ -2490,8 +2530,8 @@ std::string LicensingManager::GenerateSerialNumber(const LicenseInfo &info)
 	if (data.size() + min_padding > max_bytes)
 		throw std::runtime_error(language[lsSerialNumberTooLong]);
 
-	srand(os::GetTickCount());
-	size_t padding_bytes = min_padding + rand() % (max_padding - min_padding);
+	SetRandomSeed(os::GetTickCount());
+	size_t padding_bytes = min_padding + Random() % (max_padding - min_padding);
 
 	data.InsertBuff(0, data.data(), padding_bytes);
 	data[0] = 0;
@@ -2500,12 +2540,12 @@ std::string LicensingManager::GenerateSerialNumber(const LicenseInfo &info)
 	for (size_t i = 2; i < padding_bytes - 1; i++) {
 		uint8_t b = 0;
 		while (!b) {
-			b = rand();
+			b = Random();
 		}
 		data[i] = b;
 	}
 	while (data.size() < max_bytes) {
-		data.PushByte(rand());
+		data.PushByte(Random());
 	}
 
 	{
@@ -2990,20 +3030,33 @@ void InternalFile::WriteName(IFunction &func, uint64_t image_base, uint32_t key)
 	link->set_sub_value(image_base);
 }
 
-void InternalFile::WriteData(IFunction &func, uint64_t image_base, uint32_t key)
+void InternalFile::ReadData(AbstractStream &stream, Data &data, uint32_t key)
 {
-	std::vector<uint8_t> buf;
-	buf.resize(static_cast<size_t>(stream_->Size()));
-	stream_->Read(&buf[0], buf.size());
+	const size_t chunk_size = 0x100000;
 
-	Data d;
-	for (size_t i = 0; i < buf.size(); i++) {
-		d.PushByte(buf[i] ^ static_cast<uint8_t>(_rotl32(key, static_cast<int>(i)) + i));
+	data.resize(static_cast<size_t>(stream.Size()));
+	for (size_t pos = 0; pos < data.size(); ) {
+		size_t size = stream.Read(&data[pos], std::min(data.size() - pos, chunk_size));
+		if (!size)
+			throw std::runtime_error("Runtime error at Read");
+		EncryptData(&data[pos], size, pos, key);
+		pos += size;
 	}
+}
 
-	ICommand *command = func.AddCommand(d);
+ICommand *InternalFile::WriteData(IFunction &func, uint64_t image_base, Data &data)
+{
+	// the data is as large as the file, so its buffer is moved into the command instead of being copied
+	ICommand *command = func.AddCommand(Data());
+	static_cast<BaseCommand *>(command)->raw_dump().swap(data);
 	command->include_option(roCreateNewBlock);
 
+	WriteDataLink(func, image_base, command);
+	return command;
+}
+
+void InternalFile::WriteDataLink(IFunction &func, uint64_t image_base, ICommand *command)
+{
 	CommandLink *link = func.item(entry_offset_ + 1)->AddLink(0, ltOffset, command);
 	link->set_sub_value(image_base);
 }
@@ -3060,6 +3113,35 @@ void FileManager::CloseFiles()
 	}
 }
 
+void FileManager::ReadData(std::vector<Data> &data_list, uint32_t key, size_t thread_count) const
+{
+	// every file has its own stream, so the files are read and encrypted independently
+	data_list.clear();
+	data_list.resize(count());
+	ParallelFor(data_list.size(), thread_count, [&](size_t, size_t index) {
+		InternalFile::ReadData(*item(index)->stream(), data_list[index], key);
+	});
+}
+
+void FileManager::WriteData(IFunction &func, uint64_t image_base, uint32_t key, size_t thread_count)
+{
+	std::vector<Data> data_list;
+	ReadData(data_list, key, thread_count);
+
+	// the key stream of every file starts from zero, so files with the same content share one data block
+	std::vector<size_t> original_list = FindDuplicates(data_list, thread_count);
+	std::vector<ICommand *> command_list(count());
+	for (size_t i = 0; i < count(); i++) {
+		InternalFile *file = item(i);
+		Notify(mtInformation, NULL, string_format("%s %s", language[lsLoading].c_str(), os::ExtractFileName(file->absolute_file_name().c_str()).c_str()));
+		if (original_list[i] == i) {
+			command_list[i] = file->WriteData(func, image_base, data_list[i]);
+		} else {
+			file->WriteDataLink(func, image_base, command_list[original_list[i]]);
+		}
+	}
+}
+
 void FileManager::Notify(MessageType type, IObject *sender, const std::string &message) const
 {
 	if (owner_)
@@ -3254,7 +3336,7 @@ bool RSA::CreateKeyPair(size_t key_length)
 
 	// Keychain Access tool should display our items as VMProtect XXX, no <key> (if it was not deleted)
 	std::ostringstream stringStream;
-	stringStream << "VMProtect " << rand();
+	stringStream << "VMProtect " << Random();
 	CFStringRef name = CFStringCreateWithCString(NULL, stringStream.str().c_str(), kCFStringEncodingUTF8);
 	CFDictionarySetValue(
 		parameters,
@@ -3564,9 +3646,9 @@ void ProjectTemplate::Init()
 		"0123456789"
 		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
 		"abcdefghijklmnopqrstuvwxyz";
-	srand(os::GetTickCount());
+	SetRandomSeed(os::GetTickCount());
 	for (i = 0; i < 3; i++) {
-		vm_section_name_ += alphanum[rand() % (sizeof(alphanum) - 1)];
+		vm_section_name_ += alphanum[Random() % (sizeof(alphanum) - 1)];
 	}
 
 	for (i = 0; i < _countof(messages_); i++) {
@@ -199,6 +199,8 @@ private:
 
 class FileManager;
 class IFunction;
+class ICommand;
+class AbstractStream;
 class FileStream;
 
 class FileFolder : public ObjectList<FileFolder>
@@ -260,7 +262,9 @@ public:
 	void Close();
 	virtual void WriteEntry(IFunction &func);
 	virtual void WriteName(IFunction &func, uint64_t image_base, uint32_t key);
-	virtual void WriteData(IFunction &func, uint64_t image_base, uint32_t key);
+	virtual ICommand *WriteData(IFunction &func, uint64_t image_base, Data &data);
+	virtual void WriteDataLink(IFunction &func, uint64_t image_base, ICommand *command);
+	static void ReadData(AbstractStream &stream, Data &data, uint32_t key);
 	void Notify(MessageType type, IObject *sender, const std::string &message = "") const;
 	FileManager *owner() const { return owner_; }
 	InternalFileAction action() const { return action_; }
@@ -295,6 +299,8 @@ public:
 	InternalFile *Add(const std::string &name, const std::string &file_name, InternalFileAction action, FileFolder *folder);
 	bool OpenFiles();
 	void CloseFiles();
+	void ReadData(std::vector<Data> &data_list, uint32_t key, size_t thread_count) const;
+	void WriteData(IFunction &func, uint64_t image_base, uint32_t key, size_t thread_count);
 	void Notify(MessageType type, IObject *sender, const std::string &message = "") const;
 	Core *owner() const { return owner_; }
 	uint32_t GetRuntimeOptions() const;
@@ -529,6 +535,10 @@ public:
 	void set_vm_section_name(const std::string &vm_section_name);
 	void set_watermark_name(const std::string &watermark_name);
 	void set_output_file_name(const std::string &output_file_name);
+	std::string function_report_file_name() const { return function_report_file_name_; }
+	void set_function_report_file_name(const std::string &function_report_file_name) { function_report_file_name_ = function_report_file_name; }
+	size_t thread_count() const { return thread_count_; }
+	void set_thread_count(size_t thread_count) { thread_count_ = thread_count; }
 	std::string message(size_t type) const { return messages_[type]; }
 	void set_message(size_t type, const std::string &message);
 #ifdef ULTIMATE
@@ -576,6 +586,8 @@ private:
 	ProjectTemplateManager *template_manager_;
 	std::string output_file_name_;
 	std::string watermark_name_;
+	std::string function_report_file_name_;
+	size_t thread_count_;
 	std::string messages_[MESSAGE_COUNT];
 	IFile *output_file_;
 	ILog *log_;
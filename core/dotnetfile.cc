@@ -4943,7 +4943,7 @@ ILModule::ILModule(ILMetaData *meta, ILTable *owner, const std::string &name)
 	: ILToken(meta, owner, ttModule), generation_(0), name_pos_(0), mv_id_pos_(0), enc_id_pos_(0), enc_base_id_pos_(0), name_(name)
 {
 	for (size_t i = 0; i < 16; i++) {
-		mv_id_.push_back(rand());
+		mv_id_.push_back(Random());
 	}
 }
 
@@ -8503,7 +8503,7 @@ void NETArchitecture::Save(CompileContext &ctx)
 				continue;
 
 			for (j = 0; j < region->size(); j++) {
-				WriteByte((region->type() & mtReadable) ? rand() : 0);
+				WriteByte((region->type() & mtReadable) ? Random() : 0);
 			}
 		}
 	}
@@ -12227,6 +12227,8 @@ AssemblyResolver::~AssemblyResolver()
 
 void AssemblyResolver::Prepare()
 {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
 	framework_path_map_.clear();
 	for (std::map<std::string, PEFile *>::const_iterator it = cache_.begin(); it != cache_.end();) {
 		if (!it->second)
@@ -12238,6 +12240,8 @@ void AssemblyResolver::Prepare()
 
 ILMetaData *AssemblyResolver::Resolve(const ILMetaData &source, const std::string &orig_name)
 {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
 	std::map<std::string, PEFile *>::const_iterator cache_it = cache_.find(orig_name);
 	if (cache_it != cache_.end())
 		return cache_it->second ? reinterpret_cast<NETArchitecture *>(cache_it->second->item(1))->command_list() : NULL;
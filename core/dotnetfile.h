@@ -2836,6 +2836,8 @@ private:
 	std::map<std::string, FrameworkRedirectInfo, ci_less> redirect_v2_map_;
 	std::map<std::string, FrameworkRedirectInfo, ci_less> redirect_v4_map_;
 	std::map<std::string, FrameworkInfo> framework_path_map_;
+	// the resolver is shared by all opened files
+	std::recursive_mutex mutex_;
 };
 
 #endif
\ No newline at end of file
@@ -382,6 +382,7 @@ enum : unsigned {
 	SHT_PREINIT_ARRAY = 16, // Pointers to pre-init functions.
 	SHT_GROUP         = 17, // Section group.
 	SHT_SYMTAB_SHNDX  = 18, // Indices for SHN_XINDEX entries.
+	SHT_RELR          = 19, // Relocation entries; packed relative relocations.
 	SHT_LOOS          = 0x60000000, // Lowest operating system-specific type.
 	SHT_GNU_ATTRIBUTES= 0x6ffffff5, // Object attributes.
 	SHT_GNU_HASH      = 0x6ffffff6, // GNU-style hash table.
@@ -552,6 +553,9 @@ enum {
 	DT_ENCODING     = 32,       // Values from here to DT_LOOS follow the rules for the interpretation of the d_un union.
 	DT_PREINIT_ARRAY = 32,      // Pointer to array of preinit functions.
 	DT_PREINIT_ARRAYSZ = 33,    // Size of the DT_PREINIT_ARRAY array.
+	DT_RELRSZ       = 35,       // Size of Relr relocation table.
+	DT_RELR         = 36,       // Address of relocation table (Relr entries).
+	DT_RELRENT      = 37,       // Size of a Relr relocation entry.
 
 	DT_LOOS         = 0x60000000, // Start of environment specific tags.
 	DT_HIOS         = 0x6FFFFFFF, // End of environment specific tags.
@@ -165,6 +165,12 @@ std::string ELFDirectory::name() const
 		return std::string("DT_PREINIT_ARRAY");
 	case DT_PREINIT_ARRAYSZ:
 		return std::string("DT_PREINIT_ARRAYSZ");
+	case DT_RELRSZ:
+		return std::string("DT_RELRSZ");
+	case DT_RELR:
+		return std::string("DT_RELR");
+	case DT_RELRENT:
+		return std::string("DT_RELRENT");
 	case DT_GNU_HASH:
 		return std::string("DT_GNU_HASH");
 	case DT_RELACOUNT:
@@ -572,6 +578,12 @@ ELFSegment *ELFSegmentList::GetSectionByType(uint32_t type) const
  * ELFStringTable
  */
 
+ELFStringTable::ELFStringTable()
+	: saved_size_(0)
+{
+
+}
+
 ELFStringTable *ELFStringTable::Clone()
 {
 	ELFStringTable *table = new ELFStringTable(*this);
@@ -613,11 +625,67 @@ uint32_t ELFStringTable::AddString(const std::string &str)
 	return res;
 };
 
+typedef std::pair<std::string, std::map<std::string, uint32_t>::iterator> ReversedString;
+
+static bool CompareReversedStrings(const ReversedString &left, const ReversedString &right)
+{
+	return left.first > right.first;
+}
+
+/**
+ * Rebuilds the table so that a string which is a suffix of another string points into its tail (like "ld -O2" does).
+ * Reversed strings are sorted in descending order, so every suffix directly follows the strings it can be merged into.
+ */
+void ELFStringTable::Pack()
+{
+	typedef std::map<std::string, uint32_t>::iterator StringIterator;
+	std::vector<ReversedString> list;
+	size_t i;
+
+	list.reserve(map_.size());
+	for (StringIterator it = map_.begin(); it != map_.end(); it++) {
+		list.push_back(std::make_pair(std::string(it->first.rbegin(), it->first.rend()), it));
+	}
+	std::sort(list.begin(), list.end(), CompareReversedStrings);
+
+	std::vector<size_t> owner(list.size());
+	std::vector<std::pair<uint32_t, size_t> > unmerged;
+	for (i = 0; i < list.size(); i++) {
+		const std::string &str = list[i].first;
+		if (i > 0 && list[i - 1].first.compare(0, str.size(), str) == 0) {
+			owner[i] = owner[i - 1];
+		} else {
+			owner[i] = i;
+			unmerged.push_back(std::make_pair(list[i].second->second, i));
+		}
+	}
+
+	// unmerged strings keep the order in which they were added
+	std::sort(unmerged.begin(), unmerged.end());
+	size_t old_size = data_.size();
+	data_.clear();
+	data_.push_back(0);
+	for (i = 0; i < unmerged.size(); i++) {
+		StringIterator it = list[unmerged[i].second].second;
+		it->second = static_cast<uint32_t>(data_.size());
+		data_.insert(data_.end(), it->first.c_str(), it->first.c_str() + it->first.size() + 1);
+	}
+	for (i = 0; i < list.size(); i++) {
+		if (owner[i] == i)
+			continue;
+
+		StringIterator it = list[owner[i]].second;
+		list[i].second->second = static_cast<uint32_t>(it->second + it->first.size() - list[i].first.size());
+	}
+	saved_size_ = old_size - data_.size();
+}
+
 void ELFStringTable::clear() 
 { 
 	data_.clear();
 	data_.push_back(0);
 	map_.clear();
+	saved_size_ = 0;
 }
 
 void ELFStringTable::ReadFromFile(ELFArchitecture &file)
@@ -1298,7 +1366,7 @@ void ELFFixup::Rebase(IArchitecture &file, uint64_t delta_base)
  */
 
 ELFFixupList::ELFFixupList()
-	: BaseFixupList()
+	: BaseFixupList(), use_relr_(false)
 {
 
 }
@@ -1306,7 +1374,7 @@ ELFFixupList::ELFFixupList()
 ELFFixupList::ELFFixupList(const ELFFixupList &src)
 	: BaseFixupList(src)
 {
-
+	use_relr_ = src.use_relr_;
 }
 
 ELFFixupList *ELFFixupList::Clone() const
@@ -1381,6 +1449,84 @@ void ELFFixupList::WriteToData(Data &data, uint64_t image_base)
 	}
 }
 
+/**
+ * Returns true if the fixup can be stored in DT_RELR, it must be an aligned pointer.
+ */
+bool ELFFixupList::is_relr(const ELFFixup &fixup, OperandSize cpu_address_size)
+{
+	return (fixup.size() == cpu_address_size && (fixup.address() & (OperandSizeToValue(cpu_address_size) - 1)) == 0);
+}
+
+/**
+ * Reads DT_RELR table from the current position. An even entry is the address of a relocation, an odd entry is a bitmap
+ * of the next 31/63 words after the last processed address.
+ */
+void ELFFixupList::ReadRelrFromFile(ELFArchitecture &file, uint64_t size)
+{
+	OperandSize cpu_address_size = file.cpu_address_size();
+	uint64_t word_size = OperandSizeToValue(cpu_address_size);
+	uint64_t address = 0;
+	for (uint64_t i = 0; i < size; i += word_size) {
+		uint64_t value = (cpu_address_size == osDWord) ? file.ReadDWord() : file.ReadQWord();
+		if ((value & 1) == 0) {
+			address = value;
+			Add(address, cpu_address_size);
+			address += word_size;
+		} else {
+			uint64_t fixup_address = address;
+			for (value >>= 1; value; value >>= 1) {
+				if (value & 1)
+					Add(fixup_address, cpu_address_size);
+				fixup_address += word_size;
+			}
+			address += (word_size * 8 - 1) * word_size;
+		}
+	}
+	use_relr_ = true;
+}
+
+void ELFFixupList::WriteRelrToData(Data &data, OperandSize cpu_address_size)
+{
+	size_t i;
+	std::vector<uint64_t> address_list;
+
+	Sort();
+
+	for (i = 0; i < count(); i++) {
+		ELFFixup *fixup = item(i);
+		if (is_relr(*fixup, cpu_address_size) && (address_list.empty() || address_list.back() != fixup->address()))
+			address_list.push_back(fixup->address());
+	}
+
+	uint64_t word_size = OperandSizeToValue(cpu_address_size);
+	uint64_t bit_count = word_size * 8 - 1;
+	for (i = 0; i < address_list.size(); ) {
+		uint64_t address = address_list[i++];
+		if (cpu_address_size == osDWord)
+			data.PushDWord(static_cast<uint32_t>(address));
+		else
+			data.PushQWord(address);
+		address += word_size;
+		for (;;) {
+			uint64_t bitmap = 0;
+			while (i < address_list.size()) {
+				uint64_t delta = address_list[i] - address;
+				if (delta >= bit_count * word_size)
+					break;
+				bitmap |= 1ull << (delta / word_size);
+				i++;
+			}
+			if (!bitmap)
+				break;
+			if (cpu_address_size == osDWord)
+				data.PushDWord(static_cast<uint32_t>(bitmap << 1 | 1));
+			else
+				data.PushQWord(bitmap << 1 | 1);
+			address += bit_count * word_size;
+		}
+	}
+}
+
 /**
  * ELFExport
  */
@@ -1754,7 +1900,7 @@ static uint32_t compute_bucket_count(size_t symbol_count)
 
 size_t ELFSymbolList::WriteHash(ELFArchitecture &file)
 {
-	std::vector<ELFSymbol *> hashed_symbols;
+	std::vector<uint32_t> hashed_indexes;
 	std::vector<uint32_t> hashes;
 	size_t i;
 	ELFSymbol *symbol;
@@ -1762,20 +1908,19 @@ size_t ELFSymbolList::WriteHash(ELFArchitecture &file)
 	for (i = 0; i < count(); i++) {
 		symbol = item(i);
 		if (symbol->need_hash()) {
-			hashed_symbols.push_back(symbol);
+			hashed_indexes.push_back(static_cast<uint32_t>(i));
 			hashes.push_back(elf_hash(symbol->name().c_str()));
 		}
 	}
 
-	uint32_t bucket_count = compute_bucket_count(hashed_symbols.size());
+	uint32_t bucket_count = compute_bucket_count(hashed_indexes.size());
 
 	std::vector<uint32_t> buckets(bucket_count);
 	std::vector<uint32_t> chains(count());
 
-	for (i = 0; i < hashed_symbols.size(); i++) {
-		symbol = hashed_symbols[i];
+	for (i = 0; i < hashed_indexes.size(); i++) {
 		uint32_t bucket = hashes[i] % bucket_count;
-		uint32_t index = static_cast<uint32_t>(IndexOf(symbol));
+		uint32_t index = hashed_indexes[i];
 		chains[index] = buckets[bucket];
 		buckets[bucket] = index;
 	}
@@ -1799,7 +1944,6 @@ size_t ELFSymbolList::WriteGNUHash(ELFArchitecture &file)
 	std::vector<uint32_t> hashes;
 	size_t i;
 	ELFSymbol *symbol;
-	std::map<size_t, ELFSymbol *> sym_index_map;
 
 	for (i = 0; i < count(); i++) {
 		symbol = item(i);
@@ -1811,12 +1955,10 @@ size_t ELFSymbolList::WriteGNUHash(ELFArchitecture &file)
 		}
 	}
 
-	uint32_t symbol_base = 0;
-	for (i = 0; i < unhashed_symbols.size(); i++) {
-		symbol = unhashed_symbols[i];
-		RemoveObject(symbol);
-		InsertObject(symbol_base++, symbol);
-	}
+	// unhashed symbols go first, hashed symbols are grouped by buckets after them
+	uint32_t symbol_base = static_cast<uint32_t>(unhashed_symbols.size());
+	std::vector<ELFSymbol *> symbol_order(unhashed_symbols);
+	symbol_order.resize(count());
 
 	size_t symbol_count = hashed_symbols.size();
 	uint32_t bucket_count = compute_bucket_count(symbol_count);
@@ -1876,18 +2018,10 @@ size_t ELFSymbolList::WriteGNUHash(ELFArchitecture &file)
 			val |= 1;
 		chains[indx[bucket] - symbol_base] = val;
 		--counts[bucket];
-		sym_index_map[indx[bucket]] = symbol;
+		symbol_order[indx[bucket]] = symbol;
 		++indx[bucket];
 	}
-
-	for (std::map<size_t, ELFSymbol*>::const_iterator it = sym_index_map.begin(); it != sym_index_map.end(); it++) {
-		i = it->first;
-		symbol = it->second;
-		if (item(i) != symbol) {
-			RemoveObject(symbol);
-			InsertObject(i, symbol);
-		}
-	}
+	v_.swap(symbol_order);
 
 	file.WriteDWord(bucket_count);
 	file.WriteDWord(symbol_base);
@@ -1928,6 +2062,15 @@ void ELFSymbolList::WriteToFile(ELFArchitecture &file)
 		if (!symtab)
 			return;
 
+		// all strings are added before they are written, so that suffixes can be merged
+		for (size_t i = 0; i < count(); i++) {
+			string_table_.AddString(item(i)->name());
+		}
+		file.command_list()->WriteStrings(string_table_);
+		file.verdef_list()->WriteStrings(string_table_);
+		file.verneed_list()->WriteStrings(string_table_);
+		string_table_.Pack();
+
 		ELFDirectory *hash = file.command_list()->GetCommandByType(DT_GNU_HASH);
 		if (hash) {
 			section = file.section_list()->GetSectionByType(SHT_GNU_HASH);
@@ -1981,6 +2124,8 @@ void ELFSymbolList::WriteToFile(ELFArchitecture &file)
 		pos = file.Tell();
 		address = file.AddressTell();
 		size = string_table_.WriteToFile(file);
+		if (string_table_.saved_size())
+			file.Notify(mtInformation, NULL, string_format(language[lsMergedStrings].c_str(), ".dynstr", static_cast<int>(string_table_.saved_size())));
 
 		if (section) {
 			section = file.section_list()->item(section->link());
@@ -2020,6 +2165,11 @@ void ELFSymbolList::WriteToFile(ELFArchitecture &file)
 		if (!section)
 			return;
 
+		for (size_t i = 0; i < count(); i++) {
+			string_table_.AddString(item(i)->name());
+		}
+		string_table_.Pack();
+
 		pos = section->alignment() > 1 ? file.Resize(AlignValue(file.Tell(), section->alignment())) : file.Tell();
 		address = file.AddressTell();
 		size = 0;
@@ -2034,6 +2184,8 @@ void ELFSymbolList::WriteToFile(ELFArchitecture &file)
 		pos = file.Tell();
 		address = file.AddressTell();
 		size = string_table_.WriteToFile(file);
+		if (string_table_.saved_size())
+			file.Notify(mtInformation, NULL, string_format(language[lsMergedStrings].c_str(), ".strtab", static_cast<int>(string_table_.saved_size())));
 		section = file.section_list()->item(section->link());
 		if (section->address())
 			section->Rebase(address - section->address());
@@ -2042,6 +2194,24 @@ void ELFSymbolList::WriteToFile(ELFArchitecture &file)
 	}
 }
 
+std::map<const ELFSymbol *, size_t> ELFSymbolList::GetIndexMap() const
+{
+	std::map<const ELFSymbol *, size_t> res;
+	for (size_t i = 0; i < count(); i++) {
+		res[item(i)] = i;
+	}
+	return res;
+}
+
+/**
+ * Returns the index of the symbol from the map built by GetIndexMap, or -1 like IndexOf does.
+ */
+static size_t SymbolIndex(const std::map<const ELFSymbol *, size_t> &index_map, const ELFSymbol *symbol)
+{
+	std::map<const ELFSymbol *, size_t>::const_iterator it = index_map.find(symbol);
+	return (it == index_map.end()) ? -1 : it->second;
+}
+
 void ELFSymbolList::Pack()
 {
 	for (size_t i = count(); i > 0 ; i--) {
@@ -2664,13 +2834,13 @@ ELFRelocation *ELFRelocation::Clone(IRelocationList *owner) const
 	return relocation;
 }
 
-size_t ELFRelocation::WriteToFile(ELFArchitecture &file)
+size_t ELFRelocation::WriteToFile(ELFArchitecture &file, size_t symbol_index)
 {
 	size_t res = 0;
 	if (file.cpu_address_size() == osDWord) {
 		Elf32_Rel rel;
 		rel.r_offset = static_cast<uint32_t>(address());
-		rel.r_info = (static_cast<uint32_t>(file.dynsymbol_list()->IndexOf(symbol_)) << 8) | type_;
+		rel.r_info = (static_cast<uint32_t>(symbol_index) << 8) | type_;
 		res += file.Write(&rel, sizeof(rel));
 		if (is_rela_)
 			res += file.WriteDWord(static_cast<uint32_t>(addend_));
@@ -2678,7 +2848,7 @@ size_t ELFRelocation::WriteToFile(ELFArchitecture &file)
 		Elf64_Rel rel;
 		rel.r_offset = address();
 		rel.r_type = type_;
-		rel.r_ssym = static_cast<uint32_t>(file.dynsymbol_list()->IndexOf(symbol_));
+		rel.r_ssym = static_cast<uint32_t>(symbol_index);
 		res += file.Write(&rel, sizeof(rel));
 		if (is_rela_)
 			res += file.WriteQWord(addend_);
@@ -2816,6 +2986,15 @@ void ELFRelocationList::ReadFromFile(ELFArchitecture &file)
 		}
 	}
 
+	ELFDirectory *relr = file.command_list()->GetCommandByType(DT_RELR);
+	if (relr) {
+		ELFDirectory *sz = file.command_list()->GetCommandByType(DT_RELRSZ);
+		if (!sz || !file.AddressSeek(relr->value()))
+			throw std::runtime_error("Invalid format");
+
+		file.fixup_list()->ReadRelrFromFile(file, sz->value());
+	}
+
 	if (cpu_address_size == osDWord) {
 		for (i = 0; i < count(); i++) {
 			ELFRelocation *reloc = item(i);
@@ -2852,13 +3031,22 @@ void ELFRelocationList::WriteToFile(ELFArchitecture &file)
 		reloc_list[j].push_back(reloc);
 	}
 
-	if (file.fixup_list()->count()) {
+	// fixups of files that used DT_RELR are packed again, the rest of fixups are converted into relocations
+	bool use_relr = file.fixup_list()->use_relr();
+	std::vector<ELFFixup *> rel_fixup_list;
+	for (i = 0; i < file.fixup_list()->count(); i++) {
+		ELFFixup *fixup = file.fixup_list()->item(i);
+		if (!use_relr || !ELFFixupList::is_relr(*fixup, file.cpu_address_size()))
+			rel_fixup_list.push_back(fixup);
+	}
+
+	if (rel_fixup_list.size()) {
 		// convert fixups into relocations
 		std::vector<ELFRelocation *> fixup_list;
 		uint64_t pos = file.Tell();
 		bool is_rela = reloc_list[1].size() > 0;
-		for (i = 0; i < file.fixup_list()->count(); i++) {
-			ELFFixup *fixup = file.fixup_list()->item(i);
+		for (i = 0; i < rel_fixup_list.size(); i++) {
+			ELFFixup *fixup = rel_fixup_list[i];
 			uint64_t addend = 0;
 			if (is_rela && file.AddressSeek(fixup->address()))
 				addend = (file.cpu_address_size() == osDWord) ? file.ReadDWord() : file.ReadQWord();
@@ -2895,6 +3083,7 @@ void ELFRelocationList::WriteToFile(ELFArchitecture &file)
 		section_list[j] = section;
 	}
 
+	std::map<const ELFSymbol *, size_t> symbol_index_map = file.dynsymbol_list()->GetIndexMap();
 	for (i = 0; i < _countof(reloc_list); i++) {
 		ELFSection *section = section_list[i];
 		size_t size = 0;
@@ -2902,7 +3091,7 @@ void ELFRelocationList::WriteToFile(ELFArchitecture &file)
 		uint64_t address = file.AddressTell();
 		for (k = 0; k < reloc_list[i].size(); k++) {
 			reloc = reloc_list[i].at(k);
-			size += reloc->WriteToFile(file);
+			size += reloc->WriteToFile(file, SymbolIndex(symbol_index_map, reloc->symbol()));
 		}
 		if (section) {
 			section->Rebase(address - section->address());
@@ -2920,6 +3109,33 @@ void ELFRelocationList::WriteToFile(ELFArchitecture &file)
 			}
 		}
 	}
+
+	if (use_relr) {
+		Data relr_data;
+		file.fixup_list()->WriteRelrToData(relr_data, file.cpu_address_size());
+
+		ELFSection *section = file.section_list()->GetSectionByType(SHT_RELR);
+		uint64_t pos = (section && section->alignment() > 1) ? file.Resize(AlignValue(file.Tell(), section->alignment())) : file.Tell();
+		uint64_t address = file.AddressTell();
+		size_t size = relr_data.size() ? file.Write(relr_data.data(), relr_data.size()) : 0;
+		if (section) {
+			section->Rebase(address - section->address());
+			section->set_physical_offset(static_cast<uint32_t>(pos));
+			section->set_size(static_cast<uint32_t>(size));
+		}
+
+		const uint32_t relr_dir_types[3] = {DT_RELR, DT_RELRSZ, DT_RELRENT};
+		for (k = 0; k < _countof(relr_dir_types); k++) {
+			dir = file.command_list()->GetCommandByType(relr_dir_types[k]);
+			if (size) {
+				if (!dir)
+					dir = file.command_list()->Add(relr_dir_types[k]);
+				dir->set_value((k == 0) ? address : (k == 1) ? size : OperandSizeToValue(file.cpu_address_size()));
+			} else if (dir) {
+				delete dir;
+			}
+		}
+	}
 }
 
 void ELFRelocationList::Pack()
@@ -3886,13 +4102,14 @@ ELFArchitecture::ELFArchitecture(ELFFile *owner, const ELFArchitecture &src)
 	if (src.virtual_machine_list_)
 		virtual_machine_list_ = src.virtual_machine_list_->Clone();
 
+	std::map<const ELFSymbol *, size_t> symbol_index_map = src.dynsymbol_list_->GetIndexMap();
 	for (i = 0; i < src.relocation_list()->count(); i++) {
 		ELFRelocation *src_reloc = src.relocation_list()->item(i);
 		ELFSymbol *src_symbol = src_reloc->symbol();
 		if (!src_symbol)
 			continue;
 
-		relocation_list_->item(i)->set_symbol(dynsymbol_list_->item(src.dynsymbol_list()->IndexOf(src_symbol)));
+		relocation_list_->item(i)->set_symbol(dynsymbol_list_->item(SymbolIndex(symbol_index_map, src_symbol)));
 	}
 
 	for (i = 0; i < src.import_list()->count(); i++) {
@@ -3908,14 +4125,14 @@ ELFArchitecture::ELFArchitecture(ELFFile *owner, const ELFArchitecture &src)
 			if (!src_symbol)
 				continue;
 
-			import_function->set_symbol(dynsymbol_list_->item(src.dynsymbol_list()->IndexOf(src_symbol)));
+			import_function->set_symbol(dynsymbol_list_->item(SymbolIndex(symbol_index_map, src_symbol)));
 		}
 	}
 
 	for (i = 0; i < src.export_list()->count(); i++) {
 		ELFSymbol *symbol = src.export_list()->item(i)->symbol();
 		if (symbol)
-			export_list_->item(i)->set_symbol(dynsymbol_list_->item(src.dynsymbol_list_->IndexOf(symbol)));
+			export_list_->item(i)->set_symbol(dynsymbol_list_->item(SymbolIndex(symbol_index_map, symbol)));
 	}
 
 	if (function_list_) {
@@ -4117,35 +4334,59 @@ OpenStatus ELFArchitecture::ReadFromFile(uint32_t mode)
 	}
 
 	if ((mode & foHeaderOnly) == 0) {
-		if (!owner()->file_name().empty()) {
-			MapFile map_file;
-			std::vector<uint64_t> segments;
-			for (size_t i = 0; i < segment_list()->count(); i++) {
-				segments.push_back(segment_list()->item(i)->address());
-			}
-			if (std::find(segments.begin(), segments.end(), 0) == segments.end())
-				segments.insert(segments.begin(), 0);
-			if (map_file.Parse(map_file_name().c_str(), segments))
-				ReadMapFile(map_file);
+		std::auto_ptr<AnalysisCache> cache;
+		bool is_cached = false;
+		if (mode & foUseCache) {
+			cache.reset(new AnalysisCache(this, std::vector<std::string>(1, map_file_name())));
+			is_cached = cache->Load();
 		}
 
-		for (size_t k = 0; k < 2; k++) {
-			ELFSymbolList *symbol_list = (k == 0) ? dynsymbol_list_ : symbol_list_;
+		if (!is_cached) {
+			if (!owner()->file_name().empty()) {
+				MapFile map_file;
+				std::vector<uint64_t> segments;
+				for (size_t i = 0; i < segment_list()->count(); i++) {
+					segments.push_back(segment_list()->item(i)->address());
+				}
+				if (std::find(segments.begin(), segments.end(), 0) == segments.end())
+					segments.insert(segments.begin(), 0);
+				if (map_file.Parse(map_file_name().c_str(), segments))
+					ReadMapFile(map_file);
+			}
+
+			std::vector<std::string> symbol_names;
+			std::vector<size_t> name_index_list(symbol_list_->count(), NOT_ID);
 			for (i = 0; i < symbol_list_->count(); i++) {
 				ELFSymbol *symbol = symbol_list_->item(i);
 				if (symbol->type() != STT_FUNC && symbol->type() != STT_OBJECT && !symbol->section_idx())
 					continue;
 
-				MapFunction *map_function = map_function_list()->GetFunctionByAddress(symbol->address());
-				if (!map_function)
-					map_function = map_function_list()->Add(symbol->address(), 0, otUnknown, DemangleName(symbol->name()));
-
-				ObjectType type = (symbol->type() == STT_FUNC && (segment_list_->GetMemoryTypeByAddress(symbol->address()) & mtExecutable)) ? otCode : otData;
-				map_function->set_type(type);
+				if (!map_function_list()->GetFunctionByAddress(symbol->address())) {
+					name_index_list[i] = symbol_names.size();
+					symbol_names.push_back(symbol->name());
+				}
+			}
+			std::vector<FunctionName> demangled_names = DemangleNames(symbol_names);
+
+			for (size_t k = 0; k < 2; k++) {
+				ELFSymbolList *symbol_list = (k == 0) ? dynsymbol_list_ : symbol_list_;
+				for (i = 0; i < symbol_list_->count(); i++) {
+					ELFSymbol *symbol = symbol_list_->item(i);
+					if (symbol->type() != STT_FUNC && symbol->type() != STT_OBJECT && !symbol->section_idx())
+						continue;
+
+					MapFunction *map_function = map_function_list()->GetFunctionByAddress(symbol->address());
+					if (!map_function)
+						map_function = map_function_list()->Add(symbol->address(), 0, otUnknown,
+							(name_index_list[i] == NOT_ID) ? DemangleName(symbol->name()) : demangled_names[name_index_list[i]]);
+
+					ObjectType type = (symbol->type() == STT_FUNC && (segment_list_->GetMemoryTypeByAddress(symbol->address()) & mtExecutable)) ? otCode : otData;
+					map_function->set_type(type);
+				}
 			}
-		}
 
-		map_function_list()->ReadFromFile(*this);
+			map_function_list()->ReadFromFile(*this);
+		}
 
 		switch (cpu_) {
 		case EM_386:
@@ -4153,9 +4394,11 @@ OpenStatus ELFArchitecture::ReadFromFile(uint32_t mode)
 		case EM_X86_64:
 			function_list_ = new ELFIntelFunctionList(this);
 			virtual_machine_list_ = new IntelVirtualMachineList();
-			{
+			if (!is_cached) {
 				IntelFileHelper helper;
 				helper.Parse(*this);
+				if (cache.get())
+					cache->Save();
 			}
 			break;
 		default:
@@ -4888,7 +5131,7 @@ void ELFArchitecture::Save(CompileContext &ctx)
 				continue;
 
 			for (j = 0; j < region->size(); j++) {
-				b = (region->type() & mtReadable) ? rand() : 0xcc;
+				b = (region->type() & mtReadable) ? Random() : 0xcc;
 				Write(&b, sizeof(b));
 			}
 		}
@@ -128,17 +128,21 @@ private:
 class ELFStringTable
 {
 public:
+	explicit ELFStringTable();
 	ELFStringTable *Clone();
 	std::string GetString(uint32_t pos) const;
 	uint32_t AddString(const std::string &str);
+	void Pack();
 	void clear();
 	void ReadFromFile(ELFArchitecture &file);
 	void ReadFromFile(ELFArchitecture &file, const ELFSection &section);
 	size_t WriteToFile(ELFArchitecture &file);
 	size_t size() const { return data_.size(); }
+	size_t saved_size() const { return saved_size_; }
 private:
 	std::vector<char> data_;
 	std::map<std::string, uint32_t> map_;
+	size_t saved_size_;
 };
 
 class ELFSectionList : public BaseSectionList
@@ -247,6 +251,13 @@ public:
 	virtual IFixup *AddDefault(OperandSize cpu_address_size, bool is_code);
 	ELFFixup *Add(uint64_t address, OperandSize size);
 	void WriteToData(Data &data, uint64_t image_base);
+	void ReadRelrFromFile(ELFArchitecture &file, uint64_t size);
+	void WriteRelrToData(Data &data, OperandSize cpu_address_size);
+	static bool is_relr(const ELFFixup &fixup, OperandSize cpu_address_size);
+	bool use_relr() const { return use_relr_; }
+	void set_use_relr(bool use_relr) { use_relr_ = use_relr; }
+private:
+	bool use_relr_;
 };
 
 class ELFExport : public BaseExport
@@ -341,6 +352,7 @@ public:
 	void WriteToFile(ELFArchitecture &file);
 	void Pack();
 	void Rebase(uint64_t delta_base);
+	std::map<const ELFSymbol *, size_t> GetIndexMap() const;
 	ELFStringTable *string_table() { return &string_table_; }
 private:
 	ELFSymbol *Add();
@@ -476,7 +488,7 @@ public:
 	explicit ELFRelocation(ELFRelocationList *owner, bool is_rela, uint64_t address, OperandSize size, uint32_t type, ELFSymbol *symbol, uint64_t addend);
 	explicit ELFRelocation(ELFRelocationList *owner, const ELFRelocation &src);
 	ELFRelocation *Clone(IRelocationList *owner) const;
-	size_t WriteToFile(ELFArchitecture &file);
+	size_t WriteToFile(ELFArchitecture &file, size_t symbol_index);
 	virtual void Rebase(IArchitecture &file, uint64_t delta_base);
 	ELFSymbol *symbol() const { return symbol_; }
 	void set_symbol(ELFSymbol *symbol) { symbol_ = symbol; }
@@ -102,6 +102,67 @@ std::string DisplayValue(OperandSize size, uint64_t value)
 	return string_format(format, value);
 }
 
+void EncryptData(uint8_t *data, size_t size, uint64_t position, uint32_t key)
+{
+	// the key stream byte at position i is (_rotl32(key, i) + i), so it repeats every 256 bytes
+	uint8_t key_stream[0x100 + sizeof(uint64_t)];
+	for (size_t i = 0; i < sizeof(key_stream); i++) {
+		key_stream[i] = static_cast<uint8_t>(_rotl32(key, static_cast<int>(i)) + i);
+	}
+
+	size_t k = static_cast<size_t>(position & 0xff);
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t value, mask;
+		memcpy(&value, data + i, sizeof(value));
+		memcpy(&mask, key_stream + k, sizeof(mask));
+		value ^= mask;
+		memcpy(data + i, &value, sizeof(value));
+		k = (k + sizeof(uint64_t)) & 0xff;
+	}
+	for (; i < size; i++) {
+		data[i] ^= key_stream[k];
+		k = (k + 1) & 0xff;
+	}
+}
+
+/**
+ * Returns for every item of data_list the index of the first item with the same content.
+ * Items are grouped by their SHA-1 and compared byte by byte inside a group, empty items are never merged.
+ */
+std::vector<size_t> FindDuplicates(const std::vector<Data> &data_list, size_t thread_count)
+{
+	std::vector<std::string> hash_list(data_list.size());
+	ParallelFor(data_list.size(), thread_count, [&](size_t, size_t index) {
+		const Data &data = data_list[index];
+		if (!data.size())
+			return;
+		SHA1 sha;
+		sha.Input(data.data(), data.size());
+		hash_list[index].assign(reinterpret_cast<const char *>(sha.Result()), sha.ResultSize());
+	});
+
+	std::vector<size_t> res(data_list.size());
+	std::map<std::string, std::vector<size_t> > hash_map;
+	for (size_t i = 0; i < data_list.size(); i++) {
+		res[i] = i;
+		if (hash_list[i].empty())
+			continue;
+
+		std::vector<size_t> &index_list = hash_map[hash_list[i]];
+		for (size_t j = 0; j < index_list.size(); j++) {
+			const Data &data = data_list[index_list[j]];
+			if (data.size() == data_list[i].size() && memcmp(data.data(), data_list[i].data(), data.size()) == 0) {
+				res[i] = index_list[j];
+				break;
+			}
+		}
+		if (res[i] == i)
+			index_list.push_back(i);
+	}
+	return res;
+}
+
 extern "C" {
 	void *C_alloca(size_t size)
 	{
@@ -126,13 +187,21 @@ static FunctionName demangle_gcc(const std::string &name)
 	return FunctionName(res);
 }
 
+// unmangle keeps its state in global variables
+static std::mutex borland_mutex;
+
 static FunctionName demangle_borland(const std::string &name)
 {
+	// unmangle rejects names without the leading '@' before touching its state
+	if (name.empty() || name[0] != '@')
+		return FunctionName("");
+
 	std::string name_to_demangle = name;
 
     char demangled_name[1024];
 	demangled_name[0] = 0;
 
+	std::lock_guard<std::mutex> lock(borland_mutex);
 	int code = unmangle(&name_to_demangle[0], demangled_name, sizeof(demangled_name), NULL, NULL, 1);
 	if ((code & (UM_BUFOVRFLW | UM_ERROR | UM_NOT_MANGLED)) == 0)
 		return FunctionName(demangled_name);
@@ -187,6 +256,33 @@ FunctionName DemangleName(const std::string &name)
 	return name;
 }
 
+std::vector<FunctionName> DemangleNames(const std::vector<std::string> &names)
+{
+	size_t i;
+	std::unordered_map<std::string, size_t> unique_map;
+	std::vector<const std::string *> unique_names;
+	std::vector<size_t> index_list(names.size());
+	for (i = 0; i < names.size(); i++) {
+		auto it = unique_map.insert(std::make_pair(names[i], unique_names.size()));
+		if (it.second)
+			unique_names.push_back(&names[i]);
+		index_list[i] = it.first->second;
+	}
+
+	// every worker should get enough names to pay for its start
+	std::vector<FunctionName> unique_res(unique_names.size());
+	ParallelFor(unique_names.size(), GetThreadCount(unique_names.size() / 256 + 1), [&](size_t, size_t index) {
+		unique_res[index] = DemangleName(*unique_names[index]);
+	});
+
+	std::vector<FunctionName> res;
+	res.reserve(names.size());
+	for (i = 0; i < names.size(); i++) {
+		res.push_back(unique_res[index_list[i]]);
+	}
+	return res;
+}
+
 /**
  * BaseLoadCommand
  */
@@ -1240,22 +1336,56 @@ MapFile::MapFile()
 
 }
 
-static const char *skip_spaces(const char *str)
+/**
+ * A token of a map file, points into the mapped file text.
+ */
+struct MapToken {
+	const char *begin;
+	const char *end;
+
+	MapToken(const char *begin_, const char *end_) : begin(begin_), end(end_) {}
+	std::string str() const { return std::string(begin, end); }
+	bool starts_with(const char *prefix) const
+	{
+		size_t size = strlen(prefix);
+		return (static_cast<size_t>(end - begin) >= size && memcmp(begin, prefix, size) == 0);
+	}
+	bool contains(const char *value) const
+	{
+		return std::search(begin, end, value, value + strlen(value)) != end;
+	}
+};
+
+static const char *skip_spaces(const char *str, const char *end)
 {
-	while (*str && isspace(*str))
+	while (str < end && isspace(static_cast<unsigned char>(*str)))
 		str++;
 	return str;
 }
 
-static int cmp_skip_spaces(const char *str1, const char *str2)
+// the same as strncmp for the line ending at end
+static int cmp_line(const char *str1, const char *end1, const char *str2, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		unsigned char c1 = (str1 + i < end1) ? str1[i] : 0;
+		unsigned char c2 = str2[i];
+		if (c1 != c2)
+			return (c1 < c2) ? -1 : 1;
+		if (!c1)
+			break;
+	}
+	return 0;
+}
+
+static int cmp_skip_spaces(const char *str1, const char *end1, const char *str2)
 {
 	unsigned char c1;
 	unsigned char c2;
 	do {
-		c1 = *(str1++);
+		c1 = (str1 < end1) ? *(str1++) : 0;
 		if (isspace(c1)) {
 			c1 = ' ';
-			while (isspace(*str1))
+			while (str1 < end1 && isspace(static_cast<unsigned char>(*str1)))
 				str1++;
 		}
 		c2 = *(str2++);
@@ -1270,6 +1400,30 @@ static int cmp_skip_spaces(const char *str1, const char *str2)
 	return 0;
 }
 
+// the same as strtoull with base 16, returns the position where the parsing stopped
+static const char *parse_hex(const char *str, const char *end, uint64_t &value)
+{
+	const char *digits = str;
+	if (end - str > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X') && isxdigit(static_cast<unsigned char>(str[2])))
+		digits += 2;
+
+	value = 0;
+	const char *cur;
+	for (cur = digits; cur < end; cur++) {
+		unsigned char c = *cur;
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if (c >= 'a' && c <= 'f')
+			c -= 'a' - 10;
+		else if (c >= 'A' && c <= 'F')
+			c -= 'A' - 10;
+		else
+			break;
+		value = (value << 4) | c;
+	}
+	return (cur == digits) ? str : cur;
+}
+
 bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments)
 {
 	clear();
@@ -1280,6 +1434,19 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 	if (!fs.Open(file_name, fmOpenRead | fmShareDenyNone))
 		return false;
 
+	// the text is tokenized in place, only the names are copied
+	std::string buffer;
+	const char *text;
+	const char *text_end;
+	if (fs.Map()) {
+		text = reinterpret_cast<const char *>(fs.view());
+		text_end = text + static_cast<size_t>(fs.view_size());
+	} else {
+		buffer = fs.ReadAll();
+		text = buffer.data();
+		text_end = text + buffer.size();
+	}
+
 	enum State {
 		stBegin,
 		stTimeStamp,
@@ -1294,47 +1461,60 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 
 	State state = stBegin;
 
-	std::string line;
-	std::vector<std::string> columns;
-	while (fs.ReadLine(line)) {
-		const char *str = skip_spaces(line.c_str());
+	MapSection *sections = NULL;
+	MapSection *functions = NULL;
+	std::vector<MapToken> columns;
+	const char *next = text;
+	while (next < text_end) {
+		const char *str = next;
+		const char *end = str;
+		while (end < text_end && *end != '\n' && *end != '\r')
+			end++;
+		next = end;
+		if (next < text_end) {
+			if (*next == '\r' && next + 1 < text_end && next[1] == '\n')
+				next++;
+			next++;
+		}
+
+		str = skip_spaces(str, end);
 
 		switch (state) {
 		case stBegin:
-			if (strncmp(str, "Timestamp is", 12) == 0) {
+			if (cmp_line(str, end, "Timestamp is", 12) == 0) {
 				state = stTimeStamp;
 				str += 12;
-			} else if (strncmp(str, "Start", 5) == 0) {
+			} else if (cmp_line(str, end, "Start", 5) == 0) {
 				state = stSections;
 				continue;
-			} else if (cmp_skip_spaces(str, "# Address Size File Name") == 0) {
+			} else if (cmp_skip_spaces(str, end, "# Address Size File Name") == 0) {
 				state = stAddressApple;
 				continue;
-			} else if (strncmp(str, "Linker script and memory map", 29) == 0) {
+			} else if (cmp_line(str, end, "Linker script and memory map", 29) == 0) {
 				state = stAddressGCC;
 				continue;
 			}
 			break;
 		case stSections:
-			if (cmp_skip_spaces(str, "Address Publics by Value") == 0) {
+			if (cmp_skip_spaces(str, end, "Address Publics by Value") == 0) {
 				state = stAddressDelphi;
 				continue;
-			} else if (cmp_skip_spaces(str, "Address Publics by Value Rva+Base Lib:Object") == 0) {
+			} else if (cmp_skip_spaces(str, end, "Address Publics by Value Rva+Base Lib:Object") == 0) {
 				state = stAddressVC;
 				continue;
-			} else if (cmp_skip_spaces(str, "Address Publics by Name") == 0) {
+			} else if (cmp_skip_spaces(str, end, "Address Publics by Name") == 0) {
 				state = stAddressBCB;
 				continue;
 			}
 			break;
 		case stAddressVC:
-			if (strncmp(str, "Static symbols", 14) == 0) {
+			if (cmp_line(str, end, "Static symbols", 14) == 0) {
 				state = stStaticSymbols;
 				continue;
 			}
 			break;
 		case stAddressBCB:
-			if (cmp_skip_spaces(str, "Address Publics by Value") == 0)
+			if (cmp_skip_spaces(str, end, "Address Publics by Value") == 0)
 				state = stAddressDelphi;
 			continue;
 		}
@@ -1343,23 +1523,23 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 			continue;
 
 		columns.clear();
-		while (*str) {
-			str = skip_spaces(str);
+		while (str < end) {
+			str = skip_spaces(str, end);
 			const char *begin = str;
 			bool in_block = false;
-			while (*str) {
+			while (str < end) {
 				if (*str == '[')
 					in_block = true;
 				else if (*str == ']')
 					in_block = false;
-				else if (!in_block && isspace(*str))
+				else if (!in_block && isspace(static_cast<unsigned char>(*str)))
 					break;
 				str++;
 			}
 			if (str != begin)
-				columns.push_back(std::string(begin, str - begin));
+				columns.push_back(MapToken(begin, str));
 			if (state == stAddressDelphi || state == stAddressGCC || (state == stAddressApple && columns.size() == 3)) {
-				columns.push_back(skip_spaces(str));
+				columns.push_back(MapToken(skip_spaces(str, end), end));
 				break;
 			}
 		}
@@ -1367,9 +1547,8 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 		switch (state) { //-V719
 		case stTimeStamp:
 			if (columns.size() > 0) {
-				char *last;
-				uint64_t value = _strtoui64(columns[0].c_str(), &last, 16);
-				if (*last == 0)
+				uint64_t value;
+				if (parse_hex(columns[0].begin, columns[0].end, value) == columns[0].end)
 					time_stamp_ = value;
 			}
 			state = stBegin;
@@ -1377,27 +1556,27 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 				
 		case stSections:
 			if (columns.size() == 4) {
-				MapSection *section = GetSectionByType(msSections);
-				if (!section)
-					section = Add(msSections);
+				if (!sections)
+					sections = Add(msSections);
 
-				char *last;
-				size_t segment = strtol(columns[0].c_str(), &last, 16);
-				if (*last != ':')
+				uint64_t segment;
+				const char *last = parse_hex(columns[0].begin, columns[0].end, segment);
+				if (last == columns[0].end || *last != ':')
 					continue;
-				uint64_t address = _strtoui64(last + 1, &last, 16);
-				if (*last != 0)
+				uint64_t address;
+				if (parse_hex(last + 1, columns[0].end, address) != columns[0].end)
 					continue;
 
-				uint64_t size = _strtoui64(columns[1].c_str(), &last, 16);
+				uint64_t size;
+				parse_hex(columns[1].begin, columns[1].end, size);
 
 				if (segment >= segments.size())
 					continue;
 
-				if (address < segments[segment])
-					address += segments[segment];
+				if (address < segments[static_cast<size_t>(segment)])
+					address += segments[static_cast<size_t>(segment)];
 
-				section->Add(segment, address, size, columns[2]);
+				sections->Add(static_cast<size_t>(segment), address, size, columns[2].str());
 			}
 			break;
 
@@ -1405,57 +1584,51 @@ bool MapFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 		case stAddressVC:
 		case stStaticSymbols:
 			if (columns.size() >= 2) {
-				MapSection *section = GetSectionByType(msFunctions);
-				if (!section)
-					section = Add(msFunctions);
+				if (!functions)
+					functions = Add(msFunctions);
 
-				char *last;
 				size_t segment;
 				uint64_t address;
 				if (columns.size() >= 3) {
 					segment = NOT_ID;
-					address = _strtoui64(columns[2].c_str(), &last, 16);
-					if (*last != 0)
+					if (parse_hex(columns[2].begin, columns[2].end, address) != columns[2].end)
 						continue;
 				} else {
-					segment = strtol(columns[0].c_str(), &last, 16);
-					if (*last != ':')
+					uint64_t value;
+					const char *last = parse_hex(columns[0].begin, columns[0].end, value);
+					if (last == columns[0].end || *last != ':')
 						continue;
-					address = _strtoui64(last + 1, &last, 16);
-					if (*last != 0)
+					segment = static_cast<size_t>(value);
+					if (parse_hex(last + 1, columns[0].end, address) != columns[0].end)
 						continue;
 				}
-				section->Add(segment, address, 0, columns[1]);
+				functions->Add(segment, address, 0, columns[1].str());
 			}
 			break;
 
 		case stAddressApple:
 			if (columns.size() == 4) {
-				MapSection *section = GetSectionByType(msFunctions);
-				if (!section)
-					section = Add(msFunctions);
+				if (!functions)
+					functions = Add(msFunctions);
 
-				char *last;
-				uint64_t address = _strtoui64(columns[0].c_str(), &last, 16);
-				if (*last != 0)
+				uint64_t address;
+				if (parse_hex(columns[0].begin, columns[0].end, address) != columns[0].end)
 					continue;
-				section->Add(NOT_ID, address, 0, columns[3]);
+				functions->Add(NOT_ID, address, 0, columns[3].str());
 			}
 			break;
 
 		case stAddressGCC:
 			if (columns.size() >= 2) {
-				MapSection *section = GetSectionByType(msFunctions);
-				if (!section)
-					section = Add(msFunctions);
+				if (!functions)
+					functions = Add(msFunctions);
 
-				char *last;
-				uint64_t address = _strtoui64(columns[0].c_str(), &last, 16);
-				if (*last != 0)
+				uint64_t address;
+				if (parse_hex(columns[0].begin, columns[0].end, address) != columns[0].end)
 					continue;
-				if (columns[1].find("0x") == 0 || columns[1].find(" = ") != NOT_ID || columns[1].find("PROVIDE (") == 0)
+				if (columns[1].starts_with("0x") || columns[1].contains(" = ") || columns[1].starts_with("PROVIDE ("))
 					continue;
-				section->Add(NOT_ID, address, 0, columns[1]);
+				functions->Add(NOT_ID, address, 0, columns[1].str());
 			}
 			break;
 		}
@@ -1584,6 +1757,17 @@ void MapFunctionList::ReadFromFile(IArchitecture &file)
 	uint64_t address;
 
 	IExportList *export_list = file.export_list();
+	std::vector<std::string> export_names;
+	std::vector<size_t> name_index_list(export_list->count(), NOT_ID);
+	for (i = 0; i < export_list->count(); i++) {
+		IExport *exp = export_list->item(i);
+		if (!GetFunctionByAddress(exp->address())) {
+			name_index_list[i] = export_names.size();
+			export_names.push_back(exp->name());
+		}
+	}
+	std::vector<FunctionName> demangled_names = DemangleNames(export_names);
+
 	for (i = 0; i < export_list->count(); i++) {
 		IExport *exp = export_list->item(i);
 		address = exp->address();
@@ -1594,7 +1778,8 @@ void MapFunctionList::ReadFromFile(IArchitecture &file)
 		} else {
 			memory_type = file.segment_list()->GetMemoryTypeByAddress(address);
 			if (memory_type != mtNone)
-				Add(address, 0, (memory_type & mtExecutable) ? otExport : otData, DemangleName(exp->name()));
+				Add(address, 0, (memory_type & mtExecutable) ? otExport : otData,
+					(name_index_list[i] == NOT_ID) ? DemangleName(exp->name()) : demangled_names[name_index_list[i]]);
 		}
 	}
 
@@ -1702,6 +1887,48 @@ void MapFunctionList::AddObject(MapFunction *func)
 		it->second.push_back(func);
 }
 
+/**
+ * Adds a lot of functions at once, the indexes are filled from the sorted lists with hinted inserts.
+ */
+void MapFunctionList::AddObjects(const std::vector<MapFunction *> &func_list)
+{
+	size_t i;
+	std::vector<std::pair<uint64_t, MapFunction *> > address_list;
+	std::vector<std::pair<std::string, MapFunction *> > name_list;
+	address_list.reserve(func_list.size());
+	name_list.reserve(func_list.size());
+	for (i = 0; i < func_list.size(); i++) {
+		MapFunction *func = func_list[i];
+		ObjectList<MapFunction>::AddObject(func);
+		address_list.push_back(std::make_pair(func->address(), func));
+		name_list.push_back(std::make_pair(func->name(), func));
+	}
+
+	// stable sorting keeps the order of AddObject for equal keys
+	std::stable_sort(address_list.begin(), address_list.end(), [](const std::pair<uint64_t, MapFunction *> &left, const std::pair<uint64_t, MapFunction *> &right) {
+		return left.first < right.first;
+	});
+	std::map<uint64_t, MapFunction*>::iterator address_it = address_map_.end();
+	for (i = 0; i < address_list.size(); i++) {
+		address_it = address_map_.insert(address_it, address_list[i]);
+		address_it++;
+	}
+
+	std::stable_sort(name_list.begin(), name_list.end(), [](const std::pair<std::string, MapFunction *> &left, const std::pair<std::string, MapFunction *> &right) {
+		return left.first < right.first;
+	});
+	std::map<std::string, std::vector<MapFunction*> >::iterator name_it = name_map_.end();
+	for (i = 0; i < name_list.size(); i++) {
+		if (i == 0 || name_list[i].first != name_list[i - 1].first) {
+			std::map<std::string, std::vector<MapFunction*> >::iterator hint = name_it;
+			if (hint != name_map_.end())
+				hint++;
+			name_it = name_map_.insert(hint, std::make_pair(name_list[i].first, std::vector<MapFunction*>()));
+		}
+		name_it->second.push_back(name_list[i].second);
+	}
+}
+
 void MapFunctionList::RemoveObject(MapFunction *func) 
 {
 	ObjectList<MapFunction>::RemoveObject(func);
@@ -1764,6 +1991,104 @@ void MapFunctionList::ReadFromBuffer(Buffer &buffer, IArchitecture &file)
 	}
 }
 
+void MapFunctionList::SaveToCache(Data &data) const
+{
+	size_t i, j, k;
+	std::map<MapFunction *, uint32_t> index_map;
+
+	data.PushDWord(static_cast<uint32_t>(count()));
+	for (i = 0; i < count(); i++) {
+		MapFunction *func = item(i);
+		index_map[func] = static_cast<uint32_t>(i);
+
+		FunctionName name = func->full_name();
+		data.PushQWord(func->address());
+		data.PushByte(func->type());
+		data.PushString(name.raw_name());
+		data.PushDWord(static_cast<uint32_t>(name.name_pos()));
+		data.PushQWord(func->end_address());
+		data.PushQWord(func->name_address());
+		data.PushDWord(static_cast<uint32_t>(func->name_length()));
+		data.PushByte(func->compilation_type());
+		data.PushByte((func->lock_to_key() ? 1 : 0) | (func->strings_protection() ? 2 : 0));
+		for (k = 0; k < 2; k++) {
+			ReferenceList *reference_list = (k == 0) ? func->reference_list() : func->equal_address_list();
+			data.PushDWord(static_cast<uint32_t>(reference_list->count()));
+			for (j = 0; j < reference_list->count(); j++) {
+				Reference *reference = reference_list->item(j);
+				data.PushQWord(reference->address());
+				data.PushQWord(reference->operand_address());
+				data.PushByte(static_cast<uint8_t>(reference->tag()));
+			}
+		}
+	}
+
+	// lookup maps are stored as is because Add() can bind several addresses and names to one function
+	data.PushDWord(static_cast<uint32_t>(address_map_.size()));
+	for (std::map<uint64_t, MapFunction*>::const_iterator it = address_map_.begin(); it != address_map_.end(); it++) {
+		data.PushQWord(it->first);
+		data.PushDWord(index_map[it->second]);
+	}
+
+	data.PushDWord(static_cast<uint32_t>(name_map_.size()));
+	for (std::map<std::string, std::vector<MapFunction*> >::const_iterator it = name_map_.begin(); it != name_map_.end(); it++) {
+		data.PushString(it->first);
+		data.PushDWord(static_cast<uint32_t>(it->second.size()));
+		for (j = 0; j < it->second.size(); j++) {
+			data.PushDWord(index_map[it->second[j]]);
+		}
+	}
+}
+
+void MapFunctionList::LoadFromCache(Buffer &buffer)
+{
+	size_t i, j, k, c, n;
+
+	clear();
+
+	c = buffer.ReadDWord();
+	for (i = 0; i < c; i++) {
+		uint64_t address = buffer.ReadQWord();
+		ObjectType type = static_cast<ObjectType>(buffer.ReadByte());
+		std::string name = buffer.ReadString();
+		size_t name_pos = buffer.ReadDWord();
+
+		MapFunction *func = new MapFunction(this, address, type, FunctionName(name, name_pos));
+		ObjectList<MapFunction>::AddObject(func);
+		func->set_end_address(buffer.ReadQWord());
+		func->set_name_address(buffer.ReadQWord());
+		func->set_name_length(buffer.ReadDWord());
+		func->set_compilation_type(static_cast<CompilationType>(buffer.ReadByte()));
+		uint8_t flags = buffer.ReadByte();
+		func->set_lock_to_key((flags & 1) != 0);
+		func->set_strings_protection((flags & 2) != 0);
+		for (k = 0; k < 2; k++) {
+			ReferenceList *reference_list = (k == 0) ? func->reference_list() : func->equal_address_list();
+			n = buffer.ReadDWord();
+			for (j = 0; j < n; j++) {
+				uint64_t reference_address = buffer.ReadQWord();
+				uint64_t operand_address = buffer.ReadQWord();
+				reference_list->Add(reference_address, operand_address, buffer.ReadByte());
+			}
+		}
+	}
+
+	c = buffer.ReadDWord();
+	for (i = 0; i < c; i++) {
+		uint64_t address = buffer.ReadQWord();
+		address_map_[address] = item(buffer.ReadDWord());
+	}
+
+	c = buffer.ReadDWord();
+	for (i = 0; i < c; i++) {
+		std::vector<MapFunction*> &func_list = name_map_[buffer.ReadString()];
+		n = buffer.ReadDWord();
+		for (j = 0; j < n; j++) {
+			func_list.push_back(item(buffer.ReadDWord()));
+		}
+	}
+}
+
 /**
  * MapFunctionArch
  */
@@ -2500,6 +2825,14 @@ void CompilerFunctionList::AddObject(CompilerFunction *func)
 	map_[func->address()] = func;
 }
 
+void CompilerFunctionList::RemoveObject(CompilerFunction *func)
+{
+	std::map<uint64_t, CompilerFunction *>::iterator it = map_.find(func->address());
+	if (it != map_.end() && it->second == func)
+		map_.erase(it);
+	ObjectList<CompilerFunction>::RemoveObject(func);
+}
+
 CompilerFunction *CompilerFunctionList::GetFunctionByAddress(uint64_t address) const
 {
 	std::map<uint64_t, CompilerFunction *>::const_iterator it = map_.find(address);
@@ -2602,6 +2935,42 @@ void CompilerFunctionList::Rebase(uint64_t delta_base)
 	}
 }
 
+void CompilerFunctionList::SaveToCache(Data &data) const
+{
+	data.PushDWord(static_cast<uint32_t>(count()));
+	for (size_t i = 0; i < count(); i++) {
+		CompilerFunction *func = item(i);
+		data.PushDWord(func->type());
+		data.PushQWord(func->address());
+		data.PushDWord(func->options());
+		data.PushDWord(static_cast<uint32_t>(func->count()));
+		for (size_t j = 0; j < func->count(); j++) {
+			data.PushQWord(func->value(j));
+		}
+	}
+}
+
+void CompilerFunctionList::LoadFromCache(Buffer &buffer)
+{
+	clear();
+
+	size_t c = buffer.ReadDWord();
+	for (size_t i = 0; i < c; i++) {
+		CompilerFunctionType type = static_cast<CompilerFunctionType>(buffer.ReadDWord());
+		uint64_t address = buffer.ReadQWord();
+		CompilerFunction *func = Add(type, address);
+		uint32_t options = buffer.ReadDWord();
+		if (options & coUsed)
+			func->include_option(coUsed);
+		if (options & coNoReturn)
+			func->include_option(coNoReturn);
+		size_t n = buffer.ReadDWord();
+		for (size_t j = 0; j < n; j++) {
+			func->add_value(buffer.ReadQWord());
+		}
+	}
+}
+
 /**
  * MarkerCommand
  */
@@ -2677,6 +3046,33 @@ MarkerCommandList *MarkerCommandList::Clone() const
 	return list;
 }
 
+void MarkerCommandList::SaveToCache(Data &data) const
+{
+	data.PushDWord(static_cast<uint32_t>(count()));
+	for (size_t i = 0; i < count(); i++) {
+		MarkerCommand *command = item(i);
+		data.PushQWord(command->address());
+		data.PushQWord(command->operand_address());
+		data.PushQWord(command->name_reference());
+		data.PushQWord(command->name_address());
+		data.PushByte(command->type());
+	}
+}
+
+void MarkerCommandList::LoadFromCache(Buffer &buffer)
+{
+	clear();
+
+	size_t c = buffer.ReadDWord();
+	for (size_t i = 0; i < c; i++) {
+		uint64_t address = buffer.ReadQWord();
+		uint64_t operand_address = buffer.ReadQWord();
+		uint64_t name_reference = buffer.ReadQWord();
+		uint64_t name_address = buffer.ReadQWord();
+		Add(address, operand_address, name_reference, name_address, static_cast<ObjectType>(buffer.ReadByte()));
+	}
+}
+
 /**
  * MemoryRegion
  */
@@ -2985,7 +3381,7 @@ size_t CRCTable::WriteToFile(IArchitecture &file, bool is_positions, uint32_t *h
 
 	// need random order in the vector
 	for (i = 0; i < crc_info_list_.size(); i++)
-		std::swap(crc_info_list_[i], crc_info_list_[rand() % crc_info_list_.size()]);
+		std::swap(crc_info_list_[i], crc_info_list_[Random() % crc_info_list_.size()]);
 
 	if (cryptor_) {
 		for (i = 0; i < crc_info_list_.size(); i++) {
@@ -3115,6 +3511,7 @@ uint64_t BaseArchitecture::Resize(uint64_t size)
 
 bool BaseArchitecture::Prepare(CompileContext &ctx)
 {
+	TraceScope trace("Prepare");
 	size_t i;
 
 	uint32_t runtime_options = import_list()->GetRuntimeOptions();
@@ -3223,6 +3620,8 @@ bool BaseArchitecture::Prepare(CompileContext &ctx)
 
 bool BaseArchitecture::Compile(CompileOptions &options, IArchitecture *runtime)
 {
+	TraceScope trace("Compile");
+
 	if (source_) {
 		// copy image data to file
 		offset_ = owner()->size();
@@ -3337,7 +3736,10 @@ bool BaseArchitecture::Compile(CompileOptions &options, IArchitecture *runtime)
 		}
 	}
 
-	ctx.manager->Pack();
+	{
+		TraceScope trace_pack("MemoryManager::Pack");
+		ctx.manager->Pack();
+	}
 
 	if (!list->Compile(ctx))
 		return false;
@@ -3345,6 +3747,7 @@ bool BaseArchitecture::Compile(CompileOptions &options, IArchitecture *runtime)
 	if (options.script)
 		options.script->DoBeforeSaveFile();
 
+	TraceScope trace_save("Save");
 	append_mode_ = true;
 	Save(ctx);
 	size_ = size();
@@ -3377,16 +3780,16 @@ void BaseArchitecture::EndProgress() const
 		owner_->EndProgress();
 }
 
-std::string BaseArchitecture::ReadANSIString(uint64_t address)
+static std::string ReadANSIString(IArchitecture &file, uint64_t address)
 {
-	if (!AddressSeek(address))
+	if (!file.AddressSeek(address))
 		return std::string();
 
 	std::string res;
 	for (;;) {
-		if (fixup_list()->GetFixupByNearAddress(address))
+		if (file.fixup_list()->GetFixupByNearAddress(address))
 			return std::string();
-		unsigned char c = ReadByte();
+		unsigned char c = file.ReadByte();
 		address += sizeof(c);
 		if (c == '\n' || c == '\r' || c == '\t' || c >= ' ') {
 			res.push_back(c);
@@ -3400,16 +3803,16 @@ std::string BaseArchitecture::ReadANSIString(uint64_t address)
 	return res;
 }
 
-std::string BaseArchitecture::ReadUnicodeString(uint64_t address)
+static std::string ReadUnicodeString(IArchitecture &file, uint64_t address)
 {
-	if (!AddressSeek(address))
+	if (!file.AddressSeek(address))
 		return std::string();
 
 	os::unicode_string res;
 	for (;;) {
-		if (fixup_list()->GetFixupByNearAddress(address))
+		if (file.fixup_list()->GetFixupByNearAddress(address))
 			return std::string();
-		os::unicode_char w = ReadWord();
+		os::unicode_char w = file.ReadWord();
 		address += sizeof(w);
 		if ((w >> 8) == 0 && (w == '\n' || w == '\r' || w == '\t' || w >= ' ')) {
 			res.push_back(w);
@@ -3423,17 +3826,17 @@ std::string BaseArchitecture::ReadUnicodeString(uint64_t address)
 	return os::ToUTF8(res);
 }
 
-std::string BaseArchitecture::ReadANSIStringWithLength(uint64_t address)
+static std::string ReadANSIStringWithLength(IArchitecture &file, uint64_t address)
 {
-	if (!AddressSeek(address))
+	if (!file.AddressSeek(address))
 		return std::string();
 
 	std::string res;
-	size_t l = ReadByte();
+	size_t l = file.ReadByte();
 	for (size_t i = 0; i < l; i++) {
-		if (fixup_list()->GetFixupByNearAddress(address))
+		if (file.fixup_list()->GetFixupByNearAddress(address))
 			return std::string();
-		unsigned char c = ReadByte();
+		unsigned char c = file.ReadByte();
 		address += sizeof(c);
 		if (c == '\n' || c == '\r' || c == '\t' || c >= ' ') {
 			res.push_back(c);
@@ -3447,14 +3850,14 @@ std::string BaseArchitecture::ReadANSIStringWithLength(uint64_t address)
 	return res;
 }
 
-std::string BaseArchitecture::ReadString(uint64_t address)
+static std::string ReadStringFromFile(IArchitecture &file, uint64_t address)
 {
-	if ((segment_list()->GetMemoryTypeByAddress(address) & mtReadable) == 0)
+	if ((file.segment_list()->GetMemoryTypeByAddress(address) & mtReadable) == 0)
 		return std::string();
 
-	std::string res = ReadANSIString(address);
-	std::string unicode_str = ReadUnicodeString(address);
-	std::string pascal_str = ReadANSIStringWithLength(address);
+	std::string res = ReadANSIString(file, address);
+	std::string unicode_str = ReadUnicodeString(file, address);
+	std::string pascal_str = ReadANSIStringWithLength(file, address);
 	if (unicode_str.size() > res.size())
 		res = unicode_str;
 	if (pascal_str.size() > res.size())
@@ -3462,6 +3865,11 @@ std::string BaseArchitecture::ReadString(uint64_t address)
 	return res;
 }
 
+std::string BaseArchitecture::ReadString(uint64_t address)
+{
+	return ReadStringFromFile(*this, address);
+}
+
 void BaseArchitecture::ReadFromBuffer(Buffer &buffer)
 {
 	export_list()->ReadFromBuffer(buffer, *this);
@@ -3470,6 +3878,51 @@ void BaseArchitecture::ReadFromBuffer(Buffer &buffer)
 	function_list()->ReadFromBuffer(buffer, *this);
 }
 
+void BaseArchitecture::SaveAnalysis(Data &data) const
+{
+	map_function_list_->SaveToCache(data);
+	compiler_function_list_->SaveToCache(data);
+	end_marker_list_->SaveToCache(data);
+
+	std::map<MapFunction *, uint32_t> index_map;
+	for (size_t i = 0; i < map_function_list_->count(); i++) {
+		index_map[map_function_list_->item(i)] = static_cast<uint32_t>(i + 1);
+	}
+
+	IImportList *import_list = this->import_list();
+	for (size_t i = 0; i < import_list->count(); i++) {
+		IImport *import = import_list->item(i);
+		for (size_t j = 0; j < import->count(); j++) {
+			IImportFunction *import_function = import->item(j);
+			std::map<MapFunction *, uint32_t>::const_iterator it = index_map.find(import_function->map_function());
+			data.PushDWord((it != index_map.end()) ? it->second : 0);
+			data.PushByte(import_function->options() & (ioHasDataReference | ioNoReferences));
+		}
+	}
+}
+
+void BaseArchitecture::LoadAnalysis(Buffer &buffer)
+{
+	map_function_list_->LoadFromCache(buffer);
+	compiler_function_list_->LoadFromCache(buffer);
+	end_marker_list_->LoadFromCache(buffer);
+
+	IImportList *import_list = this->import_list();
+	for (size_t i = 0; i < import_list->count(); i++) {
+		IImport *import = import_list->item(i);
+		for (size_t j = 0; j < import->count(); j++) {
+			IImportFunction *import_function = import->item(j);
+			uint32_t index = buffer.ReadDWord();
+			import_function->set_map_function(index ? map_function_list_->item(index - 1) : NULL);
+			uint8_t options = buffer.ReadByte();
+			if (options & ioHasDataReference)
+				import_function->include_option(ioHasDataReference);
+			if (options & ioNoReferences)
+				import_function->include_option(ioNoReferences);
+		}
+	}
+}
+
 uint64_t BaseArchitecture::CopyFrom(const IArchitecture &src, uint64_t count)
 {
 	return owner()->CopyFrom(*src.owner(), count);
@@ -3495,6 +3948,15 @@ bool BaseArchitecture::ReadMapFile(IMapFile &map_file)
 	if (functions) {
 		MapSection *sections = map_file.GetSectionByType(msSections);
 
+		std::vector<std::string> names;
+		names.reserve(functions->count());
+		for (size_t i = 0; i < functions->count(); i++) {
+			names.push_back(functions->item(i)->name());
+		}
+		std::vector<FunctionName> demangled_names = DemangleNames(names);
+
+		std::vector<MapFunction *> func_list;
+		func_list.reserve(functions->count());
 		for (size_t i = 0; i < functions->count(); i++) {
 			MapObject *func = functions->item(i);
 
@@ -3518,8 +3980,9 @@ bool BaseArchitecture::ReadMapFile(IMapFile &map_file)
 
 			uint32_t memory_type = segment_list()->GetMemoryTypeByAddress(address);
 			if (memory_type != mtNone)
-				map_function_list()->Add(address, 0, (memory_type & mtExecutable) ? otCode : otData, DemangleName(func->name()));
+				func_list.push_back(new MapFunction(map_function_list(), address, (memory_type & mtExecutable) ? otCode : otData, demangled_names[i]));
 		}
+		map_function_list()->AddObjects(func_list);
 	}
 
 	return true;
@@ -3540,6 +4003,418 @@ bool BaseArchitecture::check_hash() const
 }
 #endif
 
+/**
+ * AnalysisCache
+ */
+
+#define ANALYSIS_CACHE_MAGIC 0x43504d56 // VMPC
+#define ANALYSIS_CACHE_VERSION 3
+#define ANALYSIS_CACHE_BUFFER_SIZE 0x10000
+#define ANALYSIS_CACHE_MAX_SIZE 0x10000000
+
+struct ANALYSIS_CACHE_HEADER {
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Size;
+	uint8_t Hash[20];
+};
+
+struct AnalysisCacheEntry {
+	std::string file_name;
+	uint64_t size;
+	uint64_t time;
+	bool operator < (const AnalysisCacheEntry &entry) const
+	{
+		if (time != entry.time)
+			return time < entry.time;
+		return file_name < entry.file_name;
+	}
+};
+
+std::string AnalysisCache::directory_;
+uint64_t AnalysisCache::max_size_ = ANALYSIS_CACHE_MAX_SIZE;
+
+AnalysisCache::AnalysisCache(BaseArchitecture *owner, const std::vector<std::string> &file_list)
+	: IObject(), owner_(owner)
+{
+	IFile *file = owner_->owner();
+	if (!max_size_ || !file || file->file_name().empty())
+		return;
+
+	SHA1 sha;
+	uint32_t version = ANALYSIS_CACHE_VERSION;
+	sha.Input(reinterpret_cast<const uint8_t *>(&version), sizeof(version));
+	std::string arch_name = owner_->name();
+	sha.Input(reinterpret_cast<const uint8_t *>(arch_name.c_str()), arch_name.size() + 1);
+
+	// the key covers the contents of the image and of all symbol files it can be loaded with, so the entry does not depend
+	// on paths and time stamps of the files
+	std::vector<uint8_t> buf(ANALYSIS_CACHE_BUFFER_SIZE);
+	uint64_t size = owner_->size();
+	sha.Input(reinterpret_cast<const uint8_t *>(&size), sizeof(size));
+	uint64_t pos = owner_->Tell();
+	owner_->Seek(0);
+	for (uint64_t i = 0; i < size; ) {
+		size_t read_size = owner_->Read(buf.data(), static_cast<size_t>(std::min(size - i, static_cast<uint64_t>(buf.size()))));
+		if (!read_size)
+			break;
+		sha.Input(buf.data(), read_size);
+		i += read_size;
+	}
+	owner_->Seek(pos);
+
+	for (size_t i = 0; i < file_list.size(); i++) {
+		FileStream stream;
+		uint8_t exists = stream.Open(file_list[i].c_str(), fmOpenRead | fmShareDenyWrite) ? 1 : 0;
+		sha.Input(&exists, sizeof(exists));
+		if (!exists)
+			continue;
+
+		size = stream.Size();
+		sha.Input(reinterpret_cast<const uint8_t *>(&size), sizeof(size));
+		for (;;) {
+			size_t read_size = stream.Read(buf.data(), buf.size());
+			if (!read_size)
+				break;
+			sha.Input(buf.data(), read_size);
+		}
+	}
+
+	std::string key;
+	const uint8_t *hash = sha.Result();
+	for (size_t i = 0; i < sha.ResultSize(); i++) {
+		key += string_format("%.2x", hash[i]);
+	}
+	file_name_ = os::CombinePaths(directory().c_str(), (key + ".cache").c_str());
+}
+
+std::string AnalysisCache::directory()
+{
+	if (!directory_.empty())
+		return directory_;
+	return os::CombineThisAppDataDirectory("Cache");
+}
+
+bool AnalysisCache::Load()
+{
+	if (file_name_.empty())
+		return false;
+
+	std::string data;
+	{
+		FileStream stream;
+		if (!stream.Open(file_name_.c_str(), fmOpenRead | fmShareDenyWrite))
+			return false;
+		data = stream.ReadAll();
+	}
+
+	ANALYSIS_CACHE_HEADER header;
+	if (data.size() < sizeof(header))
+		return false;
+
+	memcpy(&header, data.c_str(), sizeof(header));
+	if (header.Magic != ANALYSIS_CACHE_MAGIC || header.Version != ANALYSIS_CACHE_VERSION || header.Size != data.size() - sizeof(header))
+		return false;
+
+	const uint8_t *payload = reinterpret_cast<const uint8_t *>(data.c_str()) + sizeof(header);
+	SHA1 sha;
+	sha.Input(payload, header.Size);
+	if (memcmp(sha.Result(), header.Hash, sizeof(header.Hash)) != 0)
+		return false;
+
+	Buffer buffer(payload);
+	owner_->LoadAnalysis(buffer);
+
+	// the write time of an entry is the time of its last use, Trim removes the least recently used entries first
+	{
+		FileStream stream;
+		if (stream.Open(file_name_.c_str(), fmOpenReadWrite | fmShareDenyWrite))
+			stream.Write(&header, sizeof(header));
+	}
+	return true;
+}
+
+void AnalysisCache::Save()
+{
+	if (file_name_.empty())
+		return;
+
+	Data data;
+	owner_->SaveAnalysis(data);
+	if (sizeof(ANALYSIS_CACHE_HEADER) + data.size() > max_size_)
+		return;
+
+	ANALYSIS_CACHE_HEADER header;
+	header.Magic = ANALYSIS_CACHE_MAGIC;
+	header.Version = ANALYSIS_CACHE_VERSION;
+	header.Size = static_cast<uint32_t>(data.size());
+	SHA1 sha;
+	sha.Input(data.data(), data.size());
+	memcpy(header.Hash, sha.Result(), sizeof(header.Hash));
+
+	// the cache is optional, so write errors are ignored
+	os::PathCreate(directory().c_str());
+	std::string tmp_file_name = os::GetTempFilePathNameFor(file_name_.c_str());
+	bool is_written = false;
+	{
+		FileStream stream;
+		if (stream.Open(tmp_file_name.c_str(), fmCreate | fmOpenWrite | fmShareDenyWrite))
+			is_written = (stream.Write(&header, sizeof(header)) == sizeof(header) && stream.Write(data.data(), data.size()) == data.size());
+	}
+	if (!is_written || !os::FileMove(tmp_file_name.c_str(), file_name_.c_str())) {
+		os::FileDelete(tmp_file_name.c_str());
+		return;
+	}
+
+	Trim();
+}
+
+void AnalysisCache::Trim() const
+{
+	std::vector<AnalysisCacheEntry> entry_list;
+	uint64_t total_size = 0;
+	std::vector<std::string> file_list = os::FindFiles(directory().c_str(), "*.cache");
+	for (size_t i = 0; i < file_list.size(); i++) {
+		AnalysisCacheEntry entry;
+		entry.file_name = file_list[i];
+		{
+			FileStream stream;
+			if (!stream.Open(entry.file_name.c_str(), fmOpenRead | fmShareDenyNone))
+				continue;
+			entry.size = stream.Size();
+		}
+		entry.time = os::GetLastWriteTime(entry.file_name.c_str());
+		total_size += entry.size;
+		// the entry just written is kept
+		if (entry.file_name != file_name_)
+			entry_list.push_back(entry);
+	}
+
+	std::sort(entry_list.begin(), entry_list.end());
+	for (size_t i = 0; i < entry_list.size() && total_size > max_size_; i++) {
+		const AnalysisCacheEntry &entry = entry_list[i];
+		if (os::FileDelete(entry.file_name.c_str()))
+			total_size -= entry.size;
+	}
+}
+
+/**
+ * ArchitectureReader
+ */
+
+ArchitectureReader::ArchitectureReader(IArchitecture *arch)
+	: IArchitecture(), arch_(arch), stream_(NULL), selected_segment_(NULL)
+{
+	compiler_function_list_ = arch_->compiler_function_list()->Clone();
+	compiler_function_count_ = compiler_function_list_->count();
+}
+
+ArchitectureReader::~ArchitectureReader()
+{
+	delete stream_;
+	delete compiler_function_list_;
+}
+
+bool ArchitectureReader::Open()
+{
+	IFile *file = arch_->owner();
+	if (!file || !dynamic_cast<FileStream *>(file->stream()))
+		return false;
+
+	// the reader opens the file by name, so it must see the data buffered by the main stream
+	file->Flush();
+	std::auto_ptr<FileStream> stream(new FileStream());
+	if (!stream->Open(file->file_name(true).c_str(), fmOpenRead | fmShareDenyNone))
+		return false;
+
+	delete stream_;
+	stream_ = stream.release();
+	return true;
+}
+
+/**
+ * Moves compiler functions found since the previous call to function_list, so every function is read
+ * with the same compiler functions as the architecture has.
+ */
+void ArchitectureReader::TakeCompilerFunctions(std::vector<CompilerFunction *> &function_list)
+{
+	for (size_t i = compiler_function_count_; i < compiler_function_list_->count(); i++) {
+		function_list.push_back(compiler_function_list_->item(i)->Clone(NULL));
+	}
+	while (compiler_function_list_->count() > compiler_function_count_) {
+		delete compiler_function_list_->last();
+	}
+}
+
+void ArchitectureReader::TakeMessages(std::vector<NotifyMessage> &message_list)
+{
+	message_list.insert(message_list.end(), message_list_.begin(), message_list_.end());
+	message_list_.clear();
+}
+
+size_t ArchitectureReader::Read(void *buffer, size_t count) const
+{
+	size_t res = stream_->Read(buffer, count);
+	if (res != count)
+		throw std::runtime_error("Runtime error at Read");
+	return res;
+}
+
+uint8_t ArchitectureReader::ReadByte()
+{
+	uint8_t res;
+	Read(&res, sizeof(res));
+	return res;
+}
+
+uint16_t ArchitectureReader::ReadWord()
+{
+	uint16_t res;
+	Read(&res, sizeof(res));
+	return res;
+}
+
+uint32_t ArchitectureReader::ReadDWord()
+{
+	uint32_t res;
+	Read(&res, sizeof(res));
+	return res;
+}
+
+uint64_t ArchitectureReader::ReadQWord()
+{
+	uint64_t res;
+	Read(&res, sizeof(res));
+	return res;
+}
+
+std::string ArchitectureReader::ReadString()
+{
+	std::string res;
+	for (;;) {
+		char c = ReadByte();
+		if (c == '\0')
+			break;
+		res.push_back(c);
+	}
+	return res;
+}
+
+std::string ArchitectureReader::ReadString(uint64_t address)
+{
+	return ReadStringFromFile(*this, address);
+}
+
+uint64_t ArchitectureReader::Seek(uint64_t position) const
+{
+	uint64_t offset = arch_->offset();
+	position += offset;
+	if (position < offset || position >= offset + arch_->size())
+		throw std::runtime_error("Runtime error at Seek");
+	if (stream_->Seek(position, soBeginning) != position)
+		throw std::runtime_error("Runtime error at Seek");
+	return position - offset;
+}
+
+uint64_t ArchitectureReader::Tell() const
+{
+	uint64_t offset = arch_->offset();
+	uint64_t position = stream_->Tell();
+	if (position == (uint64_t)-1 || position < offset || position >= offset + arch_->size())
+		throw std::runtime_error("Runtime error at Tell");
+	return position - offset;
+}
+
+uint64_t ArchitectureReader::AddressTell()
+{
+	uint64_t position = Tell();
+	ISection *segment = segment_list()->GetSectionByOffset(position);
+	if (!segment)
+		return 0;
+
+	return segment->address() + position - segment->physical_offset();
+}
+
+bool ArchitectureReader::AddressSeek(uint64_t address)
+{
+	ISection *segment = segment_list()->GetSectionByAddress(address);
+
+	if (!segment || segment->physical_size() <= address - segment->address()) {
+		selected_segment_ = NULL;
+		return false;
+	}
+
+	selected_segment_ = segment;
+	Seek(segment->physical_offset() + address - segment->address());
+	return true;
+}
+
+/**
+ * FunctionReport
+ */
+
+static const char *compilation_type_names[] = {"virtualization", "mutation", "ultra"};
+
+static const char *GetCompilationTypeName(CompilationType compilation_type)
+{
+	return (compilation_type < _countof(compilation_type_names)) ? compilation_type_names[compilation_type] : "none";
+}
+
+FunctionReport::FunctionReport()
+{
+
+}
+
+std::string FunctionReport::ToCSV() const
+{
+	std::string res = "architecture,address,name,compilation_type,native_count,native_size,output_size,vm_size,vm_commands,handlers,mutation_ratio,dispatches_per_instruction\n";
+	for (size_t i = 0; i < item_list_.size(); i++) {
+		const FunctionReportItem &item = item_list_[i];
+		std::string name = item.name;
+		for (size_t pos = name.find('"'); pos != std::string::npos; pos = name.find('"', pos + 2)) {
+			name.insert(pos, 1, '"');
+		}
+		res += string_format("%s,%.8llX,\"%s\",%s,%u,%u,%u,%u,%u,%u,%.2f,%.2f\n",
+			item.architecture.c_str(),
+			item.address,
+			name.c_str(),
+			GetCompilationTypeName(item.compilation_type),
+			static_cast<uint32_t>(item.native_count),
+			static_cast<uint32_t>(item.native_size),
+			static_cast<uint32_t>(item.output_size),
+			static_cast<uint32_t>(item.vm_size),
+			static_cast<uint32_t>(item.vm_command_count),
+			static_cast<uint32_t>(item.handler_count),
+			item.mutation_ratio(),
+			item.dispatch_ratio());
+	}
+	return res;
+}
+
+std::string FunctionReport::ToJSON() const
+{
+	std::string res = "{\n  \"functions\": [";
+	for (size_t i = 0; i < item_list_.size(); i++) {
+		const FunctionReportItem &item = item_list_[i];
+		res += (i ? ",\n    {" : "\n    {");
+		res += "\"architecture\": " + JSONString(item.architecture);
+		res += string_format(", \"address\": \"%.8llX\"", item.address);
+		res += ", \"name\": " + JSONString(item.name);
+		res += string_format(", \"compilation_type\": \"%s\", \"native_count\": %u, \"native_size\": %u, \"output_size\": %u, \"vm_size\": %u, \"vm_commands\": %u, \"handlers\": %u, \"mutation_ratio\": %.2f, \"dispatches_per_instruction\": %.2f}",
+			GetCompilationTypeName(item.compilation_type),
+			static_cast<uint32_t>(item.native_count),
+			static_cast<uint32_t>(item.native_size),
+			static_cast<uint32_t>(item.output_size),
+			static_cast<uint32_t>(item.vm_size),
+			static_cast<uint32_t>(item.vm_command_count),
+			static_cast<uint32_t>(item.handler_count),
+			item.mutation_ratio(),
+			item.dispatch_ratio());
+	}
+	res += "\n  ]\n}\n";
+	return res;
+}
+
 /**
  * Folder
  */
@@ -3727,6 +4602,8 @@ IFile::IFile(const IFile &src, const char *file_name)
 		//compile scenario, mainstream
 		if (!stream->Open(file_name, fmCreate | fmOpenReadWrite | fmShareDenyWrite))
 			throw std::runtime_error(string_format(language[lsCreateFileError].c_str(), file_name));
+		// Save writes the image by small pieces and seeks back to patch headers and tables
+		stream->set_write_behind(0x100000);
 	}
 	folder_list_ = src.folder_list()->Clone(this);
 	map_function_list_ = new MapFunctionBundleList(this);
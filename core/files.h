@@ -17,6 +17,8 @@ std::string DisplayString(const std::string &str);
 uint16_t OperandSizeToValue(OperandSize os);
 uint16_t OperandSizeToStack(OperandSize os);
 std::string DisplayValue(OperandSize size, uint64_t value);
+void EncryptData(uint8_t *data, size_t size, uint64_t position, uint32_t key);
+std::vector<size_t> FindDuplicates(const std::vector<Data> &data_list, size_t thread_count);
 
 struct FunctionName {
 	FunctionName()
@@ -25,6 +27,8 @@ struct FunctionName {
 		: name_(name), name_pos_(name_pos) {}
 	std::string name() const { return name_.substr(name_pos_); }
 	std::string display_name(bool show_ret = true) const { return DisplayString(show_ret ? name_ : name_.substr(name_pos_)); }
+	std::string raw_name() const { return name_; }
+	size_t name_pos() const { return name_pos_; }
 	void clear() 
 	{
 		name_.clear();
@@ -44,6 +48,7 @@ private:
 };
 
 FunctionName DemangleName(const std::string &name);
+std::vector<FunctionName> DemangleNames(const std::vector<std::string> &names);
 
 template<typename V, typename A>
 V AlignValue(V value, A alignment)
@@ -826,7 +831,10 @@ public:
 	MapFunction *Add(uint64_t address, uint64_t end_address, ObjectType type, const FunctionName &name);
 	void Rebase(uint64_t delta_base);
 	void ReadFromBuffer(Buffer &buffer, IArchitecture &file);
+	void SaveToCache(Data &data) const;
+	void LoadFromCache(Buffer &buffer);
 	virtual void AddObject(MapFunction *func);
+	void AddObjects(const std::vector<MapFunction *> &func_list);
 	IArchitecture *owner() const { return owner_; }
 private:
 	IArchitecture *owner_;
@@ -1091,6 +1099,7 @@ public:
 	explicit CompilerFunctionList(const CompilerFunctionList &src);
 	CompilerFunction *Add(CompilerFunctionType type, uint64_t address);
 	virtual void AddObject(CompilerFunction *func);
+	virtual void RemoveObject(CompilerFunction *func);
 	CompilerFunction *GetFunctionByAddress(uint64_t address) const;
 	CompilerFunction *GetFunctionByLowerAddress(uint64_t address) const;
 	CompilerFunctionList *Clone() const;
@@ -1098,6 +1107,8 @@ public:
 	uint32_t GetSDKOptions() const;
 	uint32_t GetRuntimeOptions() const;
 	void Rebase(uint64_t delta_base);
+	void SaveToCache(Data &data) const;
+	void LoadFromCache(Buffer &buffer);
 private:
 	std::map<uint64_t, CompilerFunction*> map_;
 
@@ -1166,6 +1177,36 @@ private:
 	BaseRuntimeFunctionList &operator =(const BaseRuntimeFunctionList &);
 };
 
+struct FunctionReportItem {
+	std::string architecture;
+	std::string name;
+	uint64_t address;
+	CompilationType compilation_type;
+	size_t native_count;
+	size_t native_size;
+	size_t output_size;
+	size_t vm_size;
+	size_t vm_command_count;
+	size_t handler_count;
+	FunctionReportItem() : address(0), compilation_type(ctNone), native_count(0), native_size(0), output_size(0), vm_size(0),
+		vm_command_count(0), handler_count(0) {}
+	double mutation_ratio() const { return native_size ? static_cast<double>(output_size) / native_size : 0; }
+	double dispatch_ratio() const { return native_count ? static_cast<double>(vm_command_count) / native_count : 0; }
+};
+
+class FunctionReport
+{
+public:
+	explicit FunctionReport();
+	void Add(const FunctionReportItem &item) { item_list_.push_back(item); }
+	size_t count() const { return item_list_.size(); }
+	const FunctionReportItem &item(size_t index) const { return item_list_[index]; }
+	std::string ToCSV() const;
+	std::string ToJSON() const;
+private:
+	std::vector<FunctionReportItem> item_list_;
+};
+
 struct CompileOptions {
 	uint32_t flags;
 	uint32_t vm_flags;
@@ -1176,12 +1217,14 @@ struct CompileOptions {
 	Watermark *watermark;
 	Script *script;
 	IArchitecture **architecture;
+	FunctionReport *function_report;
+	size_t thread_count;
 #ifdef ULTIMATE
 	std::string hwid;
 	LicensingManager *licensing_manager;
 	FileManager *file_manager;
 #endif
-	CompileOptions() : flags(0), vm_flags(0), sdk_flags(0), vm_count(1), watermark(NULL), script(NULL), architecture(NULL)
+	CompileOptions() : flags(0), vm_flags(0), sdk_flags(0), vm_count(1), watermark(NULL), script(NULL), architecture(NULL), function_report(NULL), thread_count(0)
 #ifdef ULTIMATE
 		, licensing_manager(NULL), file_manager(NULL)
 #endif
@@ -1305,7 +1348,8 @@ enum OpenMode {
 	foRead = 0x01,
 	foWrite = 0x02,
 	foHeaderOnly = 0x04,
-	foCopyToTemp = 0x08
+	foCopyToTemp = 0x08,
+	foUseCache = 0x10
 };
 
 enum OpenStatus {
@@ -1494,10 +1538,10 @@ struct CompileContext {
 		size_t i;
 		for (i = 0; i <= VAR_CPU_HASH; i++) {
 			runtime_var_index[i] = i;
-			runtime_var_salt[i] = static_cast<uint32_t>(rand());
+			runtime_var_salt[i] = static_cast<uint32_t>(Random());
 		}
 		for (i = 0; i <= VAR_CPU_HASH; i++) {
-			std::swap(runtime_var_index[i], runtime_var_index[rand() % (VAR_CPU_HASH + 1)]);
+			std::swap(runtime_var_index[i], runtime_var_index[Random() % (VAR_CPU_HASH + 1)]);
 		}
 		for (i = 0; i <= VAR_CPU_HASH; i++) {
 			if (runtime_var_index[i] > runtime_var_index[VAR_CPU_HASH])
@@ -1545,6 +1589,8 @@ public:
 	MarkerCommandList *Clone() const;
 	MarkerCommand *Add(uint64_t address, uint64_t operand_address, uint64_t name_reference, 
 		uint64_t name_address, ObjectType type = otUnknown);
+	void SaveToCache(Data &data) const;
+	void LoadFromCache(Buffer &buffer);
 private:
 	// no assignment op
 	MarkerCommandList &operator =(const MarkerCommandList &);
@@ -1666,6 +1712,8 @@ public:
 	virtual uint64_t CopyFrom(const IArchitecture &src, uint64_t count);
 	virtual uint64_t time_stamp() const { return 0; }
 	virtual std::string ANSIToUTF8(const std::string &str) const { return str; }
+	virtual void SaveAnalysis(Data &data) const;
+	virtual void LoadAnalysis(Buffer &buffer);
 #ifdef CHECKED
 	virtual bool check_hash() const;
 #endif
@@ -1676,9 +1724,6 @@ protected:
 	void Rebase(uint64_t delta_base);
 	void set_append_mode(bool value) { append_mode_ = value; }
 private:
-	std::string ReadANSIString(uint64_t address);
-	std::string ReadUnicodeString(uint64_t address);
-	std::string ReadANSIStringWithLength(uint64_t address);
 	IFile *owner_;
 	const IArchitecture *source_;
 	uint64_t offset_;
@@ -1695,4 +1740,120 @@ private:
 	BaseArchitecture &operator =(const BaseArchitecture &);
 };
 
+class AnalysisCache : public IObject
+{
+public:
+	explicit AnalysisCache(BaseArchitecture *owner, const std::vector<std::string> &file_list);
+	bool Load();
+	void Save();
+	std::string file_name() const { return file_name_; }
+	static std::string directory();
+	static void set_directory(const std::string &directory) { directory_ = directory; }
+	static uint64_t max_size() { return max_size_; }
+	static void set_max_size(uint64_t max_size) { max_size_ = max_size; }
+private:
+	void Trim() const;
+	BaseArchitecture *owner_;
+	std::string file_name_;
+	static std::string directory_;
+	static uint64_t max_size_;
+
+	// no copy ctr or assignment op
+	AnalysisCache(const AnalysisCache &);
+	AnalysisCache &operator =(const AnalysisCache &);
+};
+
+class FileStream;
+
+struct NotifyMessage {
+	MessageType type;
+	IObject *sender;
+	std::string message;
+	NotifyMessage(MessageType type_, IObject *sender_, const std::string &message_)
+		: type(type_), sender(sender_), message(message_) {}
+};
+
+class ArchitectureReader : public IArchitecture
+{
+public:
+	explicit ArchitectureReader(IArchitecture *arch);
+	~ArchitectureReader();
+	bool Open();
+	void TakeCompilerFunctions(std::vector<CompilerFunction *> &function_list);
+	void TakeMessages(std::vector<NotifyMessage> &message_list);
+	virtual std::string name() const { return arch_->name(); }
+	virtual uint32_t type() const { return arch_->type(); }
+	virtual OperandSize cpu_address_size() const { return arch_->cpu_address_size(); }
+	virtual uint64_t entry_point() const { return arch_->entry_point(); }
+	virtual uint32_t segment_alignment() const { return arch_->segment_alignment(); }
+	virtual ILoadCommandList *command_list() const { return arch_->command_list(); }
+	virtual ISectionList *segment_list() const { return arch_->segment_list(); }
+	virtual ISectionList *section_list() const { return arch_->section_list(); }
+	virtual IImportList *import_list() const { return arch_->import_list(); }
+	virtual IExportList *export_list() const { return arch_->export_list(); }
+	virtual IFixupList *fixup_list() const { return arch_->fixup_list(); }
+	virtual IRelocationList *relocation_list() const { return arch_->relocation_list(); }
+	virtual IFunctionList *function_list() const { return arch_->function_list(); }
+	virtual IVirtualMachineList *virtual_machine_list() const { return arch_->virtual_machine_list(); }
+	virtual IResourceList *resource_list() const { return arch_->resource_list(); }
+	virtual ISEHandlerList *seh_handler_list() const { return arch_->seh_handler_list(); }
+	virtual std::string map_file_name() const { return arch_->map_file_name(); }
+	virtual MapFunctionList *map_function_list() const { return arch_->map_function_list(); }
+	virtual CompilerFunctionList *compiler_function_list() const { return compiler_function_list_; }
+	virtual IRuntimeFunctionList *runtime_function_list() const { return arch_->runtime_function_list(); }
+	virtual MarkerCommandList *end_marker_list() const { return arch_->end_marker_list(); }
+	virtual bool visible() const { return arch_->visible(); }
+	virtual uint8_t ReadByte();
+	virtual uint16_t ReadWord();
+	virtual uint32_t ReadDWord();
+	virtual uint64_t ReadQWord();
+	virtual size_t Read(void *buffer, size_t count) const;
+	virtual size_t WriteByte(uint8_t /*value*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual size_t WriteWord(uint16_t /*value*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual size_t WriteDWord(uint32_t /*value*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual size_t WriteQWord(uint64_t /*value*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual size_t Write(const void * /*buffer*/, size_t /*count*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual std::string ReadString();
+	virtual std::string ReadString(uint64_t address);
+	virtual uint64_t Seek(uint64_t position) const;
+	virtual uint64_t Tell() const;
+	virtual uint64_t AddressTell();
+	virtual uint64_t Resize(uint64_t /*size*/) { throw std::runtime_error("Runtime error at Resize"); }
+	virtual bool AddressSeek(uint64_t address);
+	virtual bool Compile(CompileOptions & /*options*/, IArchitecture * /*runtime*/) { return false; }
+	virtual void Save(CompileContext & /*ctx*/) { }
+	virtual IFile *owner() const { return arch_->owner(); }
+	virtual ISection *selected_segment() const { return selected_segment_; }
+	virtual void Notify(MessageType type, IObject *sender, const std::string &message = "") const { message_list_.push_back(NotifyMessage(type, sender, message)); }
+	virtual void StartProgress(const std::string & /*caption*/, unsigned long long /*max*/) const { }
+	virtual void StepProgress(unsigned long long /*value*/ = 1ull) const { }
+	virtual void EndProgress() const { }
+	virtual const IArchitecture *source() const { return arch_->source(); }
+	virtual uint64_t offset() const { return arch_->offset(); }
+	virtual uint64_t size() const { return arch_->size(); }
+	virtual uint64_t image_base() const { return arch_->image_base(); }
+	virtual CallingConvention calling_convention() const { return arch_->calling_convention(); }
+	virtual uint64_t CopyFrom(const IArchitecture & /*src*/, uint64_t /*count*/) { throw std::runtime_error("Runtime error at Write"); }
+	virtual void ReadFromBuffer(Buffer & /*buffer*/) { }
+	virtual bool WriteToFile() { return false; }
+	virtual bool is_executable() const { return arch_->is_executable(); }
+	virtual IArchitecture *Clone(IFile * /*owner*/) const { return NULL; }
+	virtual std::string ANSIToUTF8(const std::string &str) const { return arch_->ANSIToUTF8(str); }
+#ifdef CHECKED
+	virtual bool check_hash() const { return arch_->check_hash(); }
+#endif
+	IArchitecture *arch() const { return arch_; }
+private:
+	IArchitecture *arch_;
+	FileStream *stream_;
+	CompilerFunctionList *compiler_function_list_;
+	size_t compiler_function_count_;
+	ISection *selected_segment_;
+	mutable std::vector<NotifyMessage> message_list_;
+
+	// no copy ctr or assignment op
+	ArchitectureReader(const ArchitectureReader &);
+	ArchitectureReader &operator =(const ArchitectureReader &);
+};
+
 #endif
\ No newline at end of file
@@ -2214,11 +2214,16 @@ void ILCommand::AddCryptorSection(const CompileContext &ctx, ValueCryptor *crypt
 
 ILVMCommand::ILVMCommand(ILCommand *owner, ILCommandType command_type, uint64_t value, TokenReference *token_reference)
 	: BaseVMCommand(owner), command_type_(command_type), value_(value), token_reference_(token_reference), address_(0),
-	crypt_command_(icUnknown), crypt_size_(osDWord), crypt_key_(0), link_command_(NULL)
+	crypt_command_(icUnknown), crypt_size_(osDWord), crypt_key_(0), link_command_(NULL), opcode_(NULL)
 {
 
 }
 
+IObject *ILVMCommand::handler() const
+{
+	return opcode_;
+}
+
 void ILVMCommand::Compile()
 {
 	reinterpret_cast<ILVirtualMachine *>(owner()->block()->virtual_machine())->CompileCommand(*this);
@@ -2438,7 +2443,7 @@ bool ILFunction::Prepare(const CompileContext &ctx)
 			}
 
 			for (j = 0; j < index_list.size(); j++) {
-				std::swap(index_list[j], index_list[rand() % index_list.size()]);
+				std::swap(index_list[j], index_list[Random() % index_list.size()]);
 			}
 
 			for (j = 0; j < index_list.size(); j++) {
@@ -2660,86 +2665,100 @@ void ILFunction::CreateBlocks()
 	}
 }
 
-void ILFunction::CalcStack(std::map<ILCommand *, int> &stack_map)
+void ILFunction::CalcStack(std::vector<int> &stack_list)
 {
-	size_t i, j;
-	ILCommand *command, *entry, *link_command;
-	std::set<ILCommand *> entry_stack, link_list;
+	enum {
+		stUnknown,
+		stQueued,
+		stCalculated
+	};
+
+	size_t i, j, k;
+	ILCommand *command;
+	std::unordered_map<ICommand *, size_t> index_map;
+	std::vector<uint8_t> state_list(count(), stUnknown);
+	std::vector<size_t> entry_list;
+
+	stack_list.assign(count(), 0);
+	index_map.reserve(count());
+	for (i = 0; i < count(); i++) {
+		index_map[item(i)] = i;
+	}
 
+	std::vector<std::pair<ICommand *, int> > start_list;
 	for (i = 0; i < function_info_list()->count(); i++) {
 		FunctionInfo *info = function_info_list()->item(i);
-		if (!info->source())
-			continue;
-
-		entry = reinterpret_cast<ILCommand *>(info->entry());
-		entry_stack.insert(entry);
-		stack_map[entry] = 0;
+		if (info->source())
+			start_list.push_back(std::make_pair(info->entry(), 0));
 	}
-	for (i = 0; i < this->link_list()->count(); i++) {
-		CommandLink *link = this->link_list()->item(i);
+	for (i = 0; i < link_list()->count(); i++) {
+		CommandLink *link = link_list()->item(i);
 		switch (link->type()) {
 		case ltSEHBlock:
-			entry = reinterpret_cast<ILCommand *>(link->to_command());
-			entry_stack.insert(entry);
-			stack_map[entry] = 1;
+			start_list.push_back(std::make_pair(link->to_command(), 1));
 			break;
 		case ltFinallyBlock:
-			entry = reinterpret_cast<ILCommand *>(link->to_command());
-			entry_stack.insert(entry);
-			stack_map[entry] = 0;
+			start_list.push_back(std::make_pair(link->to_command(), 0));
 			break;
 		}
 	}
+	for (i = 0; i < start_list.size(); i++) {
+		std::unordered_map<ICommand *, size_t>::const_iterator it = index_map.find(start_list[i].first);
+		if (it == index_map.end())
+			continue;
+		k = it->second;
+		stack_list[k] = start_list[i].second;
+		state_list[k] = stQueued;
+		entry_list.push_back(k);
+	}
 
-	int stack;
-	while (!entry_stack.empty()) {
-		entry = *entry_stack.begin();
-		j = IndexOf(entry);
-		std::map<ILCommand *, int>::const_iterator s = stack_map.find(entry);
-		if (s == stack_map.end())
-			throw std::runtime_error("Incorrect stack");
-		stack = s->second;
+	std::vector<ICommand *> link_command_list;
+	while (!entry_list.empty()) {
+		j = entry_list.back();
+		entry_list.pop_back();
+		if (state_list[j] == stCalculated)
+			continue;
+
+		int stack = stack_list[j];
 		for (i = j; i < count(); i++) {
 			command = item(i);
-			std::set<ILCommand *>::const_iterator c = entry_stack.find(command);
-			if (c != entry_stack.end())
-				entry_stack.erase(c);
-
 			if (command->type() == icComment || command->type() == icCase || command->is_data())
 				continue;
 
-			s = stack_map.find(command);
-			if (s != stack_map.end()) {
-				if (s->second != stack)
-					throw std::runtime_error("Incorrect stack");
-			}
-			else
-				stack_map[command] = stack;
+			if (state_list[i] != stUnknown && stack_list[i] != stack)
+				throw std::runtime_error("Incorrect stack");
+			// the rest of the block was already calculated with the same stack
+			if (state_list[i] == stCalculated)
+				break;
+			stack_list[i] = stack;
+			state_list[i] = stCalculated;
 
 			stack += command->GetStackLevel();
 
-			link_list.clear();
+			link_command_list.clear();
 			if (command->type() == icSwitch) {
 				size_t case_count = static_cast<uint32_t>(command->operand_value());
-				for (j = 0; j < case_count; j++) {
-					ILCommand *case_command = item(i + 1 + j);
-					link_list.insert(reinterpret_cast<ILCommand *>(case_command->link()->to_command()));
+				for (k = 0; k < case_count; k++) {
+					link_command_list.push_back(item(i + 1 + k)->link()->to_command());
 				}
 			}
 			else {
 				if (command->link() && (command->link()->type() == ltJmp || command->link()->type() == ltJmpWithFlag))
-					link_list.insert(reinterpret_cast<ILCommand *>(command->link()->to_command()));
+					link_command_list.push_back(command->link()->to_command());
 			}
-			for (std::set<ILCommand *>::const_iterator l = link_list.begin(); l != link_list.end(); l++) {
-				link_command = *l;
-				s = stack_map.find(link_command);
-				if (s != stack_map.end()) {
-					if (s->second != stack)
+			for (k = 0; k < link_command_list.size(); k++) {
+				std::unordered_map<ICommand *, size_t>::const_iterator it = index_map.find(link_command_list[k]);
+				if (it == index_map.end())
+					continue;
+				size_t link_index = it->second;
+				if (state_list[link_index] != stUnknown) {
+					if (stack_list[link_index] != stack)
 						throw std::runtime_error("Incorrect stack");
 				}
 				else {
-					entry_stack.insert(link_command);
-					stack_map[link_command] = stack;
+					stack_list[link_index] = stack;
+					state_list[link_index] = stQueued;
+					entry_list.push_back(link_index);
 				}
 			}
 
@@ -2755,7 +2774,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 	ILCommand *command, *insert_command, *entry;
 	std::map<ILCommand *, ILSignature *> variables_map;
 	uint32_t value, old_value, bit_mask;
-	std::map<ILCommand *, int> stack_map;
+	std::vector<int> stack_list;
 
 	for (i = 0; i < function_info_list()->count(); i++) {
 		FunctionInfo *info = function_info_list()->item(i);
@@ -2765,10 +2784,9 @@ void ILFunction::Mutate(const CompileContext &ctx)
 		ILStandAloneSig *locals = reinterpret_cast<NETRuntimeFunction *>(info->source())->method()->locals();
 		entry = reinterpret_cast<ILCommand *>(info->entry());
 		variables_map[entry] = locals ? locals->signature() : NULL;
-		stack_map[entry] = 0;
 	}
 
-	CalcStack(stack_map);
+	CalcStack(stack_list);
 
 	int stack;
 	std::list<ICommand *> new_command_list;
@@ -2844,7 +2862,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 							else {
 								insert_command_list.push_back(AddCommand(icLdloc, index));
 								old_value = v->second;
-								if (rand() & 1) {
+								if (Random() & 1) {
 									insert_command_list.push_back(AddCommand(icLdc_i4, value - old_value));
 									insert_command_list.push_back(AddCommand(icAdd, 0));
 								}
@@ -2882,15 +2900,15 @@ void ILFunction::Mutate(const CompileContext &ctx)
 		}
 
 		if (!predicate_list.empty() && !command->is_end()) {
-			if (rand() & 1) {
+			if (Random() & 1) {
 				// modify predicate
 				value = rand32();
 				bit_mask = 0x1f;
-				index = predicate_list[rand() % predicate_list.size()];
+				index = predicate_list[Random() % predicate_list.size()];
 				std::map<size_t, uint32_t>::const_iterator it = value_list.find(index);
 				if (it != value_list.end()) {
 					old_value = it->second;
-					if (rand() & 1) {
+					if (Random() & 1) {
 						insert_command_list.push_back(AddCommand(icLdc_i4, value));
 						insert_command_list.push_back(AddCommand(icLdloc, index));
 					}
@@ -2899,7 +2917,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 						insert_command_list.push_back(AddCommand(icLdc_i4, value));
 						std::swap(value, old_value);
 					}
-					switch (rand() % (8 + (old_value != 0 ? 2 : 0))) {
+					switch (Random() % (8 + (old_value != 0 ? 2 : 0))) {
 					case 0:
 						value += old_value;
 						insert_command_list.push_back(AddCommand(icAdd, 0));
@@ -2968,7 +2986,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 			index = NOT_ID;
 			for (std::map<size_t, uint32_t>::const_iterator it = value_list.begin(); it != value_list.end(); it++) {
 				index = it->first;
-				if (rand() & 1)
+				if (Random() & 1)
 					break;
 			}
 			value = value_list[index];
@@ -3016,7 +3034,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 				}
 
 				insert_command_list.push_back(AddCommand(icLdloc, index));
-				switch (rand() & 3) {
+				switch (Random() & 3) {
 				case 0:
 					insert_command_list.push_back(AddCommand(icLdc_i4, old_value - value));
 					insert_command_list.push_back(AddCommand(icAdd, 0));
@@ -3034,8 +3052,8 @@ void ILFunction::Mutate(const CompileContext &ctx)
 				command->clear();
 				command->Init(icNop);
 			}
-			else if (rand() & 1) {
-				stack = stack_map[command];
+			else if (Random() & 1) {
+				stack = stack_list[i];
 				if (stack < 1) 
 				{
 					ILCommand *random_command = NULL;
@@ -3044,9 +3062,9 @@ void ILFunction::Mutate(const CompileContext &ctx)
 						if (insert_command->type() == icComment || insert_command->type() == icCase || insert_command->is_data())
 							continue;
 						if (insert_command != command && insert_command->address_range() == address_range) {
-							if (stack == stack_map[insert_command]) {
+							if (stack == stack_list[j]) {
 								random_command = insert_command;
-								if (rand() & 1)
+								if (Random() & 1)
 									break;
 							}
 						}
@@ -3058,7 +3076,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 					if (random_command) {
 						old_value = rand32();
 						bit_mask = 0x1f;
-						if (rand() & 1) {
+						if (Random() & 1) {
 							insert_command_list.push_back(AddCommand(icLdloc, index));
 							insert_command_list.push_back(AddCommand(icLdc_i4, old_value));
 						}
@@ -3069,8 +3087,8 @@ void ILFunction::Mutate(const CompileContext &ctx)
 						}
 
 						ILCommandType branch_type;
-						if (rand() & 1) {
-							switch (rand() % 3) {
+						if (Random() & 1) {
+							switch (Random() % 3) {
 							case 0:
 								branch_type = (value < old_value) ? icBge_un : icBlt_un;
 								break;
@@ -3083,7 +3101,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 							}
 						}
 						else {
-							switch (rand() % (8 + (old_value != 0 ? 2 : 0))) {
+							switch (Random() % (8 + (old_value != 0 ? 2 : 0))) {
 							case 0:
 								value += old_value;
 								insert_command_list.push_back(AddCommand(icAdd, 0));
@@ -3179,7 +3197,7 @@ void ILFunction::Mutate(const CompileContext &ctx)
 					else {
 						insert_command_list.push_back(AddCommand(icLdloc, index));
 						old_value = v->second;
-						if (rand() & 1) {
+						if (Random() & 1) {
 							insert_command_list.push_back(AddCommand(icLdc_i4, value - old_value));
 							insert_command_list.push_back(AddCommand(icAdd, 0));
 						}
@@ -3932,7 +3950,7 @@ void ILFunction::CompileToVM(const CompileContext &ctx)
 					}
 				}
 				for (j = 0; j < arg_list.size(); j++) {
-					std::swap(arg_list[j], arg_list[rand() % arg_list.size()]);
+					std::swap(arg_list[j], arg_list[Random() % arg_list.size()]);
 				}
 
 				for (j = 0; j < arg_list.size(); j++) {
@@ -5055,6 +5073,14 @@ bool ILRuntimeData::Init(const CompileContext &ctx)
 		resources_entry_->include_option(roCreateNewBlock);
 		resources_size_ = static_cast<uint32_t>((count() - index) * OperandSizeToValue(osDWord));
 
+		size_t thread_count = GetThreadCount(ctx.options.thread_count);
+		std::vector<Data> data_list;
+		file_manager->ReadData(data_list, data_key, thread_count);
+
+		// assemblies with the same content share one data block
+		std::vector<size_t> original_list = FindDuplicates(data_list, thread_count);
+		std::vector<ILCommand *> data_command_list(file_manager->count());
+
 		PEFile pe_file;
 		for (i = 0; i < file_manager->count(); i++) {
 			internal_file = file_manager->item(i);
@@ -5090,13 +5116,14 @@ bool ILRuntimeData::Init(const CompileContext &ctx)
 
 			// write data
 			Notify(mtInformation, NULL, string_format("%s %s", language[lsLoading].c_str(), os::ExtractFileName(file_name.c_str()).c_str()));
-			data.resize(static_cast<size_t>(internal_file->stream()->Size()));
-			internal_file->stream()->Read(&data[0], data.size());
-			for (j = 0; j < data.size(); j++) {
-				data[j] = (data[j] ^ static_cast<uint8_t>(_rotl32(data_key, static_cast<int>(j)) + j));
+			if (original_list[i] == i) {
+				command = AddCommand(data_list[i]);
+				command->include_option(roCreateNewBlock);
+				data_command_list[i] = command;
+				data_list[i] = Data();
+			} else {
+				command = data_command_list[original_list[i]];
 			}
-			command = AddCommand(data);
-			command->include_option(roCreateNewBlock);
 			link = item(index + i * 4 + 1)->AddLink(0, ltOffset, command);
 			link->set_sub_value(image_base);
 		}
@@ -5572,7 +5599,7 @@ bool ILRuntimeCRCTable::Compile(const CompileContext &ctx)
 
 		size_t region_size, block_size;
 		for (region_size = region->size(); region_size != 0; region_size -= block_size, block_address += block_size) {
-			block_size = 0x1000 - (rand() & 0xff);
+			block_size = 0x1000 - (Random() & 0xff);
 			if (block_size > region_size)
 				block_size = region_size;
 
@@ -5581,14 +5608,14 @@ bool ILRuntimeCRCTable::Compile(const CompileContext &ctx)
 	}
 
 	for (i = 0; i < region_info_list_.size(); i++) {
-		std::swap(region_info_list_[i], region_info_list_[rand() % region_info_list_.size()]);
+		std::swap(region_info_list_[i], region_info_list_[Random() % region_info_list_.size()]);
 	}
 
 	size_t self_crc_offset = 0;
 	size_t self_crc_size = 0;
 	for (i = 0; i < region_info_list_.size(); i++) {
 		self_crc_size += sizeof(CRCInfo::POD);
-		if (self_crc_size > 0x1000 && (rand() & 1)) {
+		if (self_crc_size > 0x1000 && (Random() & 1)) {
 			region_info_list_.insert(region_info_list_.begin() + i + 1, RegionInfo(self_crc_offset, (uint32_t)self_crc_size, true));
 			self_crc_offset += self_crc_size;
 			self_crc_size = 0;
@@ -6095,7 +6122,7 @@ bool ILImport::Init(const CompileContext &ctx)
 		}
 	}
 	for (i = 0; i < import_list.size(); i++) {
-		std::swap(import_list[i], import_list[rand() % import_list.size()]);
+		std::swap(import_list[i], import_list[Random() % import_list.size()]);
 	}
 
 	size_t iat_index = 0;
@@ -6389,10 +6416,10 @@ void ILVirtualMachine::Init(const CompileContext &ctx)
 	// randomize opcodes
 	c = opcode_list_.count();
 	for (i = 0; i < opcode_list_.count(); i++) {
-		opcode_list_.SwapObjects(i, rand() % c);
+		opcode_list_.SwapObjects(i, Random() % c);
 	}
 	for (i = opcode_list_.count(); i < 0x100; i++) {
-		opcode = opcode_list_.item(rand() % i);
+		opcode = opcode_list_.item(Random() % i);
 		opcode_list_.Add(opcode->command_type(), opcode->entry());
 	}
 
@@ -6520,6 +6547,7 @@ void ILVirtualMachine::CompileCommand(ILVMCommand &vm_command)
 		break;
 	}
 
+	vm_command.set_opcode(opcode);
 	if (opcode) {
 		dump.InsertByte(0, opcode->opcode());
 	}
@@ -7802,7 +7830,7 @@ bool NETLoader::Compile(const CompileContext &ctx)
 	}
 
 	for (i = 0; i < block_list.size(); i++) {
-		std::swap(block_list[i], block_list[rand() % block_list.size()]);
+		std::swap(block_list[i], block_list[Random() % block_list.size()]);
 	}
 
 	if (ctx.file->runtime_function_list() && ctx.file->runtime_function_list()->count()) {
@@ -359,6 +359,8 @@ struct ILOpCode {
 class TokenReference;
 class ILCommand;
 
+class ILOpcodeInfo;
+
 class ILVMCommand : public BaseVMCommand
 {
 public:
@@ -374,6 +376,8 @@ public:
 	virtual bool is_end() const { return false; }
 	virtual void WriteToFile(IArchitecture &file);
 	virtual size_t dump_size() const { return dump_.size(); }
+	virtual IObject *handler() const;
+	void set_opcode(ILOpcodeInfo *opcode) { opcode_ = opcode; }
 	TokenReference *token_reference() const { return token_reference_; }
 	ILCommandType crypt_command() const { return crypt_command_; }
 	OperandSize crypt_size() const { return crypt_size_; }
@@ -392,6 +396,7 @@ private:
 	OperandSize crypt_size_;
 	uint64_t crypt_key_;
 	ILVMCommand *link_command_;
+	ILOpcodeInfo *opcode_;
 };
 
 class ILCommand: public BaseCommand
@@ -499,7 +504,7 @@ protected:
 	virtual void ParseBeginCommands(IArchitecture &file);
 	virtual void ParseEndCommands(IArchitecture &file);
 	virtual IFunction *CreateFunction(IFunction *parent) { return new ILFunction(NULL, cpu_address_size(), parent); }
-	void CalcStack(std::map<ILCommand *, int> &stack_map);
+	void CalcStack(std::vector<int> &stack_list);
 	void Mutate(const CompileContext &ctx);
 	void CompileToNative(const CompileContext &ctx);
 	void CompileToVM(const CompileContext &ctx);
@@ -122,7 +122,8 @@ int GlobalLocker::depth;
 #endif
 
 SettingsFile::SettingsFile()
-	: IObject(), document_(NULL), last_write_time_(0), watermarks_node_created_(false), auto_save_project_(false)
+	: IObject(), document_(NULL), last_write_time_(0), watermarks_node_created_(false), auto_save_project_(false),
+	analysis_cache_(true), analysis_cache_size_(256)
 {
 	file_name_ = os::CombineThisAppDataDirectory("VMProtect.dat");
 	if (!os::FileExists(file_name_.c_str()))
@@ -143,6 +144,8 @@ SettingsFile::SettingsFile()
 	if (settings_node_) {
 		settings_node_->QueryStringAttribute("Language", &language_);
 		settings_node_->QueryBoolAttribute("AutoSaveProject", &auto_save_project_);
+		settings_node_->QueryBoolAttribute("AnalysisCache", &analysis_cache_);
+		settings_node_->QueryUnsignedAttribute("AnalysisCacheSize", &analysis_cache_size_);
 	}
 
 	if (!language_manager_->GetLanguageById(language_))
@@ -222,6 +225,19 @@ void SettingsFile::set_auto_save_project(bool auto_save_project)
 	Save();
 }
 
+void SettingsFile::set_analysis_cache(bool analysis_cache)
+{
+	analysis_cache_ = analysis_cache;
+
+	GlobalLocker locker;
+	Open();
+	if (!settings_node_)
+		return;
+
+	settings_node_->SetAttribute("AnalysisCache", analysis_cache_);
+	Save();
+}
+
 size_t SettingsFile::inc_watermark_id()
 {
 	GlobalLocker locker;
@@ -107,6 +107,9 @@ public:
 	bool watermarks_node_created() const { return watermarks_node_created_; } 
 	bool auto_save_project() const { return auto_save_project_; };
 	void set_auto_save_project(bool auto_save_project);
+	bool analysis_cache() const { return analysis_cache_; }
+	void set_analysis_cache(bool analysis_cache);
+	uint32_t analysis_cache_size() const { return analysis_cache_size_; }
 private:
 	void Open();
 	std::string file_name_;
@@ -119,6 +122,8 @@ private:
 	LanguageManager *language_manager_;
 	bool watermarks_node_created_;
 	bool auto_save_project_;
+	bool analysis_cache_;
+	uint32_t analysis_cache_size_; // in megabytes
 
 	// no copy ctr or assignment op
 	SettingsFile(const SettingsFile &);
@@ -8915,11 +8915,11 @@ void IntelCommand::AddCorrectOperandSizeSection(const CompileContext &ctx, Opera
 
 void IntelCommand::AddRegistrAndValueSection(const CompileContext &ctx, uint8_t registr, OperandSize registr_size, uint64_t value, bool need_pushf)
 {
-	if (rand() & 1) {
+	if (Random() & 1) {
 		AddVMCommand(ctx, cmPush, otRegistr, registr_size, registr);
 		AddVMCommand(ctx, cmPush, otRegistr, registr_size, registr);
 
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, registr_size, false);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, registr_size, false);
 		AddVMCommand(ctx, cmPush, otValue, registr_size, ~value);
 		AddVMCommand(ctx, cmNor, otNone, registr_size, need_pushf);
 	} else {
@@ -8929,7 +8929,7 @@ void IntelCommand::AddRegistrAndValueSection(const CompileContext &ctx, uint8_t
 
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, registr_size, segSS);
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, registr_size, need_pushf);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, registr_size, need_pushf);
 	}
 }
 
@@ -8941,7 +8941,7 @@ void IntelCommand::AddRegistrOrValueSection(const CompileContext &ctx, uint8_t r
 
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, registr_size, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, registr_size, need_pushf);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, registr_size, need_pushf);
 }
 
 void IntelCommand::AddCombineFlagsSection(const CompileContext &ctx, uint16_t mask)
@@ -8986,7 +8986,7 @@ void IntelCommand::AddExtractFlagSection(const CompileContext &ctx, uint16_t fla
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regEFX);
 		if (!is_inverse) {
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regEFX);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 		}
 		AddVMCommand(ctx, cmPush, otValue, size_ , ~flags);
 		AddVMCommand(ctx, cmNor, otNone, size_, false);
@@ -9003,11 +9003,11 @@ void IntelCommand::AddExtractFlagSection(const CompileContext &ctx, uint16_t fla
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 
 			AddVMCommand(ctx, cmNor, otNone, size_, false);
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
@@ -9020,7 +9020,7 @@ void IntelCommand::AddExtractFlagSection(const CompileContext &ctx, uint16_t fla
 			if (is_inverse) {
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
-				AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+				AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 				AddVMCommand(ctx, cmPop, otRegistr, size_, regETX);
 			}
 			check_flag = flags & ~fl_OS;
@@ -9036,13 +9036,13 @@ void IntelCommand::AddExtractFlagSection(const CompileContext &ctx, uint16_t fla
 			if (is_os) {
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
-				AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+				AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
 
 				if (is_inverse) {
 					AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
-					AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+					AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 				}
 
 				AddVMCommand(ctx, cmNor, otNone, size_, false);
@@ -9052,7 +9052,7 @@ void IntelCommand::AddExtractFlagSection(const CompileContext &ctx, uint16_t fla
 			if (!is_inverse) {
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
 				AddVMCommand(ctx, cmPush, otRegistr, size_, regETX);
-				AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+				AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 				AddVMCommand(ctx, cmPop, otRegistr, size_, regETX);
 			}
 		}
@@ -9176,11 +9176,11 @@ void IntelCommand::AddJmpWithFlagSection(const CompileContext &ctx, IntelCommand
 	AddVMCommand(ctx, cmPush, otValue, size_, 0, voLinkCommand);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regEIX);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 	AddVMCommand(ctx, cmNand, otNone, size_, false);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, size_, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 
 	// second address AND condition
 	AddVMCommand(ctx, cmPush, otValue, size_, 0, voLinkCommand);
@@ -9188,7 +9188,7 @@ void IntelCommand::AddJmpWithFlagSection(const CompileContext &ctx, IntelCommand
 	AddVMCommand(ctx, cmNand, otNone, size_, false);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, size_, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 
 	// OR addresses 
 	AddVMCommand(ctx, cmAdd, otNone, size_, false);
@@ -9331,7 +9331,7 @@ void IntelCommand::AddCheckBreakpointSection(const CompileContext &ctx, OperandS
 	AddVMCommand(ctx, cmNor, otNone, size_, false);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, size_, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 	AddVMCommand(ctx, cmPop, otRegistr, size_, regETX);
 	AddVMCommand(ctx, cmPop, otRegistr, osWord, regEmpty);
 
@@ -9342,7 +9342,7 @@ void IntelCommand::AddCheckBreakpointSection(const CompileContext &ctx, OperandS
 	AddVMCommand(ctx, cmNor, otNone, size_, false);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, size_, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 	AddVMCommand(ctx, cmPop, otRegistr, size_, regETX);
 	AddVMCommand(ctx, cmPop, otRegistr, osWord, regEmpty);
 
@@ -9358,7 +9358,7 @@ void IntelCommand::AddCheckBreakpointSection(const CompileContext &ctx, OperandS
 	AddVMCommand(ctx, cmNand, otNone, address_size, false);
 	AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 	AddVMCommand(ctx, cmPush, otMemory, address_size, segSS);
-	AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, address_size, false);
+	AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, address_size, false);
 
 	AddVMCommand(ctx, cmAdd, otNone, address_size, false);
 }
@@ -9737,7 +9737,7 @@ void IntelCommand::CompileOperand(const CompileContext &ctx, size_t operand_inde
 		} else {
 			CompileOperand(ctx, operand_index);
 		}
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, operand_size, false);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, operand_size, false);
 	}
 }
 
@@ -9981,7 +9981,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, true);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, true);
 		AddVMCommand(ctx, cmPop, otRegistr, size_, save_flags ? regEIX : regEmpty);
 
 		CompileOperand(ctx, 0, coSaveResult);
@@ -10019,7 +10019,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 			AddVMCommand(ctx, cmPush, otMemory, size_, segSS);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, size_, false);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, size_, false);
 			AddVMCommand(ctx, cmPop, otRegistr, size_, regEFX);
 		}
 		break;
@@ -10034,7 +10034,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, false);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, false);
 
 		AddVMCommand(ctx, cmPush, otValue, os, 1);
 		AddVMCommand(ctx, cmAdd, otNone, os, false);
@@ -10061,7 +10061,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, os, segSS);
 
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, true);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, true);
 		AddVMCommand(ctx, cmPop, otRegistr, size_, save_flags ? regEIX : regEmpty);
 
 		if (type_ == cmCmp) {
@@ -10125,7 +10125,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 	case cmAnd: case cmTest:
 		os = operand_[0].size;
-		if (rand() & 1) {
+		if (Random() & 1) {
 			CompileOperand(ctx, 1, coInverse);
 			CompileOperand(ctx, 0, coInverse);
 			AddVMCommand(ctx, cmNor, otNone, os, true);
@@ -10136,7 +10136,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 			AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, true);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, true);
 		}
 		AddVMCommand(ctx, cmPop, otRegistr, size_, save_flags ? regEFX : regEmpty);
 
@@ -10149,7 +10149,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 	case cmXor:
 		os = operand_[0].size;
-		if (rand() & 1) {
+		if (Random() & 1) {
 			CompileOperand(ctx, 1, coInverse);
 			CompileOperand(ctx, 0, coInverse);
 			AddVMCommand(ctx, cmNor, otNone, os, false);
@@ -10177,14 +10177,14 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 	case cmOr:
 		os = operand_[0].size;
-		if (rand() & 1) {
+		if (Random() & 1) {
 			CompileOperand(ctx, 1);
 			CompileOperand(ctx, 0);
 			AddVMCommand(ctx, cmNor, otNone, os, false);
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 			AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, true);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, true);
 		} else {
 			CompileOperand(ctx, 1, coInverse);
 			CompileOperand(ctx, 0, coInverse);
@@ -10280,7 +10280,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 		AddVMCommand(ctx, cmShr, otNone, adr_os, false);
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, adr_os, segSS);
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, adr_os, false);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, adr_os, false);
 		AddVMCommand(ctx, cmAdd, otNone, adr_os, false);
 
 		switch (os) {
@@ -10362,7 +10362,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 		AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 		AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-		AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, false);
+		AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, false);
 
 		AddVMCommand(ctx, cmAdd, otNone, os, false);
 
@@ -10419,7 +10419,7 @@ void IntelCommand::CompileToVM(const CompileContext &ctx)
 
 			AddVMCommand(ctx, cmPush, otRegistr, size_, regESP);
 			AddVMCommand(ctx, cmPush, otMemory, os, segSS);
-			AddVMCommand(ctx, (rand() & 1) ? cmNor : cmNand, otNone, os, false);
+			AddVMCommand(ctx, (Random() & 1) ? cmNor : cmNand, otNone, os, false);
 
 			AddVMCommand(ctx, cmPush, otValue, os, 1);
 			AddVMCommand(ctx, cmAdd, otNone, os, false);
@@ -12740,7 +12740,7 @@ bool IntelCommand::Merge(ICommand *command)
 			dest_pos = i;
 		}
 		if (dest_pos != NOT_ID)
-			dest_pos = rand() % (dest_pos + 1);
+			dest_pos = Random() % (dest_pos + 1);
 	} else {
 		for (i = dest_count; i > 0; i--) {
 			if (!dest->item(i - 1)->can_merge(*vm_command_info_list_))
@@ -12748,7 +12748,7 @@ bool IntelCommand::Merge(ICommand *command)
 			dest_pos = i - 1;
 		}
 		if (dest_pos != NOT_ID)
-			dest_pos = dest_pos + rand() % (dest_count - dest_pos);
+			dest_pos = dest_pos + Random() % (dest_count - dest_pos);
 	}
 
 	if (dest_pos == NOT_ID)
@@ -12885,6 +12885,173 @@ uint32_t IntelCommand::calc_hash() const
 }
 #endif
 
+/**
+ * IntelFreeRegisters
+ */
+
+OperandSize IntelFreeRegisters::size(uint8_t reg) const
+{
+	for (size_t i = osQWord; i > osByte; i--) {
+		if (registr[i] & (1 << reg))
+			return static_cast<OperandSize>(i);
+	}
+	return osByte;
+}
+
+size_t IntelFreeRegisters::count() const
+{
+	size_t res = 0;
+	for (uint16_t mask = registr[osByte]; mask; mask &= mask - 1) {
+		res++;
+	}
+	return res;
+}
+
+uint8_t IntelFreeRegisters::item(size_t index) const
+{
+	for (uint8_t reg = 0; reg < 16; reg++) {
+		if ((registr[osByte] & (1 << reg)) && index-- == 0)
+			return reg;
+	}
+	throw std::runtime_error("subscript out of range");
+}
+
+void IntelFreeRegisters::Add(uint8_t reg, OperandSize size)
+{
+	for (size_t i = osByte; i <= size; i++) {
+		registr[i] |= (1 << reg);
+	}
+}
+
+/**
+ * IntelCommandTemplate
+ */
+
+bool IntelCommandTemplate::is_suitable(const IntelFreeRegisters &free_registers) const
+{
+	if (need_free_registr && free_registers.empty())
+		return false;
+	if ((need_free_flags & free_registers.flags) != need_free_flags)
+		return false;
+	for (size_t i = osByte; i <= osQWord; i++) {
+		if ((need_registers.registr[i] & free_registers.registr[i]) != need_registers.registr[i])
+			return false;
+	}
+	return true;
+}
+
+void IntelCommandTemplate::CreateCommands(OperandSize cpu_address_size, bool for_virtualization, std::vector<IntelCommand *> &command_list)
+{
+	IntelCommand *command;
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMov, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMov, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovsx, IntelOperand(otRegistr, osWord, regFree), IntelOperand(otRegistr, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovsx, IntelOperand(otRegistr, osDWord, regFree), IntelOperand(otRegistr, osWord)));
+	if (cpu_address_size == osQWord) {
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovsx, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osWord)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovsxd, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osDWord)));
+	}
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovzx, IntelOperand(otRegistr, osWord, regFree), IntelOperand(otRegistr, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovzx, IntelOperand(otRegistr, osDWord, regFree), IntelOperand(otRegistr, osWord)));
+	if (cpu_address_size == osQWord)
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmMovzx, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osWord)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmNot, IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmNeg, IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmInc, IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmDec, IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCmp, IntelOperand(otRegistr, osRandom), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCmp, IntelOperand(otRegistr, osRandom), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmTest, IntelOperand(otRegistr, osRandom), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmTest, IntelOperand(otRegistr, osRandom), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAnd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAnd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmOr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmOr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmXor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmXor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAdd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAdd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAdc, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmAdc, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSub, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSub, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSal, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSal, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSar, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSar, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRol, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRol, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShrd, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShrd, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShld, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otRegistr, osByte, regECX)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmShld, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBt, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBt, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBtc, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBtc, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBtr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBtr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBts, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBts, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+
+	command = new IntelCommand(NULL, cpu_address_size, cmSetXX, IntelOperand(otRegistr, osByte, regFree));
+	command->set_flags(flRandom);
+	command_list.push_back(command);
+
+	command = new IntelCommand(NULL, cpu_address_size, cmCmov, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord));
+	command->set_flags(flRandom);
+	command_list.push_back(command);
+
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmClc));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmStc));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCmc));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCbw));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCwde));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCwd));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCdq));
+	if (cpu_address_size == osQWord) {
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCdqe));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmCqo));
+	}
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmLahf));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBswap, IntelOperand(otRegistr, osRandomStartWord, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmXchg, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmXadd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom, regFree)));
+	command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmJmp, IntelOperand(otValue, cpu_address_size)));
+
+	// FIXME
+	/*
+	command = new IntelCommand(NULL, cpu_address_size, cmJmpWithFlag, IntelOperand(otValue, cpu_address_size));
+	command->set_flags(flRandom);
+	command_list.push_back(command);
+	*/
+
+	if (for_virtualization) {
+		/*
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmJCXZ, IntelOperand(otValue, cpu_address_size)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmLoop, IntelOperand(otValue, cpu_address_size)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmLoope, IntelOperand(otValue, cpu_address_size)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmLoopne, IntelOperand(otValue, cpu_address_size)));
+		*/
+	} else {
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSbb, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmSbb, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRcl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRcl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRcr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRcr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBsr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmBsf, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
+		command_list.push_back(new IntelCommand(NULL, cpu_address_size, cmRdtsc));
+	}
+}
+
 /**
  * IntelFunction
  */
@@ -15986,177 +16153,175 @@ bool IntelFunction::PrepareExtCommands(const CompileContext &ctx)
 	return true;
 }
 
-void IntelFunction::GetFreeRegisters(size_t index, CommandInfoList &free_registr_list) const
+void IntelFunction::GetFreeRegisters(std::vector<IntelFreeRegisters> &free_registr_list) const
 {
-	CommandInfoList used_registr_list;
+	// free_registr_list[i] describes the registers and flags that are written before they are read
+	// on the way from the command i to the end of its block, it is computed backwards in one pass.
+	// the second state of each step assumes that every register was already written before the command,
+	// it is needed for the writes to AH..BH that free the register only after its low part is free.
 	IntelCommandInfoList command_info_list(cpu_address_size());
+	IntelFreeRegisters next[2];
+	size_t i, j, v;
 
-	uint16_t free_flags = 0;
-	bool free_flags_extracted = false;
 	free_registr_list.clear();
-	for (size_t i = index; i < count(); i++) {
-		IntelCommand *command = item(i);
+	free_registr_list.resize(count() + 1);
+	for (i = count(); i > 0; i--) {
+		IntelCommand *command = item(i - 1);
+		IntelFreeRegisters cur[2];
 
-		bool is_end;
 		if (command->GetCommandInfo(command_info_list)) {
-			if (!free_flags_extracted) {
-				if (command_info_list.change_flags()) {
-					free_flags = command_info_list.change_flags();
-					free_flags_extracted = true;
-				}
-				if (command_info_list.need_flags()) {
-					free_flags &= ~command_info_list.need_flags();
-					free_flags_extracted = true;
-				}
+			bool is_end = command_info_list.GetInfo(atWrite, otBaseRegistr, regEIP) != NULL;
+			IntelFreeRegisters tail[2];
+			if (!is_end) {
+				tail[0] = next[0];
+				tail[1] = next[1];
 			}
 
-			for (size_t j = 0; j < command_info_list.count(); j++) {
+			uint16_t flags;
+			if (command_info_list.change_flags() || command_info_list.need_flags())
+				flags = command_info_list.change_flags() & ~command_info_list.need_flags();
+			else
+				flags = tail[0].flags;
+
+			uint16_t used = 0;
+			uint16_t touched = 0;
+			uint16_t written[2] = {0, 0xffff};
+			int write_size[2][16];
+			for (j = 0; j < command_info_list.count(); j++) {
 				CommandInfo *command_info = command_info_list.item(j);
-				if ((command_info->operand_type() == otRegistr || command_info->operand_type() == otHiPartRegistr) && command_info->value() != regESP && command_info->value() != regEIP) {
+				if ((command_info->operand_type() != otRegistr && command_info->operand_type() != otHiPartRegistr) || command_info->value() == regESP || command_info->value() >= 16)
+					continue;
+
+				uint8_t reg = command_info->value();
+				uint16_t mask = static_cast<uint16_t>(1 << reg);
+				if ((touched & mask) == 0) {
+					touched |= mask;
+					write_size[0][reg] = write_size[1][reg] = -1;
+				}
+				if (command_info->type() == atRead) {
+					used |= mask;
+				} else if ((used & mask) == 0) {
 					OperandSize reg_size = command_info->size();
 					if (command_info->operand_type() == otHiPartRegistr)
 						reg_size = (reg_size == osByte) ? osWord : osQWord;
-					uint8_t reg = command_info->value();
+					if (reg_size > osQWord)
+						reg_size = osQWord;
+					for (v = 0; v < 2; v++) {
+						if (command_info->operand_type() == otHiPartRegistr && (written[v] & mask) == 0)
+							continue;
+						if (write_size[v][reg] < reg_size)
+							write_size[v][reg] = reg_size;
+						written[v] |= mask;
+					}
+				}
+			}
+
+			for (v = 0; v < 2; v++) {
+				for (j = osByte; j <= osQWord; j++) {
+					cur[v].registr[j] = tail[v].registr[j] & ~touched;
+				}
+				cur[v].flags = flags;
+				for (uint8_t reg = 0; reg < 16; reg++) {
+					uint16_t mask = static_cast<uint16_t>(1 << reg);
+					if ((touched & mask) == 0)
+						continue;
 
-					if (command_info->type() == atRead) {
-						used_registr_list.Add(atRead, reg, otRegistr, reg_size);
-					} else if (!used_registr_list.GetInfo(atRead, otRegistr, reg) && (command_info->operand_type() != otHiPartRegistr || free_registr_list.GetInfo(atWrite, otRegistr, reg))) {
-						free_registr_list.Add(atWrite, reg, otRegistr, reg_size);
+					int size = write_size[v][reg];
+					if ((used & mask) == 0) {
+						const IntelFreeRegisters &tail_registers = tail[(written[v] & mask) ? 1 : 0];
+						if (tail_registers.is_free(reg) && size < tail_registers.size(reg))
+							size = tail_registers.size(reg);
 					}
+					if (size >= 0)
+						cur[v].Add(reg, static_cast<OperandSize>(size));
 				}
 			}
-			is_end = command_info_list.GetInfo(atWrite, otBaseRegistr, regEIP) != NULL;
-		} else {
-			is_end = true;
 		}
 
-		if (is_end)
-			break;
+		free_registr_list[i - 1] = cur[0];
+		next[0] = cur[0];
+		next[1] = cur[1];
 	}
-	free_registr_list.set_change_flags(free_flags);
 }
 
-void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
+static std::vector<IntelCommandTemplate> BuildMutationTemplates(OperandSize cpu_address_size, bool for_virtualization)
 {
-	#define osRandom (OperandSize)0x80
-	#define osRandomStartWord (OperandSize)0x81
+	IntelCommand *command;
+	std::vector<IntelCommand *> command_list;
+	IntelCommandTemplate::CreateCommands(cpu_address_size, for_virtualization, command_list);
 
-	enum {
-		regFree = 0xf,
-		flRandom = 0xff
-	};
+	std::vector<IntelCommandTemplate> res;
+	IntelCommandInfoList command_info_list(cpu_address_size);
+	for (size_t i = 0; i < command_list.size(); i++) {
+		command = command_list[i];
+		if (command->GetCommandInfo(command_info_list)) {
+			IntelCommandTemplate command_template;
+			command_template.type = static_cast<IntelCommandType>(command->type());
+			for (size_t k = 0; k < _countof(command_template.operand); k++) {
+				command_template.operand[k] = command->operand(k);
+			}
+			command_template.flags = command->flags();
+			command_template.need_free_registr = false;
+			command_template.need_free_flags = 0;
+
+			bool is_ok = true;
+			for (size_t k = 0; k < command_info_list.count() && is_ok; k++) {
+				CommandInfo *command_info = command_info_list.item(k);
+				if (command_info->type() == atWrite && (command_info->operand_type() == otRegistr || command_info->operand_type() == otHiPartRegistr)) {
+					if (command_info->value() == IntelCommandTemplate::regFree) {
+						command_template.need_free_registr = true;
+					} else if (command_info->value() == regEFX) {
+						command_template.need_free_flags = command_info_list.change_flags();
+					} else {
+						OperandSize registr_size;
+						if (command_info->operand_type() == otHiPartRegistr) {
+							switch (command_info->size()) {
+							case osByte:
+								registr_size = osWord;
+								break;
+							case osWord:
+								registr_size = osDWord;
+								break;
+							default:
+								registr_size = osQWord;
+								break;
+							}
+						} else {
+							registr_size = command_info->size();
+						}
 
-	size_t i, j, insert_count;
-	IntelCommand *command, *new_command;
+						// registers above 15 and random sizes never appear in the free list
+						if (command_info->value() >= 16 || registr_size > osQWord)
+							is_ok = false;
+						else
+							command_template.need_registers.Add(command_info->value(), registr_size);
+					}
+				}
+			}
+			if (is_ok)
+				res.push_back(command_template);
+		}
+		delete command;
+	}
 
-	std::vector<IntelCommand *> template_command_list;
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMov, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMov, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovsx, IntelOperand(otRegistr, osWord, regFree), IntelOperand(otRegistr, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovsx, IntelOperand(otRegistr, osDWord, regFree), IntelOperand(otRegistr, osWord)));
-	if (cpu_address_size() == osQWord) {
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovsx, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osWord)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovsxd, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osDWord)));
-	}
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovzx, IntelOperand(otRegistr, osWord, regFree), IntelOperand(otRegistr, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovzx, IntelOperand(otRegistr, osDWord, regFree), IntelOperand(otRegistr, osWord)));
-	if (cpu_address_size() == osQWord)
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmMovzx, IntelOperand(otRegistr, osQWord, regFree), IntelOperand(otRegistr, osWord)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmNot, IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmNeg, IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmInc, IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmDec, IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCmp, IntelOperand(otRegistr, osRandom), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCmp, IntelOperand(otRegistr, osRandom), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmTest, IntelOperand(otRegistr, osRandom), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmTest, IntelOperand(otRegistr, osRandom), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAnd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAnd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmOr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmOr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmXor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmXor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAdd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAdd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAdc, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmAdc, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSub, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSub, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSal, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSal, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSar, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSar, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRol, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRol, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRor, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShrd, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShrd, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShld, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otRegistr, osByte, regECX)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmShld, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBt, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBt, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBtc, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBtc, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBtr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBtr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otValue, osByte)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBts, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBts, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-
-	command = new IntelCommand(this, cpu_address_size(), cmSetXX, IntelOperand(otRegistr, osByte, regFree));
-	command->set_flags(flRandom);
-	template_command_list.push_back(command);
+	return res;
+}
 
-	command = new IntelCommand(this, cpu_address_size(), cmCmov, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord));
-	command->set_flags(flRandom);
-	template_command_list.push_back(command);
-
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmClc));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmStc));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCmc));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCbw));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCwde));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCwd));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCdq));
-	if (cpu_address_size() == osQWord) {
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCdqe));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmCqo));
-	}
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmLahf));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBswap, IntelOperand(otRegistr, osRandomStartWord, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmXchg, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmXadd, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom, regFree)));
-	template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmJmp, IntelOperand(otValue, cpu_address_size())));
+const std::vector<IntelCommandTemplate> &IntelFunction::GetMutationTemplates(OperandSize cpu_address_size, bool for_virtualization)
+{
+	static const std::vector<IntelCommandTemplate> template_list[2][2] = {
+		{BuildMutationTemplates(osDWord, false), BuildMutationTemplates(osDWord, true)},
+		{BuildMutationTemplates(osQWord, false), BuildMutationTemplates(osQWord, true)}
+	};
 
-	// FIXME
-	/*
-	command = new IntelCommand(this, cpu_address_size(), cmJmpWithFlag, IntelOperand(otValue, cpu_address_size()));
-	command->set_flags(flRandom);
-	template_command_list.push_back(command);
-	*/
+	return template_list[cpu_address_size == osQWord ? 1 : 0][for_virtualization ? 1 : 0];
+}
 
-	if (for_virtualization) {
-		/*
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmJCXZ, IntelOperand(otValue, cpu_address_size())));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmLoop, IntelOperand(otValue, cpu_address_size())));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmLoope, IntelOperand(otValue, cpu_address_size())));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmLoopne, IntelOperand(otValue, cpu_address_size())));
-		*/
-	} else {
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSbb, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osRandom)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmSbb, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osRandom)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRcl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRcl, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRcr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otRegistr, osByte, regECX)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRcr, IntelOperand(otRegistr, osRandom, regFree), IntelOperand(otValue, osByte)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBsr, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmBsf, IntelOperand(otRegistr, osRandomStartWord, regFree), IntelOperand(otRegistr, osRandomStartWord)));
-		template_command_list.push_back(new IntelCommand(this, cpu_address_size(), cmRdtsc));
-	}
+void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
+{
+	size_t i, j, insert_count;
+	IntelCommand *command, *new_command;
+	const std::vector<IntelCommandTemplate> &template_list = GetMutationTemplates(cpu_address_size(), for_virtualization);
 
 	size_t link_count = link_list()->count();
 
@@ -16253,8 +16418,9 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 	}
 
 	IntelCommandInfoList command_info_list(cpu_address_size());
-	CommandInfoList free_registr_list;
-	std::vector<IntelCommand *> garbage_command_list;
+	std::vector<IntelFreeRegisters> free_registr_list;
+	std::vector<const IntelCommandTemplate *> garbage_command_list;
+	GetFreeRegisters(free_registr_list);
 	insert_count = 0;
 
 	std::list<ICommand *> new_command_list;
@@ -16287,12 +16453,12 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 			continue;
 
 		bool is_end;
+		const IntelFreeRegisters &free_registers = free_registr_list[i + 1];
 		if (command->GetCommandInfo(command_info_list)) {
-			GetFreeRegisters(i + 1, free_registr_list);
 			// mutate command
 			switch (command->type()) {
 			case cmXor:
-				if (command->operand(0).type == otRegistr && command->operand(1).type == otRegistr && command->operand(0).registr == command->operand(1).registr && (rand() & 1)) {
+				if (command->operand(0).type == otRegistr && command->operand(1).type == otRegistr && command->operand(0).registr == command->operand(1).registr && (Random() & 1)) {
 					// xor reg, reg -> sub reg, reg
 					command->Init(cmSub, command->operand(0), command->operand(1));
 					command->CompileToNative();
@@ -16300,15 +16466,15 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 				break;
 
 			case cmCall:
-				if ((command->options() & roFar) == 0 && (rand() & 1)) {
+				if ((command->options() & roFar) == 0 && (Random() & 1)) {
 				}
 				break;
 
 			case cmAdd:
 				if (command->operand(0).type == otRegistr && command->operand(0).size == cpu_address_size() 
 					&& ((command->operand(1).type == otRegistr && command->operand(1).registr != regESP) || (command->operand(1).type == otValue && cpu_address_size() != osQWord)) 
-					&& (rand() & 1)) {
-					if ((command_info_list.change_flags() & free_registr_list.change_flags()) == command_info_list.change_flags()) {
+					&& (Random() & 1)) {
+					if ((command_info_list.change_flags() & free_registers.flags) == command_info_list.change_flags()) {
 						// add reg, xxxx -> lea reg, [reg + xxxx]
 						IntelOperand second_operand = command->operand(1);
 						second_operand.type |= otMemory;
@@ -16334,8 +16500,8 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 			case cmSub:
 				if (command->operand(0).type == otRegistr && command->operand(0).size == cpu_address_size() 
 					&& (command->operand(1).type == otValue && cpu_address_size() != osQWord)
-					&& (rand() & 1)) {
-					if ((command_info_list.change_flags() & free_registr_list.change_flags()) == command_info_list.change_flags()) {
+					&& (Random() & 1)) {
+					if ((command_info_list.change_flags() & free_registers.flags) == command_info_list.change_flags()) {
 						// sub reg, xxxx -> lea reg, [reg - xxxx]
 						IntelOperand second_operand = command->operand(1);
 						second_operand.type |= otMemory;
@@ -16355,7 +16521,7 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 				break;
 
 			case cmJmp:
-				if (!for_virtualization && (command->options() & roFar) == 0 && command->operand(0).type != otValue && (rand() & 1)) {
+				if (!for_virtualization && (command->options() & roFar) == 0 && command->operand(0).type != otValue && (Random() & 1)) {
 					// jmp xxxx -> push xxxx, ret
 					command->Init(cmPush, command->operand(0));
 					command->CompileToNative();
@@ -16378,53 +16544,16 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 		if (!is_end) {
 			// add garbage code
 			garbage_command_list.clear();
-			for (j = 0; j < template_command_list.size(); j++) {
-				command = template_command_list[j];
-				if (!command->GetCommandInfo(command_info_list))
-					continue;
-
-				bool is_ok = true;
-				for (size_t k = 0; k < command_info_list.count() && is_ok; k++) {
-					CommandInfo *command_info = command_info_list.item(k);
-					if (command_info->type() == atWrite && (command_info->operand_type() == otRegistr || command_info->operand_type() == otHiPartRegistr)) {
-						if (command_info->value() == regFree) {
-							if (!free_registr_list.count())
-								is_ok = false;
-						} else if (command_info->value() == regEFX) {
-							if ((command_info_list.change_flags() & free_registr_list.change_flags()) != command_info_list.change_flags())
-								is_ok = false;
-						} else {
-							OperandSize registr_size;
-							if (command_info->operand_type() == otHiPartRegistr) {
-								switch (command_info->size()) {
-								case osByte:
-									registr_size = osWord;
-									break;
-								case osWord:
-									registr_size = osDWord;
-									break;
-								default:
-									registr_size = osQWord;
-									break;
-								}
-							} else {
-								registr_size = command_info->size();
-							}
-
-							CommandInfo *free_registr = free_registr_list.GetInfo(atWrite, otRegistr, command_info->value());
-							if (!free_registr || free_registr->size() < registr_size)
-								is_ok = false;
-						}
-					}
-				}
-				if (is_ok)
-					garbage_command_list.push_back(command);
+			for (j = 0; j < template_list.size(); j++) {
+				const IntelCommandTemplate &command_template = template_list[j];
+				if (command_template.is_suitable(free_registers))
+					garbage_command_list.push_back(&command_template);
 			}
 
-			size_t c = rand() % 4;
+			size_t c = Random() % 4;
 			for (size_t m = 0; m < c && !garbage_command_list.empty(); m++) {
-				j = rand() % garbage_command_list.size();
-				command = garbage_command_list[j];
+				j = Random() % garbage_command_list.size();
+				const IntelCommandTemplate *command_template = garbage_command_list[j];
 				garbage_command_list.erase(garbage_command_list.begin() + j);
 
 				IntelOperand operand[3];
@@ -16434,26 +16563,25 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 				bool is_ok = true;
 				uint8_t max_registr = 0;
 				for (size_t k = 0; k < _countof(operand) && is_ok; k++) {
-					IntelOperand tmp = command->operand(k);
+					IntelOperand tmp = command_template->operand[k];
 					if (tmp.type == otNone)
 						continue;
 
-					if (tmp.size == osRandomStartWord && min_size < osWord)
+					if (tmp.size == IntelCommandTemplate::osRandomStartWord && min_size < osWord)
 						min_size = osWord;
 
 					if (tmp.type == otRegistr) {
-						if (tmp.registr == regFree) {
-							if (free_registr_list.count()) {
-								CommandInfo *free_registr = free_registr_list.item(rand() % free_registr_list.count());
-								registr[k] = free_registr->value();
-								if (max_size > free_registr->size())
-									max_size = free_registr->size();
+						if (tmp.registr == IntelCommandTemplate::regFree) {
+							if (!free_registers.empty()) {
+								registr[k] = free_registers.item(Random() % free_registers.count());
+								if (max_size > free_registers.size(registr[k]))
+									max_size = free_registers.size(registr[k]);
 							} else {
 								is_ok = false;
 								break;
 							}
 						} else if (tmp.registr == 0) {
-							registr[k] = rand() % ((cpu_address_size() == osDWord) ? 8 : 16);
+							registr[k] = Random() % ((cpu_address_size() == osDWord) ? 8 : 16);
 						} else {
 							registr[k] = tmp.registr;
 						}
@@ -16461,7 +16589,7 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 							max_registr = registr[k];
 						if (cpu_address_size() == osDWord && registr[k] > 3 && min_size < osWord)
 							min_size = osWord;
-						if (tmp.size & osRandom) {
+						if (tmp.size & IntelCommandTemplate::osRandom) {
 							if (min_size > max_size)
 								is_ok = false;
 						} else if (tmp.size < min_size || tmp.size > max_size)
@@ -16473,16 +16601,16 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 					OperandSize random_size = min_size;
 					for (int size = min_size; size <= max_size; size++) {
 						random_size = static_cast<OperandSize>(size);
-						if (rand() & 1)
+						if (Random() & 1)
 							break;
 					}
 
 					for (size_t k = 0; k < _countof(operand) && is_ok; k++) {
-						IntelOperand tmp = command->operand(k);
-						if (tmp.size & osRandom)
+						IntelOperand tmp = command_template->operand[k];
+						if (tmp.size & IntelCommandTemplate::osRandom)
 							tmp.size = random_size;
 						if (tmp.type == otRegistr) {
-							if (tmp.size == osByte && (tmp.registr == regFree || tmp.registr == 0) && max_size > osByte && max_registr < 4 && (rand() & 1))
+							if (tmp.size == osByte && (tmp.registr == IntelCommandTemplate::regFree || tmp.registr == 0) && max_size > osByte && max_registr < 4 && (Random() & 1))
 								tmp.type = otHiPartRegistr;
 							tmp.registr = registr[k];
 						} else if (tmp.type == otValue) {
@@ -16503,12 +16631,12 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 						}
 						operand[k] = tmp;
 					}
-					uint16_t flags = command->flags();
-					uint32_t options = command->options();
-					command = new IntelCommand(this, cpu_address_size(), static_cast<IntelCommandType>(command->type()), operand[0], operand[1], operand[2]);
+					uint16_t flags = command_template->flags;
+					bool inverse_flag = false;
+					command = new IntelCommand(this, cpu_address_size(), command_template->type, operand[0], operand[1], operand[2]);
 					if (flags) {
-						if (flags == flRandom) {
-							switch (rand() % 8) {
+						if (flags == IntelCommandTemplate::flRandom) {
+							switch (Random() % 8) {
 							case 0: flags = fl_O; break;
 							case 1: flags = fl_C; break;
 							case 2: flags = fl_Z; break;
@@ -16518,11 +16646,11 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 							case 6: flags = fl_S | fl_O; break;
 							default: flags = fl_Z | fl_S | fl_O; break;
 							}
-							if (rand() & 1)
-								options |= roInverseFlag;
+							if (Random() & 1)
+								inverse_flag = true;
 						}
 						command->set_flags(flags);
-						if (options & roInverseFlag)
+						if (inverse_flag)
 							command->include_option(roInverseFlag);
 					}
 					command->include_option(roNoProgress);
@@ -16553,10 +16681,6 @@ void IntelFunction::Mutate(const CompileContext &ctx, bool for_virtualization)
 		link_list()->item(i)->from_command()->PrepareLink(ctx);
 	}
 
-	for (i = 0; i < template_command_list.size(); i++) {
-		delete template_command_list[i];
-	}
-
 	assign(new_command_list);
 }
 
@@ -16910,7 +17034,7 @@ uint16_t IntelFlagsValue::GetRandom() const
 	if ((mask_ & (fl_Z | fl_S | fl_O)) == (fl_Z | fl_S | fl_O))
 		list.push_back(fl_Z | fl_S | fl_O);
 
-	return list.empty() ? 0 : list[rand() % list.size()];
+	return list.empty() ? 0 : list[Random() % list.size()];
 }
 
 bool IntelFlagsValue::Check(uint16_t flags) const
@@ -17199,7 +17323,7 @@ IntelStackValue *IntelStack::GetRandom(uint32_t types)
 			list.push_back(stack_item);
 		}
 	}
-	return list.empty() ? NULL : list[rand() % list.size()];
+	return list.empty() ? NULL : list[Random() % list.size()];
 }
 
 /**
@@ -17256,14 +17380,14 @@ IntelCommand *IntelObfuscation::AddCommand(IntelCommandType command_type, IntelO
 			IntelOperand *operand = (i == 0) ? &operand1 : &operand2;
 			uint16_t type = operand->type & (otMemory | otBaseRegistr | otRegistr);
 			if (type == (otMemory | otBaseRegistr) || type == (otMemory | otRegistr)) {
-				IntelRegistrValue *reg_value = registr_values_.item(rand() % registr_values_.count());
+				IntelRegistrValue *reg_value = registr_values_.item(Random() % registr_values_.count());
 				if ((operand->type & otRegistr) && !operand->scale_registr) {
 					operand->base_registr = operand->registr;
 					operand->type -= otRegistr;
 					operand->type |= otBaseRegistr;
 				}
 				if (operand->type & otBaseRegistr) {
-					operand->scale_registr = rand() & 3;
+					operand->scale_registr = Random() & 3;
 					uint64_t tmp = operand->value - (reg_value->value() << operand->scale_registr);
 					if (DWordToInt64(static_cast<uint32_t>(tmp)) == tmp) {
 						operand->type |= (otRegistr | otValue);
@@ -17403,7 +17527,7 @@ void IntelObfuscation::Compile(IntelFunction *func, size_t index)
 
 			case cmCall:
 				if ((command->options() & roUseAsJmp) && command->link()) {
-					size_t ret_pos = rand() % stack_.count();
+					size_t ret_pos = Random() % stack_.count();
 
 					for (j = stack_.count(); j > 0; j--) {
 						IntelStackValue *stack_item = stack_.item(j - 1);
@@ -17518,7 +17642,7 @@ void IntelObfuscation::Compile(IntelFunction *func, size_t index)
 				IntelCommand *to_command;
 				if (command->type() == cmJmpWithFlag && (command->options() & roUseAsJmp) == 0) {
 					while (true) {
-						j = rand() % command_list_.size();
+						j = Random() % command_list_.size();
 						if (j == it->second || j == it->second + 1)
 							continue;
 						to_command = command_list_[j];
@@ -17552,7 +17676,7 @@ void IntelObfuscation::AddRandomCommands()
 	uint64_t source_value;
 	OperandSize size;
 
-	c = 30 + (rand() % 10);
+	c = 30 + (Random() % 10);
 	for (i = 0; i < c; i++) {
 
 		last_command = command_list_.empty() ? NULL : command_list_.back();
@@ -17636,11 +17760,11 @@ void IntelObfuscation::AddRandomCommands()
 			}
 		}
 
-		command_type = template_command_list[rand() % template_command_list.size()];
+		command_type = template_command_list[Random() % template_command_list.size()];
 		switch (command_type) {
 		case cmPush:
-			if (rand() & 1) {
-				reg = rand() % registr_count;
+			if (Random() & 1) {
+				reg = Random() % registr_count;
 				if (reg == regESP)
 					reg = regEFX;
 
@@ -17714,7 +17838,7 @@ void IntelObfuscation::AddRandomCommands()
 					for (j = stack_.count(); j > 0; j--) {
 						stack_item = stack_.item(j - 1);
 						if (stack_item->type() == vtValue || stack_item->type() == vtReturnAddress || (stack_item->type() == vtRegistr && stack_item->value() == regEmpty)) {
-							if (rand() & 1)
+							if (Random() & 1)
 								break;
 
 							delete stack_item;
@@ -17740,7 +17864,7 @@ void IntelObfuscation::AddRandomCommands()
 			new_command = AddCommand(cmJmpWithFlag, IntelOperand(otValue, cpu_address_size, 0));
 			new_command->AddLink(0, ltJmpWithFlag);
 			new_command->set_flags(command_flags);
-			if (rand() & 1)
+			if (Random() & 1)
 				new_command->include_option(roInverseFlag);
 
 			if (flags_.Check(new_command->flags()) == ((new_command->options() & roInverseFlag) == 0))
@@ -17845,7 +17969,7 @@ void IntelObfuscation::AddRandomCommands()
 					if (!command_flags)
 						break;
 
-					if (rand() & 1)
+					if (Random() & 1)
 						inverse_flags = true;
 				} 
 				else switch (command_type) {
@@ -17879,7 +18003,7 @@ void IntelObfuscation::AddRandomCommands()
 
 				IntelOperand first_operand, second_operand;
 
-				switch (rand() % 4) {
+				switch (Random() % 4) {
 				case 0:
 					first_operand.size = osByte;
 					break;
@@ -17918,18 +18042,18 @@ void IntelObfuscation::AddRandomCommands()
 					first_operand.size = cpu_address_size;
 					second_operand.size = first_operand.size;
 
-					reg_value = registr_values_.item(rand() % registr_values_.count());
+					reg_value = registr_values_.item(Random() % registr_values_.count());
 
 					second_operand.type = otMemory | otRegistr | otValue;
 					second_operand.registr = reg_value->registr();
-					second_operand.scale_registr = rand() & 3;
+					second_operand.scale_registr = Random() & 3;
 
 					source_value = reg_value->value();
 					if (second_operand.scale_registr)
 						source_value = source_value << second_operand.scale_registr;
 
-					if (rand() & 1) {
-						reg_value = registr_values_.item(rand() % registr_values_.count());
+					if (Random() & 1) {
+						reg_value = registr_values_.item(Random() % registr_values_.count());
 						second_operand.type |= otBaseRegistr;
 						second_operand.base_registr = reg_value->registr();
 						source_value = source_value + reg_value->value();
@@ -17955,7 +18079,7 @@ void IntelObfuscation::AddRandomCommands()
 				}
 				else if (command_type == cmShr || command_type == cmShl || command_type == cmSal || command_type == cmSar || command_type == cmRol || command_type == cmRor) {
 					second_operand.size = osByte;
-					switch (rand() % 2) {
+					switch (Random() % 2) {
 					case 0:
 						reg_value = registr_values_.GetRegistr(regECX);
 						if (reg_value) {
@@ -17967,7 +18091,7 @@ void IntelObfuscation::AddRandomCommands()
 						}
 					default:
 						second_operand.type = otValue;
-						second_operand.value = static_cast<uint8_t>(rand());
+						second_operand.value = static_cast<uint8_t>(Random());
 						if (!second_operand.value)
 							second_operand.value = 1;
 						second_operand.value_size = second_operand.size;
@@ -17978,10 +18102,10 @@ void IntelObfuscation::AddRandomCommands()
 				}
 				else if (command_type != cmNot && command_type != cmNeg && command_type != cmBswap) {
 					second_operand.size = first_operand.size;
-					switch (rand() % 3) {
+					switch (Random() % 3) {
 					case 0:
 						if (registr_values_.count()) {
-							reg_value = registr_values_.item(rand() % registr_values_.count());
+							reg_value = registr_values_.item(Random() % registr_values_.count());
 							source_value = reg_value->value();
 
 							second_operand.type = otRegistr;
@@ -18035,8 +18159,8 @@ void IntelObfuscation::AddRandomCommands()
 					if (first_operand.type != otRegistr || first_operand.size == osByte || second_operand.type == otValue)
 						break;
 
-					second_operand.size = rand() & 1 ? osByte : osWord;
-					if (first_operand.size == osQWord && command_type == cmMovsx && (rand() & 1)) {
+					second_operand.size = Random() & 1 ? osByte : osWord;
+					if (first_operand.size == osQWord && command_type == cmMovsx && (Random() & 1)) {
 						command_type = cmMovsxd;
 						second_operand.size = osDWord;
 					}
@@ -18540,7 +18664,7 @@ void IntelFunction::AfterCompile(const CompileContext &ctx)
 					if (next_command && (from_command->options() & roInternal) == 0) {
 						if (from_command->address_range()) {
 							Data data;
-							data.PushByte(rand());
+							data.PushByte(Random());
 							command = AddCommand(data);
 							command->set_address_range(from_command->address_range());
 							gate_command = AddGate(next_command, next_command->address_range());
@@ -18735,7 +18859,7 @@ void IntelFunction::AfterCompile(const CompileContext &ctx)
 				AddressRange *range = info->item(j);
 				if (range_list.find(range) == range_list.end()) {
 					Data data;
-					data.PushByte(rand());
+					data.PushByte(Random());
 
 					CommandBlock *block = AddBlock(count(), true);
 					ICommand *command = AddCommand(data);
@@ -19189,7 +19313,7 @@ SectionCryptor::SectionCryptor(SectionCryptorList *owner, OperandSize cpu_addres
 		}
 	}
 	for (i = 0; i < registr_order_.size(); i++) {
-		std::swap(registr_order_[i], registr_order_[rand() % registr_order_.size()]);
+		std::swap(registr_order_[i], registr_order_[Random() % registr_order_.size()]);
 	}
 }
 
@@ -20204,6 +20328,71 @@ IntelFunction *IntelFunctionList::CreateFunction(OperandSize cpu_address_size)
 	return new IntelFunction(this, cpu_address_size);
 }
 
+/**
+ * Every function is read with the compiler functions known before the call, so the result doesn't
+ * depend on the order in which the workers take the functions. Compiler functions found on the way
+ * and messages are passed to the architecture in the order of function_list.
+ */
+void IntelFunctionList::ReadFunctions(const std::vector<IFunction *> &function_list, const std::vector<uint64_t> &address_list)
+{
+	size_t i, j;
+	std::vector<ArchitectureReader *> reader_list;
+
+	// every worker thread reads the image through its own reader
+	size_t thread_count = GetThreadCount(function_list.size());
+	for (i = 0; i < thread_count; i++) {
+		ArchitectureReader *reader = new ArchitectureReader(owner());
+		if (!reader->Open()) {
+			delete reader;
+			break;
+		}
+		reader_list.push_back(reader);
+	}
+
+	if (reader_list.empty()) {
+		BaseFunctionList::ReadFunctions(function_list, address_list);
+		return;
+	}
+
+	std::vector<std::vector<CompilerFunction *> > compiler_function_list(function_list.size());
+	std::vector<std::vector<NotifyMessage> > message_list(function_list.size());
+	try {
+		ParallelFor(function_list.size(), reader_list.size(), [&](size_t thread_index, size_t index) {
+			ArchitectureReader *reader = reader_list[thread_index];
+			function_list[index]->ReadFromFile(*reader, address_list[index]);
+			reader->TakeCompilerFunctions(compiler_function_list[index]);
+			reader->TakeMessages(message_list[index]);
+		});
+	} catch (...) {
+		for (i = 0; i < reader_list.size(); i++) {
+			delete reader_list[i];
+		}
+		for (i = 0; i < compiler_function_list.size(); i++) {
+			for (j = 0; j < compiler_function_list[i].size(); j++) {
+				delete compiler_function_list[i][j];
+			}
+		}
+		throw;
+	}
+	for (i = 0; i < reader_list.size(); i++) {
+		delete reader_list[i];
+	}
+
+	CompilerFunctionList *owner_compiler_function_list = owner()->compiler_function_list();
+	for (i = 0; i < function_list.size(); i++) {
+		for (j = 0; j < compiler_function_list[i].size(); j++) {
+			CompilerFunction *compiler_function = compiler_function_list[i][j];
+			if (!owner_compiler_function_list->GetFunctionByAddress(compiler_function->address()))
+				owner_compiler_function_list->AddObject(compiler_function->Clone(owner_compiler_function_list));
+			delete compiler_function;
+		}
+		for (j = 0; j < message_list[i].size(); j++) {
+			const NotifyMessage &message = message_list[i][j];
+			owner()->Notify(message.type, message.sender, message.message);
+		}
+	}
+}
+
 IntelFunction *IntelFunctionList::item(size_t index) const
 { 
 	return reinterpret_cast<IntelFunction *>(BaseFunctionList::item(index));
@@ -21135,14 +21324,14 @@ bool IntelImport::Init(const CompileContext &ctx)
 				is_mov_command = (ref_command->type() == cmMov && ref_command->operand(0).type == otRegistr && ref_command->operand(0).size == cpu_address_size());
 				ref_type = static_cast<IntelCommandType>(ref_command->type());
 				mov_registr = ref_command->operand(0).registr;
-				rand_registr = rand() % 8;
+				rand_registr = Random() % 8;
 				if (rand_registr == regESP)
 					rand_registr = regEAX;
 
 				c = ref_command->original_dump_size();
 				if (src_command == NULL && c > 5) {
 					IntelCommand *push_command;
-					switch (rand() % (is_mov_command ? 3 : 2)) {
+					switch (Random() % (is_mov_command ? 3 : 2)) {
 					case 2:
 						rand_type = cmPop;
 						AddCommand(cmXchg, IntelOperand(otMemory | otRegistr, cpu_address_size(), regESP), IntelOperand(otRegistr, cpu_address_size(), mov_registr));
@@ -21441,7 +21630,7 @@ bool IntelRuntimeCRCTable::Compile(const CompileContext &ctx)
 
 		size_t region_size, block_size;
 		for (region_size = region->size(); region_size != 0; region_size -= block_size, block_address += block_size) {
-			block_size = 0x1000 - (rand() & 0xff);
+			block_size = 0x1000 - (Random() & 0xff);
 			if (block_size > region_size)
 				block_size = region_size;
 
@@ -21450,14 +21639,14 @@ bool IntelRuntimeCRCTable::Compile(const CompileContext &ctx)
 	}
 
 	for (i = 0; i < region_info_list_.size(); i++) {
-		std::swap(region_info_list_[i], region_info_list_[rand() % region_info_list_.size()]);
+		std::swap(region_info_list_[i], region_info_list_[Random() % region_info_list_.size()]);
 	}
 
 	size_t self_crc_offset = 0;
 	size_t self_crc_size = 0;
 	for (i = 0; i < region_info_list_.size(); i++) {
 		self_crc_size += sizeof(CRCInfo::POD);
-		if (self_crc_size > 0x1000 && (rand() & 1)) {
+		if (self_crc_size > 0x1000 && (Random() & 1)) {
 			region_info_list_.insert(region_info_list_.begin() + i + 1, RegionInfo(self_crc_offset, (uint32_t)self_crc_size, true));
 			self_crc_offset += self_crc_size;
 			self_crc_size = 0;
@@ -21640,8 +21829,28 @@ bool IntelRuntimeData::Init(const CompileContext &ctx)
 				list[i]->WriteName(*this, index, data_key_);
 			}
 
+			// the image is read in the resource order, only the encryption is spread over the worker threads
+			std::vector<Data> data_list(list.size());
+			for (i = 0; i < list.size(); i++) {
+				list[i]->ReadData(*file, data_list[i]);
+			}
+			size_t thread_count = GetThreadCount(ctx.options.thread_count);
+			ParallelFor(data_list.size(), thread_count, [&](size_t, size_t index) {
+				Data &data = data_list[index];
+				if (data.size())
+					EncryptData(&data[0], data.size(), 0, data_key_);
+			});
+
+			// resources with the same content share one data block
+			std::vector<size_t> original_list = FindDuplicates(data_list, thread_count);
+			std::vector<ICommand *> data_command_list(list.size());
 			for (i = 0; i < list.size(); i++) {
-				list[i]->WriteData(*this, *file, data_key_);
+				if (original_list[i] == i) {
+					data_command_list[i] = list[i]->WriteData(*this, *file, data_list[i]);
+					data_list[i] = Data();
+				} else {
+					list[i]->WriteDataLink(*this, *file, data_command_list[original_list[i]]);
+				}
 			}
 		}
 	}
@@ -21687,11 +21896,7 @@ bool IntelRuntimeData::Init(const CompileContext &ctx)
 			folder_list[i]->WriteName(*this, image_base, data_key_);
 		}
 
-		for (i = 0; i < file_manager->count(); i++) {
-			InternalFile *internal_file = file_manager->item(i);
-			Notify(mtInformation, NULL, string_format("%s %s", language[lsLoading].c_str(), os::ExtractFileName(internal_file->absolute_file_name().c_str()).c_str()));
-			internal_file->WriteData(*this, image_base, data_key_);
-		}
+		file_manager->WriteData(*this, image_base, data_key_, GetThreadCount(ctx.options.thread_count));
 
 		file_manager->CloseFiles();
 	}
@@ -22293,7 +22498,7 @@ bool BaseIntelLoader::Compile(const CompileContext &ctx)
 	}
 
 	for (i = 0; i < block_list.size(); i++) {
-		std::swap(block_list[i], block_list[rand() % block_list.size()]);
+		std::swap(block_list[i], block_list[Random() % block_list.size()]);
 	}
 
 	if (ctx.file->runtime_function_list() && ctx.file->runtime_function_list()->count()) {
@@ -27729,7 +27934,7 @@ IntelVirtualMachine::IntelVirtualMachine(IntelVirtualMachineList *owner, Virtual
 	: BaseVirtualMachine(owner, id), type_(type), processor_(processor), entry_command_(NULL), init_command_(NULL), ext_jmp_command_(NULL), command_cryptor_(NULL),
 		stack_registr_(0), pcode_registr_(0), jmp_registr_(0), crypt_registr_(0)
 {
-	backward_direction_ = (rand() & 1) == 0;
+	backward_direction_ = (Random() & 1) == 0;
 }
 
 IntelVirtualMachine::~IntelVirtualMachine()
@@ -28681,7 +28886,7 @@ void IntelVirtualMachine::InitCommands(const CompileContext &ctx, const IntelOpc
 		}
 	}
 	for (i = 0; i < registr_order_.size(); i++) {
-		std::swap(registr_order_[i], registr_order_[rand() % registr_order_.size()]);
+		std::swap(registr_order_[i], registr_order_[Random() % registr_order_.size()]);
 	}
 
 	// create commands
@@ -30179,10 +30384,10 @@ void IntelVirtualMachine::InitCommands(const CompileContext &ctx, const IntelOpc
 	else {
 		c = opcode_list_.count();
 		for (i = 0; i < opcode_list_.count(); i++) {
-			opcode_list_.SwapObjects(i, rand() % c);
+			opcode_list_.SwapObjects(i, Random() % c);
 		}
 		for (i = opcode_list_.count(); i < 0x100; i++) {
-			opcode = opcode_list_.item(rand() % i);
+			opcode = opcode_list_.item(Random() % i);
 			opcode_list_.Add(opcode->command_type(), opcode->operand_type(), opcode->size(), opcode->value(), (opcode->command_type() == cmJmp) ? opcode->entry() : CloneHandler(opcode->entry()), opcode->value_cryptor(), opcode->end_cryptor());
 		}
 
@@ -31198,6 +31403,11 @@ IntelVMCommand *IntelVMCommand::Clone(IntelCommand *owner)
 	return vm_command;
 }
 
+IObject *IntelVMCommand::handler() const
+{
+	return opcode_;
+}
+
 void IntelVMCommand::WriteToFile(IArchitecture &file)
 {
 	if (!dump_.size())
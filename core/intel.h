@@ -462,6 +462,7 @@ public:
 	IntelOpcodeInfo *opcode() const { return opcode_; }
 	void set_opcode(IntelOpcodeInfo *opcode) { opcode_ = opcode; }
 	virtual bool is_end() const;
+	virtual IObject *handler() const;
 	bool is_data() const { return (command_type_ == cmDD || command_type_ == cmDQ); }
 	IFixup *fixup() const { return fixup_; }
 	void set_fixup(IFixup *fixup) { fixup_ = fixup; }
@@ -527,6 +528,35 @@ private:
 	IntelSegment base_segment_;
 };
 
+struct IntelFreeRegisters {
+	uint16_t registr[osQWord + 1]; // bit masks of registers that can be overwritten with osByte..osQWord size
+	uint16_t flags;
+	IntelFreeRegisters() : flags(0) { registr[osByte] = registr[osWord] = registr[osDWord] = registr[osQWord] = 0; }
+	bool empty() const { return registr[osByte] == 0; }
+	bool is_free(uint8_t reg, OperandSize size = osByte) const { return reg < 16 && size <= osQWord && (registr[size] & (1 << reg)) != 0; }
+	OperandSize size(uint8_t reg) const;
+	size_t count() const;
+	uint8_t item(size_t index) const;
+	void Add(uint8_t reg, OperandSize size);
+};
+
+struct IntelCommandTemplate {
+	// placeholders that Mutate replaces with random values
+	static const OperandSize osRandom = static_cast<OperandSize>(0x80);
+	static const OperandSize osRandomStartWord = static_cast<OperandSize>(0x81);
+	static const uint8_t regFree = 0x0f;
+	static const uint16_t flRandom = 0xff;
+
+	IntelCommandType type;
+	IntelOperand operand[3];
+	uint16_t flags;
+	bool need_free_registr;
+	uint16_t need_free_flags;
+	IntelFreeRegisters need_registers;
+	bool is_suitable(const IntelFreeRegisters &free_registers) const;
+	static void CreateCommands(OperandSize cpu_address_size, bool for_virtualization, std::vector<IntelCommand *> &command_list);
+};
+
 class EncodedData;
 
 class IntelCommand: public BaseCommand
@@ -757,6 +787,8 @@ public:
 	bool ParseScopeSEH(IArchitecture &file, uint64_t address, uint32_t table_count);
 	virtual IntelCommand *ParseCommand(IArchitecture &file, uint64_t address, bool dump_mode = false);
 	uint64_t ParseParam(IArchitecture &file, size_t index, uint64_t &param_reference);
+	void GetFreeRegisters(std::vector<IntelFreeRegisters> &free_registr_list) const;
+	static const std::vector<IntelCommandTemplate> &GetMutationTemplates(OperandSize cpu_address_size, bool for_virtualization);
 protected:
 	virtual IntelCommand *CreateCommand();
 	virtual IntelCommand *ParseString(IArchitecture &file, uint64_t address, size_t len);
@@ -781,7 +813,6 @@ private:
 
 	uint64_t GetRegistrValue(uint8_t reg, size_t end_index);
 	uint64_t GetRegistrMaxValue(uint8_t reg, size_t end_index, IArchitecture &file);
-	void GetFreeRegisters(size_t index, CommandInfoList &command_info_list) const;
 	void Mutate(const CompileContext &ctx, bool for_virtualization/*, int index = 0*/);
 
 	SectionCryptorList *section_cryptor_list_;
@@ -1057,6 +1088,7 @@ public:
 	IntelVirtualMachineProcessor *AddProcessor(OperandSize cpu_address_size);
 protected:
 	virtual IntelSDK *AddSDK(OperandSize cpu_address_size);
+	virtual void ReadFunctions(const std::vector<IFunction *> &function_list, const std::vector<uint64_t> &address_list);
 private:
 	IntelImport *AddImport(OperandSize cpu_address_size);
 	IntelRuntimeData *AddRuntimeData(OperandSize cpu_address_size);
@@ -1445,7 +1477,7 @@ public:
 			return regEmpty;
 		uint8_t res;
 		while (true) {
-			size_t i = rand() % size();
+			size_t i = Random() % size();
 			res = at(i);
 			if (no_solid && (res == regESI || res == regEDI || res == regEBP))
 				continue;
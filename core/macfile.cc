@@ -1936,7 +1936,19 @@ size_t MacImportList::WriteBindInfo(MacArchitecture &file)
 				dst->operand1++;
 				++src;
 			}
-			--src;
+			// the last pointer of the run joins it unless it has an immediate encoding
+			if ((src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB)
+					&& (src->operand1 > delta)
+					&& ((src->operand1 >= 15 * ptrsize) || (src->operand1 % ptrsize) != 0)) {
+				dst->operand1++;
+				++dst;
+				*dst = BindingInfo(BIND_OPCODE_ADD_ADDR_ULEB, src->operand1 - delta);
+			} else if ((src->opcode == BIND_OPCODE_DO_BIND)
+					&& ((src[1].opcode == BIND_OPCODE_DONE) || (src[1].opcode == BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB))) {
+				dst->operand1++;
+			} else {
+				--src;
+			}
 			++dst;
 		} else {
 			*dst++ = *src;
@@ -2115,7 +2127,21 @@ size_t MacImportList::WriteWeakBindInfo(MacArchitecture &file)
 				dst->operand1++;
 				++src;
 			}
-			--src;
+			// the last pointer of the run joins it unless it has an immediate encoding
+			if ( (src->opcode == BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB)
+					&& (src->operand1 > delta)
+					&& ((src->operand1 >= 15 * ptrsize) || (src->operand1 % ptrsize) != 0) ) {
+				dst->operand1++;
+				++dst;
+				*dst = BindingInfo(BIND_OPCODE_ADD_ADDR_ULEB, src->operand1 - delta);
+			}
+			else if ( (src->opcode == BIND_OPCODE_DO_BIND)
+					&& ((src[1].opcode == BIND_OPCODE_DONE) || (src[1].opcode == BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB)) ) {
+				dst->operand1++;
+			}
+			else {
+				--src;
+			}
 			++dst;
 		}
 		else {
@@ -2774,45 +2800,112 @@ void MacExportList::WriteToFile(MacArchitecture &file)
 		return;
 	}
 
-	size_t i, j;
-	MacExportNode root_node;
-	MacExportNode *node;
 	EncodedData data;
-	std::vector<MacExportNode *> stack;
+	WriteToData(data, file.segment_list()->GetBaseSegment()->address());
+	data.resize(AlignValue(data.size(), OperandSizeToValue(file.cpu_address_size())), 0);
 
+	dyld_info->export_size = static_cast<uint32_t>(data.size());
+	if (!dyld_info->export_size) {
+		dyld_info->export_off = 0;
+	} else {
+		dyld_info->export_off = static_cast<uint32_t>(file.Tell());
+		file.Write(data.data(), data.size());
+	}
+}
+
+void MacExportList::WriteToData(EncodedData &data, uint64_t base_address) const
+{
+	size_t i;
+	std::vector<std::pair<std::string, size_t> > names;
+	names.reserve(count());
 	for (i = 0; i < count(); i++) {
-		root_node.AddSymbol(item(i));
+		names.push_back(std::make_pair(item(i)->name(), i));
 	}
+	std::sort(names.begin(), names.end());
 
+	// build the trie in one pass over the sorted names, the stack holds the path of the previous name
+	MacExportNode root_node;
+	std::vector<MacExportNode *> stack;
 	stack.push_back(&root_node);
-	for (i = 0; i < stack.size(); i++) {
-		node = stack[i];
-		for (j = 0; j < node->count(); j++) {
-			stack.push_back(node->item(j));
+	const std::string *prev_name = NULL;
+	for (i = 0; i < names.size(); i++) {
+		const std::string &name = names[i].first;
+		size_t prefix = 0;
+		if (prev_name) {
+			size_t len = std::min(name.size(), prev_name->size());
+			while (prefix < len && name[prefix] == (*prev_name)[prefix]) {
+				prefix++;
+			}
 		}
+
+		MacExportNode *last = NULL;
+		while (stack.back()->depth() > prefix) {
+			last = stack.back();
+			stack.pop_back();
+		}
+		MacExportNode *node = stack.back();
+		if (node->depth() < prefix) {
+			// the name leaves the previous path in the middle of an edge
+			std::string label = last->label();
+			size_t split_pos = prefix - node->depth();
+			node = node->Add(label.substr(0, split_pos), prefix);
+			last->set_label(label.substr(split_pos));
+			last->set_owner(node);
+			stack.push_back(node);
+		}
+		if (name.size() > prefix) {
+			node = node->Add(name.substr(prefix), name.size());
+			stack.push_back(node);
+		} else if (node->symbol()) {
+			// duplicate name
+			continue;
+		}
+		node->set_symbol(item(names[i].second));
+		node->set_order(names[i].second);
+		prev_name = &name;
 	}
 
-	uint64_t base_address = file.segment_list()->GetBaseSegment()->address();
+	std::vector<MacExportNode *> node_list;
+	node_list.push_back(&root_node);
+	for (i = 0; i < node_list.size(); i++) {
+		MacExportNode *node = node_list[i];
+		for (size_t j = 0; j < node->count(); j++) {
+			node_list.push_back(node->item(j));
+		}
+	}
 
+	// ld64 adds the exports one by one in the list order, so every node keeps the position of the first export passing through it
+	for (i = node_list.size(); i > 1; i--) {
+		MacExportNode *node = node_list[i - 1];
+		MacExportNode *owner = node->owner();
+		if (owner->order() > node->order())
+			owner->set_order(node->order());
+	}
+	for (i = 0; i < node_list.size(); i++) {
+		node_list[i]->Sort();
+	}
+	std::sort(node_list.begin(), node_list.end(), [](const MacExportNode *left, const MacExportNode *right) {
+		if (left->order() != right->order())
+			return left->order() < right->order();
+		return left->depth() < right->depth();
+	});
+
+	for (i = 0; i < node_list.size(); i++) {
+		node_list[i]->Prepare(base_address);
+	}
+	// offsets only grow from pass to pass, so the loop stops once every uleb128 has reached its final width
 	bool more;
 	do {
 		more = false;
-		data.clear();
-		for (i = 0; i < stack.size(); i++) {
-			node = stack[i];
-			if (node->offset() != data.size())
+		uint32_t offset = 0;
+		for (i = 0; i < node_list.size(); i++) {
+			if (node_list[i]->UpdateOffset(offset))
 				more = true;
-			stack[i]->WriteToData(data, base_address);
 		}
 	} while (more);
-	data.resize(AlignValue(data.size(), OperandSizeToValue(file.cpu_address_size())), 0);
 
-	dyld_info->export_size = static_cast<uint32_t>(data.size());
-	if (!dyld_info->export_size) {
-		dyld_info->export_off = 0;
-	} else {
-		dyld_info->export_off = static_cast<uint32_t>(file.Tell());
-		file.Write(data.data(), data.size());
+	for (i = 0; i < node_list.size(); i++) {
+		node_list[i]->WriteToData(data);
 	}
 }
 
@@ -2859,14 +2952,18 @@ void MacExportList::ReadFromBuffer(Buffer &buffer, IArchitecture &file)
  * MacExportNode
  */
 
-MacExportNode::MacExportNode(MacExportNode *owner)
-	: ObjectList<MacExportNode>(), owner_(owner), symbol_(NULL), offset_(0)
+static size_t Uleb128Size(uint64_t value)
 {
-
+	size_t res = 1;
+	while (value >= 0x80) {
+		value >>= 7;
+		res++;
+	}
+	return res;
 }
 
-MacExportNode::MacExportNode(MacExportNode *owner, MacExport *symbol, const std::string &cummulative_string)
-	: ObjectList<MacExportNode>(), owner_(owner), symbol_(symbol), cummulative_string_(cummulative_string), offset_(0)
+MacExportNode::MacExportNode(MacExportNode *owner, const std::string &label, size_t depth)
+	: ObjectList<MacExportNode>(), owner_(owner), symbol_(NULL), label_(label), depth_(depth), order_(NOT_ID), size_(0), offset_(0)
 {
 
 }
@@ -2888,67 +2985,72 @@ void MacExportNode::set_owner(MacExportNode *owner)
 		owner_->AddObject(this);
 }
 
-MacExportNode *MacExportNode::Add(MacExport *symbol, const std::string &cummulative_string)
+MacExportNode *MacExportNode::Add(const std::string &label, size_t depth)
 {
-	MacExportNode *node = new MacExportNode(this, symbol, cummulative_string);
+	MacExportNode *node = new MacExportNode(this, label, depth);
 	AddObject(node);
 	return node;
 }
 
-void MacExportNode::AddSymbol(MacExport *symbol)
+int MacExportNode::CompareWith(const MacExportNode &obj) const
 {
-	std::string symbol_name = symbol->name();
-	const char *partial_str = symbol_name.c_str() + cummulative_string_.size();
-	for (size_t j = 0; j < count(); j++) {
-		MacExportNode *node = item(j);
-		std::string node_cummulative_string = node->cummulative_string();
-		const char *sub_string = node_cummulative_string.c_str() + cummulative_string_.size();
-		size_t sub_string_len = strlen(sub_string);
-		if (strncmp(sub_string, partial_str, sub_string_len) == 0) {
-			node->AddSymbol(symbol);
-			return;
-		} else for (size_t i = sub_string_len; i > 1; i--) {
-			if (strncmp(sub_string, partial_str, i - 1) == 0) {
-				MacExportNode *new_node = Add(NULL, node_cummulative_string.substr(0, cummulative_string_.size() + i - 1));
-				node->set_owner(new_node);
-				new_node->AddSymbol(symbol);
-				return;
-			}
-		}
-	}
-
-	Add(symbol, symbol->name());
+	if (order_ < obj.order_)
+		return -1;
+	if (order_ > obj.order_)
+		return 1;
+	return 0;
 }
 
-void MacExportNode::WriteToData(EncodedData &data, uint64_t base_address)
+void MacExportNode::Prepare(uint64_t base_address)
 {
-	size_t i;
-
-	offset_ = (uint32_t)data.size();
-	data.WriteByte(0);
+	terminal_.clear();
 	if (symbol_) {
-		size_t old_size = data.size();
+		EncodedData terminal;
 		if (symbol_->flags() & EXPORT_SYMBOL_FLAGS_REEXPORT) {
-			data.WriteUleb128(symbol_->flags());
-			data.WriteUleb128(symbol_->other());
-			data.WriteString(symbol_->forwarded_name());
+			terminal.WriteUleb128(symbol_->flags());
+			terminal.WriteUleb128(symbol_->other());
+			terminal.WriteString(symbol_->forwarded_name());
 		} else if (symbol_->flags() & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER) {
-			data.WriteUleb128(symbol_->flags());
-			data.WriteUleb128(symbol_->address() - base_address);
-			data.WriteUleb128(symbol_->other());
+			terminal.WriteUleb128(symbol_->flags());
+			terminal.WriteUleb128(symbol_->address() - base_address);
+			terminal.WriteUleb128(symbol_->other());
 		} else {
-			data.WriteUleb128(symbol_->flags());
-			data.WriteUleb128(symbol_->address() - base_address);
+			terminal.WriteUleb128(symbol_->flags());
+			terminal.WriteUleb128(symbol_->address() - base_address);
 		}
-		data[old_size - 1] = static_cast<uint8_t>(data.size() - old_size);
+		terminal_.assign(terminal.begin(), terminal.end());
+	}
+
+	// everything except the child offsets
+	size_ = Uleb128Size(terminal_.size()) + terminal_.size() + 1;
+	for (size_t i = 0; i < count(); i++) {
+		size_ += item(i)->label().size() + 1;
+	}
+}
+
+bool MacExportNode::UpdateOffset(uint32_t &offset)
+{
+	size_t size = size_;
+	for (size_t i = 0; i < count(); i++) {
+		size += Uleb128Size(item(i)->offset());
 	}
 
+	bool res = (offset_ != offset);
+	offset_ = offset;
+	offset += static_cast<uint32_t>(size);
+	return res;
+}
+
+void MacExportNode::WriteToData(EncodedData &data) const
+{
+	data.WriteUleb128(terminal_.size());
+	data.insert(data.end(), terminal_.begin(), terminal_.end());
 	// write number of children
 	data.push_back(static_cast<uint8_t>(count()));
 	// write each child
-	for (i = 0; i < count(); i++) {
+	for (size_t i = 0; i < count(); i++) {
 		MacExportNode *child = item(i);
-		data.WriteString(child->cummulative_string().substr(cummulative_string().size()));
+		data.WriteString(child->label());
 		data.WriteUleb128(child->offset());
 	}
 }
@@ -3140,7 +3242,7 @@ void MacFixupList::ReadRebaseInfo(MacArchitecture &file, uint32_t rebase_off, ui
 	uint8_t bind_type = 0;
 	uint64_t address, segment_end;
 	uint32_t count;
-	uint32_t skip;
+	uint64_t skip;
 	uint8_t immediate;
 	uint8_t opcode;
 	EncodedData buf;
@@ -3214,7 +3316,7 @@ void MacFixupList::ReadRebaseInfo(MacArchitecture &file, uint32_t rebase_off, ui
 			break;
 		case REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB:
 			count = static_cast<uint32_t>(buf.ReadUleb128(&pos));
-			skip = static_cast<uint32_t>(buf.ReadUleb128(&pos));
+			skip = buf.ReadUleb128(&pos);
 			for (i = 0; i < count; i++) {
 				if (address >= segment_end) 
 					throw std::runtime_error("Invalid rebase address");
@@ -3357,7 +3459,7 @@ size_t MacFixupList::WriteRebaseInfo(MacArchitecture &file)
 			bind_type = fixup->bind_type();
 		}
 		if (address != fixup->address()) {
-			if (!segment || (fixup->address() < segment->address()) || (fixup->address() >= segment->address() + segment->size())) {
+			if (!segment || (fixup->address() < segment->address()) || (fixup->address() >= segment->address() + segment->size()) || fixup->address() < address) {
 				segment = file.segment_list()->GetSectionByAddress(fixup->address());
 				if (!segment)
 					throw std::runtime_error("binding address outside range of any segment");
@@ -3415,10 +3517,9 @@ size_t MacFixupList::WriteRebaseInfo(MacArchitecture &file)
 		uint64_t delta = src->operand1;
 		if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB) 
 				&& (src[1].opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB) 
-				&& (src[2].opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB) 
-				&& (src[1].operand1 == delta) 
-				&& (src[2].operand1 == delta) ) {
-			// found at least three in a row, this is worth compressing
+				&& (src[1].operand1 == delta) ) {
+			// found at least two in a row, this is worth compressing because
+			// REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB has no immediate encoding
 			dst->opcode = REBASE_OPCODE_DO_REBASE_ULEB_TIMES_SKIPPING_ULEB;
 			dst->operand1 = 1;
 			dst->operand2 = delta;
@@ -3428,7 +3529,21 @@ size_t MacFixupList::WriteRebaseInfo(MacArchitecture &file)
 				dst->operand1++;
 				++src;
 			}
-			--src;
+			// the last pointer of the run joins it, the rest of its gap becomes a separate add
+			if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ADD_ADDR_ULEB)
+					&& (src->operand1 > delta) ) {
+				dst->operand1++;
+				++dst;
+				*dst = RebaseInfo(REBASE_OPCODE_ADD_ADDR_ULEB, src->operand1 - delta);
+			}
+			else if ( (src->opcode == REBASE_OPCODE_DO_REBASE_ULEB_TIMES)
+					&& (src->operand1 == 1)
+					&& ((src[1].opcode == REBASE_OPCODE_DONE) || (src[1].opcode == REBASE_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB)) ) {
+				dst->operand1++;
+			}
+			else {
+				--src;
+			}
 			++dst;
 		}
 		else {
@@ -5405,55 +5520,93 @@ OpenStatus MacArchitecture::ReadFromFile(uint32_t mode)
 	}
 
 	if ((mode & foHeaderOnly) == 0) {
-		if (!owner()->file_name().empty()) {
-			MapFile map_file;
-			std::vector<uint64_t> segments;
-			for (size_t i = 0; i < segment_list()->count(); i++) {
-				segments.push_back(segment_list()->item(i)->address());
+		std::auto_ptr<AnalysisCache> cache;
+		bool is_cached = false;
+		if (mode & foUseCache) {
+			cache.reset(new AnalysisCache(this, std::vector<std::string>(1, map_file_name())));
+			is_cached = cache->Load();
+		}
+
+		if (!is_cached) {
+			if (!owner()->file_name().empty()) {
+				MapFile map_file;
+				std::vector<uint64_t> segments;
+				for (size_t i = 0; i < segment_list()->count(); i++) {
+					segments.push_back(segment_list()->item(i)->address());
+				}
+				if (std::find(segments.begin(), segments.end(), 0) == segments.end())
+					segments.insert(segments.begin(), 0);
+				if (map_file.Parse(map_file_name().c_str(), segments))
+					ReadMapFile(map_file);
 			}
-			if (std::find(segments.begin(), segments.end(), 0) == segments.end())
-				segments.insert(segments.begin(), 0);
-			if (map_file.Parse(map_file_name().c_str(), segments))
-				ReadMapFile(map_file);
-		}
 
-		map_function_list()->ReadFromFile(*this);
+			map_function_list()->ReadFromFile(*this);
 
-		for (i = 0; i < indirect_symbol_list_->count(); i++) {
-			MacIndirectSymbol *indirect_symbol = indirect_symbol_list_->item(i);
-			MacSymbol *symbol = indirect_symbol->symbol();
-			if (!symbol || (symbol->type() & (N_STAB | N_TYPE)) != N_UNDF)
-				continue;
+			std::vector<std::string> symbol_names;
+			std::vector<size_t> indirect_name_index_list(indirect_symbol_list_->count(), NOT_ID);
+			for (i = 0; i < indirect_symbol_list_->count(); i++) {
+				MacIndirectSymbol *indirect_symbol = indirect_symbol_list_->item(i);
+				MacSymbol *symbol = indirect_symbol->symbol();
+				if (!symbol || (symbol->type() & (N_STAB | N_TYPE)) != N_UNDF)
+					continue;
 
-			MacSection *section = section_list_->GetSectionByAddress(indirect_symbol->address());
-			if (section->type() != S_SYMBOL_STUBS)
-				continue;
+				MacSection *section = section_list_->GetSectionByAddress(indirect_symbol->address());
+				if (section && section->type() == S_SYMBOL_STUBS && !map_function_list()->GetFunctionByAddress(indirect_symbol->address())) {
+					indirect_name_index_list[i] = symbol_names.size();
+					symbol_names.push_back(symbol->name());
+				}
+			}
+			std::vector<size_t> name_index_list(symbol_list_->count(), NOT_ID);
+			for (i = 0; i < symbol_list_->count() - 1; i++) {
+				MacSymbol *symbol = symbol_list_->item(i);
+				if ((symbol->type() & (N_STAB | N_TYPE)) != N_SECT || symbol->name().empty())
+					continue;
 
-			MapFunction *map_function = map_function_list()->GetFunctionByAddress(indirect_symbol->address());
-			if (!map_function)
-				map_function_list()->Add(indirect_symbol->address(), 0, segment_list_->GetMemoryTypeByAddress(indirect_symbol->address()) & mtExecutable ? otCode : otData, DemangleName(symbol->name()));
-		}
+				if (segment_list_->GetMemoryTypeByAddress(symbol->value()) != mtNone && !map_function_list()->GetFunctionByAddress(symbol->value())) {
+					name_index_list[i] = symbol_names.size();
+					symbol_names.push_back(symbol->name());
+				}
+			}
+			std::vector<FunctionName> demangled_names = DemangleNames(symbol_names);
 
-		for (i = 0; i < symbol_list_->count() - 1; i++) {
-			MacSymbol *symbol = symbol_list_->item(i);
-			if ((symbol->type() & (N_STAB | N_TYPE)) != N_SECT || symbol->name().empty())
-				continue;
+			for (i = 0; i < indirect_symbol_list_->count(); i++) {
+				MacIndirectSymbol *indirect_symbol = indirect_symbol_list_->item(i);
+				MacSymbol *symbol = indirect_symbol->symbol();
+				if (!symbol || (symbol->type() & (N_STAB | N_TYPE)) != N_UNDF)
+					continue;
 
-			uint32_t memory_type = segment_list_->GetMemoryTypeByAddress(symbol->value());
-			if (memory_type == mtNone)
-				continue;
+				MacSection *section = section_list_->GetSectionByAddress(indirect_symbol->address());
+				if (section->type() != S_SYMBOL_STUBS)
+					continue;
 
-			MapFunction *map_function = map_function_list()->GetFunctionByAddress(symbol->value());
-			if (!map_function)
-				map_function = map_function_list()->Add(symbol->value(), 0, otUnknown, DemangleName(symbol->name()));
+				MapFunction *map_function = map_function_list()->GetFunctionByAddress(indirect_symbol->address());
+				if (!map_function)
+					map_function_list()->Add(indirect_symbol->address(), 0, segment_list_->GetMemoryTypeByAddress(indirect_symbol->address()) & mtExecutable ? otCode : otData,
+						(indirect_name_index_list[i] == NOT_ID) ? DemangleName(symbol->name()) : demangled_names[indirect_name_index_list[i]]);
+			}
 
-			ObjectType type = otData;
-			if (memory_type & mtExecutable) {
-				MacSection *section = section_list_->GetSectionByAddress(symbol->value());
-				if (!section || section->name() != "__const")
-					type = (symbol->type() & N_EXT) ? otExport : otCode;
+			for (i = 0; i < symbol_list_->count() - 1; i++) {
+				MacSymbol *symbol = symbol_list_->item(i);
+				if ((symbol->type() & (N_STAB | N_TYPE)) != N_SECT || symbol->name().empty())
+					continue;
+
+				uint32_t memory_type = segment_list_->GetMemoryTypeByAddress(symbol->value());
+				if (memory_type == mtNone)
+					continue;
+
+				MapFunction *map_function = map_function_list()->GetFunctionByAddress(symbol->value());
+				if (!map_function)
+					map_function = map_function_list()->Add(symbol->value(), 0, otUnknown,
+						(name_index_list[i] == NOT_ID) ? DemangleName(symbol->name()) : demangled_names[name_index_list[i]]);
+
+				ObjectType type = otData;
+				if (memory_type & mtExecutable) {
+					MacSection *section = section_list_->GetSectionByAddress(symbol->value());
+					if (!section || section->name() != "__const")
+						type = (symbol->type() & N_EXT) ? otExport : otCode;
+				}
+				map_function->set_type(type);
 			}
-			map_function->set_type(type);
 		}
 
 		switch (cpu_type_) {
@@ -5461,9 +5614,11 @@ OpenStatus MacArchitecture::ReadFromFile(uint32_t mode)
 		case CPU_TYPE_X86_64:
 			function_list_ = new MacIntelFunctionList(this);
 			virtual_machine_list_ = new IntelVirtualMachineList();
-			{
+			if (!is_cached) {
 				IntelFileHelper helper;
 				helper.Parse(*this);
+				if (cache.get())
+					cache->Save();
 			}
 			break;
 		default:
@@ -5657,7 +5812,7 @@ void MacArchitecture::Save(CompileContext &ctx)
 				continue;
 
 			for (j = 0; j < region->size(); j++) {
-				b = (region->type() & mtReadable) ? rand() : 0xcc;
+				b = (region->type() & mtReadable) ? Random() : 0xcc;
 				Write(&b, sizeof(b));
 			}
 		}
@@ -474,12 +474,13 @@ public:
 	void ReadFromFile(MacArchitecture &file);
 	void Pack();
 	void WriteToFile(MacArchitecture &file);
+	void WriteToData(EncodedData &data, uint64_t base_address) const;
 	virtual void ReadFromBuffer(Buffer &buffer, IArchitecture &file);
 	MacExport *GetExportByAddress(uint64_t address) const;
+	MacExport *Add(uint64_t address, const std::string &name, uint64_t flags, uint64_t other);
 protected:
 	virtual MacExport *Add(uint64_t address) { return Add(address, std::string(), 0, 0); }
 private:
-	MacExport *Add(uint64_t address, const std::string &name, uint64_t flags, uint64_t other);
 	MacExport *Add(MacSymbol *symbol);
 	void ParseExportNode(const EncodedData &buf, size_t pos, const std::string &name, uint64_t base_address);
 
@@ -489,20 +490,32 @@ private:
 class MacExportNode : public ObjectList<MacExportNode>
 {
 public:
-	explicit MacExportNode(MacExportNode *owner = NULL);
-	explicit MacExportNode(MacExportNode *owner, MacExport *symbol, const std::string &cummulative_string_);
+	explicit MacExportNode(MacExportNode *owner = NULL, const std::string &label = std::string(), size_t depth = 0);
 	~MacExportNode();
+	MacExportNode *owner() const { return owner_; }
 	void set_owner(MacExportNode *owner);
-	void AddSymbol(MacExport *symbol);
-	std::string cummulative_string() const { return cummulative_string_; }
-	void WriteToData(EncodedData &data, uint64_t base_address);
-	uint32_t offset() const { return offset_; } 
+	MacExportNode *Add(const std::string &label, size_t depth);
+	std::string label() const { return label_; }
+	void set_label(const std::string &label) { label_ = label; }
+	size_t depth() const { return depth_; }
+	MacExport *symbol() const { return symbol_; }
+	void set_symbol(MacExport *symbol) { symbol_ = symbol; }
+	size_t order() const { return order_; }
+	void set_order(size_t order) { order_ = order; }
+	uint32_t offset() const { return offset_; }
+	void Prepare(uint64_t base_address);
+	bool UpdateOffset(uint32_t &offset);
+	void WriteToData(EncodedData &data) const;
+	using IObject::CompareWith;
+	int CompareWith(const MacExportNode &obj) const;
 private:
-	MacExportNode *Add(MacExport *symbol, const std::string &cummulative_string_);
-
 	MacExportNode *owner_;
 	MacExport *symbol_;
-	std::string cummulative_string_;
+	std::string label_;
+	size_t depth_;
+	size_t order_;
+	std::vector<uint8_t> terminal_;
+	size_t size_;
 	uint32_t offset_;
 };
 
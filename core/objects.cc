@@ -31,9 +31,515 @@ std::string string_format(const char *format, ...)
 	return res;
 }
 
+std::string JSONString(const std::string &value)
+{
+	std::string res = "\"";
+	for (size_t i = 0; i < value.size(); i++) {
+		char c = value[i];
+		switch (c) {
+		case '"':
+			res += "\\\"";
+			break;
+		case '\\':
+			res += "\\\\";
+			break;
+		case '\n':
+			res += "\\n";
+			break;
+		case '\r':
+			res += "\\r";
+			break;
+		case '\t':
+			res += "\\t";
+			break;
+		default:
+			if (static_cast<uint8_t>(c) < 0x20)
+				res += string_format("\\u%.4x", static_cast<uint8_t>(c));
+			else
+				res += c;
+			break;
+		}
+	}
+	res += "\"";
+	return res;
+}
+
 int AddressableObject::CompareWith(const AddressableObject &other) const
 {
 	if (address_ > other.address_) return 1;
 	if (address_ < other.address_) return -1;
 	return 0;
 }
+
+size_t GetThreadCount(size_t max_count)
+{
+	size_t res = std::thread::hardware_concurrency();
+	if (!res)
+		res = 1;
+	if (max_count && res > max_count)
+		res = max_count;
+	return res;
+}
+
+/**
+ * Calls func for every index from [0, count) on thread_count worker threads. Indexes are handed out
+ * in ascending order, thread_index allows callers to keep per-thread state. The first exception
+ * thrown by a worker is rethrown in the calling thread after all workers are finished.
+ */
+void ParallelFor(size_t count, size_t thread_count, const std::function<void(size_t thread_index, size_t index)> &func)
+{
+	if (thread_count > count)
+		thread_count = count;
+	if (thread_count < 2) {
+		for (size_t i = 0; i < count; i++) {
+			func(0, i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next_index(0);
+	std::atomic<bool> is_failed(false);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+	std::vector<std::thread> thread_list;
+
+	auto worker = [&](size_t thread_index) {
+		for (;;) {
+			size_t index = next_index++;
+			if (index >= count || is_failed)
+				break;
+			try {
+				func(thread_index, index);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error)
+					error = std::current_exception();
+				is_failed = true;
+			}
+		}
+	};
+
+	thread_list.reserve(thread_count - 1);
+	for (size_t i = 1; i < thread_count; i++) {
+		thread_list.push_back(std::thread(worker, i));
+	}
+	worker(0);
+	for (size_t i = 0; i < thread_list.size(); i++) {
+		thread_list[i].join();
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+// every thread has its own sequence, so concurrent compilations of the batch mode don't take values from each other
+static thread_local uint64_t random_state = 1;
+
+void SetRandomSeed(uint32_t seed)
+{
+	random_state = seed;
+}
+
+int Random()
+{
+	random_state = random_state * 6364136223846793005ull + 1442695040888963407ull;
+	return static_cast<int>(random_state >> 33);
+}
+
+/**
+ * SearchIndex
+ */
+
+static inline char SearchToLower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * Splits a wildcard pattern into runs of literal characters. Wildcards, character sets and non-ASCII
+ * characters (whose case folding isn't handled here) end a run, so every text matched by the pattern
+ * contains all runs.
+ */
+static std::vector<std::string> SearchPatternRuns(const std::string &pattern)
+{
+	std::vector<std::string> res;
+	std::string run;
+	bool in_set = false;
+	for (size_t i = 0; i <= pattern.size(); i++) {
+		char c = (i < pattern.size()) ? pattern[i] : 0;
+		bool is_literal = false;
+		if (in_set) {
+			if (c == ']')
+				in_set = false;
+		} else if (c == '[') {
+			in_set = true;
+		} else {
+			is_literal = (c != 0 && static_cast<uint8_t>(c) < 0x80 && c != '*' && c != '?' && c != '\\' && c != ']');
+		}
+		if (is_literal) {
+			run.push_back(SearchToLower(c));
+		} else if (!run.empty()) {
+			res.push_back(run);
+			run.clear();
+		}
+	}
+	return res;
+}
+
+static inline uint32_t SearchTrigram(const char *p)
+{
+	return static_cast<uint8_t>(p[0]) | (static_cast<uint8_t>(p[1]) << 8) | (static_cast<uint8_t>(p[2]) << 16);
+}
+
+SearchIndex::SearchIndex()
+	: garbage_count_(0)
+{
+
+}
+
+void SearchIndex::clear()
+{
+	item_list_.clear();
+	item_map_.clear();
+	trigram_map_.clear();
+	garbage_count_ = 0;
+}
+
+void SearchIndex::AddTrigrams(uint32_t index)
+{
+	const std::string &text = item_list_[index].text;
+	for (size_t i = 0; i + 3 <= text.size(); i++) {
+		std::vector<uint32_t> &list = trigram_map_[SearchTrigram(&text[i])];
+		// a trigram repeated in the same text is stored once
+		if (list.empty() || list.back() != index)
+			list.push_back(index);
+	}
+}
+
+/**
+ * Adds the item or replaces the text of an already added one. Items keep the order in which they were
+ * added first, Find returns them in this order.
+ */
+void SearchIndex::Add(const void *item, const std::string &text)
+{
+	std::string lower_text(text);
+	for (size_t i = 0; i < lower_text.size(); i++) {
+		lower_text[i] = SearchToLower(lower_text[i]);
+	}
+
+	uint32_t index;
+	std::unordered_map<const void *, uint32_t>::const_iterator it = item_map_.find(item);
+	if (it != item_map_.end()) {
+		index = it->second;
+		if (item_list_[index].text == lower_text)
+			return;
+		// lists of the old trigrams are cleaned by Pack, Find checks the current text anyway
+		garbage_count_++;
+	} else {
+		if (item_list_.size() >= UINT32_MAX)
+			throw std::runtime_error("Runtime error at Add");
+		index = static_cast<uint32_t>(item_list_.size());
+		Item new_item;
+		new_item.item = item;
+		item_list_.push_back(new_item);
+		item_map_[item] = index;
+	}
+	item_list_[index].text.swap(lower_text);
+	AddTrigrams(index);
+
+	if (garbage_count_ > item_map_.size())
+		Pack();
+}
+
+void SearchIndex::Remove(const void *item)
+{
+	std::unordered_map<const void *, uint32_t>::iterator it = item_map_.find(item);
+	if (it == item_map_.end())
+		return;
+
+	Item &removed = item_list_[it->second];
+	removed.item = NULL;
+	removed.text.clear();
+	item_map_.erase(it);
+	garbage_count_++;
+
+	if (garbage_count_ > item_map_.size())
+		Pack();
+}
+
+/**
+ * Drops removed items and rebuilds the trigram lists.
+ */
+void SearchIndex::Pack()
+{
+	std::vector<Item> item_list;
+	item_list.reserve(item_map_.size());
+	for (size_t i = 0; i < item_list_.size(); i++) {
+		Item &item = item_list_[i];
+		if (!item.item)
+			continue;
+		item_map_[item.item] = static_cast<uint32_t>(item_list.size());
+		item_list.push_back(Item());
+		item_list.back().item = item.item;
+		item_list.back().text.swap(item.text);
+	}
+	item_list_.swap(item_list);
+	trigram_map_.clear();
+	for (size_t i = 0; i < item_list_.size(); i++) {
+		AddTrigrams(static_cast<uint32_t>(i));
+	}
+	garbage_count_ = 0;
+}
+
+/**
+ * Returns items whose text contains every literal run of the wildcard pattern, ignoring the case of
+ * ASCII letters. The result is a superset of the items matched by the pattern itself, callers check
+ * the pattern on the returned items only. Candidates are taken from the shortest list of the pattern
+ * trigrams; patterns without trigrams check all items.
+ */
+std::vector<const void *> SearchIndex::Find(const std::string &pattern) const
+{
+	std::vector<std::string> run_list = SearchPatternRuns(pattern);
+
+	const std::vector<uint32_t> *candidate_list = NULL;
+	for (size_t i = 0; i < run_list.size(); i++) {
+		const std::string &run = run_list[i];
+		for (size_t j = 0; j + 3 <= run.size(); j++) {
+			std::unordered_map<uint32_t, std::vector<uint32_t> >::const_iterator it = trigram_map_.find(SearchTrigram(&run[j]));
+			if (it == trigram_map_.end())
+				return std::vector<const void *>();
+			if (!candidate_list || it->second.size() < candidate_list->size())
+				candidate_list = &it->second;
+		}
+	}
+
+	std::vector<uint32_t> index_list;
+	if (candidate_list) {
+		index_list = *candidate_list;
+		if (garbage_count_) {
+			// replaced texts leave indexes out of order
+			std::sort(index_list.begin(), index_list.end());
+			index_list.erase(std::unique(index_list.begin(), index_list.end()), index_list.end());
+		}
+	} else {
+		index_list.resize(item_list_.size());
+		for (size_t i = 0; i < index_list.size(); i++) {
+			index_list[i] = static_cast<uint32_t>(i);
+		}
+	}
+
+	std::vector<const void *> res;
+	for (size_t i = 0; i < index_list.size(); i++) {
+		const Item &item = item_list_[index_list[i]];
+		if (!item.item)
+			continue;
+		bool is_matched = true;
+		for (size_t j = 0; j < run_list.size(); j++) {
+			if (item.text.find(run_list[j]) == std::string::npos) {
+				is_matched = false;
+				break;
+			}
+		}
+		if (is_matched)
+			res.push_back(item.item);
+	}
+	return res;
+}
+
+/**
+ * Tracer
+ */
+
+struct TraceEvent {
+	const char *name;
+	size_t thread_id;
+	uint64_t start_time;
+	uint64_t duration;
+	uint64_t allocation_count;
+	uint64_t allocation_size;
+};
+
+static std::atomic<bool> trace_enabled(false);
+static std::mutex trace_mutex;
+static std::vector<TraceEvent> trace_event_list;
+static std::chrono::steady_clock::time_point trace_start_time;
+static std::atomic<size_t> trace_thread_count(0);
+static thread_local size_t trace_thread_id = 0;
+static thread_local uint64_t trace_allocation_count = 0;
+static thread_local uint64_t trace_allocation_size = 0;
+
+void Tracer::set_enabled(bool value)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (value && !trace_enabled) {
+		trace_event_list.clear();
+		trace_start_time = std::chrono::steady_clock::now();
+	}
+	trace_enabled = value;
+}
+
+bool Tracer::enabled()
+{
+	return trace_enabled;
+}
+
+void Tracer::AddAllocation(size_t size)
+{
+	// counters are kept per thread so scopes of concurrent compilations don't see each other's allocations
+	if (trace_enabled.load(std::memory_order_relaxed)) {
+		trace_allocation_count++;
+		trace_allocation_size += size;
+	}
+}
+
+/**
+ * Allocate/Free implement the global operator new/delete of the console version,
+ * allocations are counted only while tracing is enabled.
+ */
+void *Tracer::Allocate(size_t size)
+{
+	AddAllocation(size);
+	if (!size)
+		size = 1;
+	for (;;) {
+		void *res = malloc(size);
+		if (res)
+			return res;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void *Tracer::Allocate(size_t size, const std::nothrow_t &) noexcept
+{
+	try {
+		return Allocate(size);
+	} catch (std::bad_alloc &) {
+		return NULL;
+	}
+}
+
+void Tracer::Free(void *p) noexcept
+{
+	free(p);
+}
+
+#ifdef __cpp_aligned_new
+void *Tracer::Allocate(size_t size, std::align_val_t alignment)
+{
+	AddAllocation(size);
+	if (!size)
+		size = 1;
+	size_t align = std::max(static_cast<size_t>(alignment), sizeof(void *));
+	for (;;) {
+#ifdef VMP_GNU
+		void *res;
+		if (posix_memalign(&res, align, size))
+			res = NULL;
+#else
+		void *res = _aligned_malloc(size, align);
+#endif
+		if (res)
+			return res;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void *Tracer::Allocate(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+	try {
+		return Allocate(size, alignment);
+	} catch (std::bad_alloc &) {
+		return NULL;
+	}
+}
+
+void Tracer::Free(void *p, std::align_val_t /*alignment*/) noexcept
+{
+#ifdef VMP_GNU
+	free(p);
+#else
+	_aligned_free(p);
+#endif
+}
+#endif
+
+void Tracer::GetAllocations(uint64_t &count, uint64_t &size)
+{
+	count = trace_allocation_count;
+	size = trace_allocation_size;
+}
+
+uint64_t Tracer::GetTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trace_start_time).count();
+}
+
+void Tracer::AddEvent(const char *name, uint64_t start_time, uint64_t allocation_count, uint64_t allocation_size)
+{
+	if (!trace_thread_id)
+		trace_thread_id = ++trace_thread_count;
+
+	TraceEvent event;
+	event.name = name;
+	event.thread_id = trace_thread_id;
+	event.start_time = start_time;
+	event.duration = GetTime() - start_time;
+	event.allocation_count = allocation_count;
+	event.allocation_size = allocation_size;
+
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (trace_enabled)
+		trace_event_list.push_back(event);
+}
+
+/**
+ * Returns collected events in the Chrome trace event format (chrome://tracing, Perfetto).
+ */
+std::string Tracer::ToJSON()
+{
+	std::string res = "{\"traceEvents\": [";
+	{
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		for (size_t i = 0; i < trace_event_list.size(); i++) {
+			const TraceEvent &event = trace_event_list[i];
+			res += (i ? ",\n" : "\n");
+			res += string_format("{\"name\": %s, \"cat\": \"compile\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %llu, \"dur\": %llu, \"args\": {\"allocations\": %llu, \"allocated_bytes\": %llu}}",
+				JSONString(event.name).c_str(),
+				static_cast<uint32_t>(event.thread_id),
+				static_cast<unsigned long long>(event.start_time),
+				static_cast<unsigned long long>(event.duration),
+				static_cast<unsigned long long>(event.allocation_count),
+				static_cast<unsigned long long>(event.allocation_size));
+		}
+	}
+	res += "\n], \"displayTimeUnit\": \"ms\"}\n";
+	return res;
+}
+
+/**
+ * TraceScope
+ */
+
+TraceScope::TraceScope(const char *name)
+	: name_(name), enabled_(Tracer::enabled()), start_time_(0), allocation_count_(0), allocation_size_(0)
+{
+	if (enabled_) {
+		Tracer::GetAllocations(allocation_count_, allocation_size_);
+		start_time_ = Tracer::GetTime();
+	}
+}
+
+TraceScope::~TraceScope()
+{
+	if (enabled_) {
+		uint64_t allocation_count, allocation_size;
+		Tracer::GetAllocations(allocation_count, allocation_size);
+		Tracer::AddEvent(name_, start_time_, allocation_count - allocation_count_, allocation_size - allocation_size_);
+	}
+}
@@ -6,6 +6,7 @@
 #define OBJECTS_H
 
 std::string string_format(const char *format, ...);
+std::string JSONString(const std::string &value);
 
 // TODO: find more appropriate place for {
 enum OperandSize : uint8_t {
@@ -144,6 +145,7 @@ public:
 	void PushQWord(uint64_t value) { PushBuff(&value, sizeof(value)); }
 	void PushWord(uint16_t value) { PushBuff(&value, sizeof(value)); }
 	void PushBuff(const void *value, size_t nCount)	{ m_vData.insert(m_vData.end(), reinterpret_cast<const uint8_t *>(value), reinterpret_cast<const uint8_t *>(value) + nCount); }
+	void PushString(const std::string &value) { PushDWord(static_cast<uint32_t>(value.size())); PushBuff(value.c_str(), value.size()); }
 	void InsertByte(size_t pos, uint8_t value) { m_vData.insert(m_vData.begin() + pos, value); }
 	void InsertBuff(size_t pos, const void *buff, size_t nCount) { m_vData.insert(m_vData.begin() + pos, reinterpret_cast<const uint8_t *>(buff), reinterpret_cast<const uint8_t *>(buff) + nCount); }
 	uint32_t ReadDWord(size_t nPosition) const { return *reinterpret_cast<const uint32_t *>(&m_vData[nPosition]); }
@@ -153,6 +155,7 @@ public:
 	bool empty() const { return m_vData.empty(); }
 	void resize(size_t size) { m_vData.resize(size); }
 	void resize(size_t size, uint8_t value) { m_vData.resize(size, value); }
+	void swap(Data &src) { m_vData.swap(src.m_vData); }
 	const uint8_t *data() const { return m_vData.data(); }
 	const uint8_t &operator[](size_t pos) const
 	{ 
@@ -188,4 +191,69 @@ public:
 		: runtime_error(message) {}
 };
 
+size_t GetThreadCount(size_t max_count = 0);
+void ParallelFor(size_t count, size_t thread_count, const std::function<void(size_t thread_index, size_t index)> &func);
+void SetRandomSeed(uint32_t seed);
+int Random();
+
+class SearchIndex
+{
+public:
+	SearchIndex();
+	void Add(const void *item, const std::string &text);
+	void Remove(const void *item);
+	void clear();
+	size_t count() const { return item_map_.size(); }
+	bool contains(const void *item) const { return item_map_.find(item) != item_map_.end(); }
+	std::vector<const void *> Find(const std::string &pattern) const;
+private:
+	struct Item {
+		const void *item;
+		std::string text;
+	};
+	void Pack();
+	void AddTrigrams(uint32_t index);
+	std::vector<Item> item_list_;
+	std::unordered_map<const void *, uint32_t> item_map_;
+	std::unordered_map<uint32_t, std::vector<uint32_t> > trigram_map_;
+	size_t garbage_count_;
+};
+
+class Tracer
+{
+public:
+	static void set_enabled(bool value);
+	static bool enabled();
+	static void AddAllocation(size_t size);
+	static void *Allocate(size_t size);
+	static void *Allocate(size_t size, const std::nothrow_t &) noexcept;
+	static void Free(void *p) noexcept;
+#ifdef __cpp_aligned_new
+	static void *Allocate(size_t size, std::align_val_t alignment);
+	static void *Allocate(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept;
+	static void Free(void *p, std::align_val_t alignment) noexcept;
+#endif
+	static void AddEvent(const char *name, uint64_t start_time, uint64_t allocation_count, uint64_t allocation_size);
+	static void GetAllocations(uint64_t &count, uint64_t &size);
+	static uint64_t GetTime();
+	static std::string ToJSON();
+};
+
+class TraceScope
+{
+public:
+	explicit TraceScope(const char *name);
+	~TraceScope();
+private:
+	const char *name_;
+	bool enabled_;
+	uint64_t start_time_;
+	uint64_t allocation_count_;
+	uint64_t allocation_size_;
+
+	// no copy ctr or assignment op
+	TraceScope(const TraceScope &);
+	TraceScope &operator =(const TraceScope &);
+};
+
 #endif
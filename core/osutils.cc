@@ -9,6 +9,10 @@
 #include <dlfcn.h>
 #include <sys/time.h>
 #include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <limits.h>
 #include <langinfo.h>
 #include <pwd.h>
 #else
@@ -386,26 +390,81 @@ bool FileCopy(const char *src, const char *dest)
 #ifdef __APPLE__
 	return (copyfile(src, dest, NULL, COPYFILE_ALL) == 0);
 #elif defined (__unix__)
-	try
-	{
-		std::ifstream source(src, std::ios::binary);
-		if (!source.is_open())
-			return false;
-		std::ofstream destination(dest, std::ios::binary);
-		if (!destination.is_open())
-			return false;
-		destination << source.rdbuf();
-		return true;
-	} catch(std::ios_base::failure &)
-	{
-		FileDelete(dest);
+	HANDLE src_h = FileCreate(src, fmOpenRead | fmShareDenyNone);
+	if (src_h == INVALID_HANDLE_VALUE)
+		return false;
+	HANDLE dest_h = FileCreate(dest, fmCreate | fmOpenWrite);
+	if (dest_h == INVALID_HANDLE_VALUE) {
+		FileClose(src_h);
 		return false;
 	}
+
+	bool res = false;
+#ifdef FICLONE
+	// on btrfs, XFS and other filesystems with reflinks the copy shares the extents of the source
+	res = (ioctl(dest_h, FICLONE, src_h) == 0);
+#endif
+	if (!res) {
+		uint64_t size = FileSeek(src_h, 0, soEnd);
+		uint64_t pos = 0;
+		while (pos < size) {
+			size_t count = static_cast<size_t>(std::min<uint64_t>(size - pos, 0x40000000));
+			size_t copied = FileCopyRange(src_h, pos, dest_h, pos, count);
+			if (copied == (size_t)-1 || copied == 0)
+				break;
+			pos += copied;
+		}
+		if (pos < size && FileSeek(src_h, pos, soBeginning) == pos && FileSeek(dest_h, pos, soBeginning) == pos) {
+			std::vector<uint8_t> buf(0x100000);
+			while (pos < size) {
+				size_t n = FileRead(src_h, buf.data(), buf.size());
+				if (n == (size_t)-1 || n == 0 || FileWrite(dest_h, buf.data(), n) != n)
+					break;
+				pos += n;
+			}
+		}
+		res = (pos == size);
+	}
+
+	FileClose(dest_h);
+	FileClose(src_h);
+	if (!res)
+		FileDelete(dest);
+	return res;
 #else
 	return (CopyFileW(FromUTF8(src).c_str(), FromUTF8(dest).c_str(), false) != FALSE);
 #endif
 }
 
+/**
+ * Copies count bytes between two files inside the kernel. On Linux copy_file_range is used, so the data
+ * doesn't pass through user space and filesystems with reflinks share the extents instead of copying them.
+ * Returns the number of copied bytes (0 at the end of the source) or (size_t)-1 if the kernel can't copy
+ * between these files and the caller has to copy the data itself.
+ */
+size_t FileCopyRange(HANDLE src, uint64_t src_offset, HANDLE dest, uint64_t dest_offset, size_t count)
+{
+#if defined(__unix__) && defined(__NR_copy_file_range)
+	size_t res = 0;
+	while (res < count) {
+		loff_t src_pos = src_offset + res;
+		loff_t dest_pos = dest_offset + res;
+		long copied = syscall(__NR_copy_file_range, src, &src_pos, dest, &dest_pos, count - res, 0);
+		if (copied < 0) {
+			if (errno == EINTR)
+				continue;
+			return res ? res : (size_t)-1;
+		}
+		if (copied == 0)
+			break;
+		res += copied;
+	}
+	return res;
+#else
+	return (size_t)-1;
+#endif
+}
+
 // fmCreate			Create a file with the given name. If a file with the given name exists, open the file in write mode.   
 // fmOpenRead		Open the file for reading only.   
 // fmOpenWrite		Open the file for writing only. Writing to the file completely replaces the current contents.   
@@ -529,6 +588,66 @@ size_t FileWrite(HANDLE h, const void *buf, size_t size)
 	return res;
 }
 
+/**
+ * Writes the buffers one after another starting from offset. On Linux the buffers are passed to pwritev
+ * in batches of IOV_MAX, elsewhere they are written one by one.
+ */
+size_t FileWriteAt(HANDLE h, uint64_t offset, const void * const *buffers, const size_t *sizes, size_t count)
+{
+	size_t res = 0;
+#if defined(__unix__)
+#ifdef IOV_MAX
+	const size_t max_count = IOV_MAX;
+#else
+	const size_t max_count = 1024;
+#endif
+	std::vector<iovec> iov_list;
+	size_t i = 0;
+	size_t pos = 0;
+	while (i < count) {
+		iov_list.clear();
+		for (size_t j = i; j < count && iov_list.size() < max_count; j++) {
+			size_t skip = (j == i) ? pos : 0;
+			iovec iov;
+			iov.iov_base = const_cast<uint8_t *>(static_cast<const uint8_t *>(buffers[j])) + skip;
+			iov.iov_len = sizes[j] - skip;
+			iov_list.push_back(iov);
+		}
+		ssize_t written = pwritev(h, iov_list.data(), static_cast<int>(iov_list.size()), offset + res);
+		if (written <= 0)
+			return (size_t)-1;
+		res += written;
+		// skip the written part of the buffers
+		size_t n = written;
+		while (i < count && n >= sizes[i] - pos) {
+			n -= sizes[i] - pos;
+			pos = 0;
+			i++;
+		}
+		pos += n;
+	}
+#elif defined(VMP_GNU)
+	for (size_t i = 0; i < count; i++) {
+		for (size_t pos = 0; pos < sizes[i]; ) {
+			ssize_t written = pwrite(h, static_cast<const uint8_t *>(buffers[i]) + pos, sizes[i] - pos, offset + res);
+			if (written <= 0)
+				return (size_t)-1;
+			pos += written;
+			res += written;
+		}
+	}
+#else
+	if (FileSeek(h, offset, soBeginning) == (uint64_t)-1)
+		return (size_t)-1;
+	for (size_t i = 0; i < count; i++) {
+		if (FileWrite(h, buffers[i], sizes[i]) != sizes[i])
+			return (size_t)-1;
+		res += sizes[i];
+	}
+#endif
+	return res;
+}
+
 uint64_t FileSeek(HANDLE h, uint64_t offset, SeekOrigin origin)
 {
 	uint64_t res;
@@ -1583,6 +1702,18 @@ bool PathCreate(const char *name)
 	return res;
 }
 
+bool DirectoryDelete(const char *name)
+{
+	if (!name)
+		return false;
+
+#ifdef VMP_GNU
+	return (rmdir(name) == 0);
+#else
+	return (RemoveDirectoryW(FromUTF8(name).c_str()) != 0);
+#endif
+}
+
 #ifndef VMP_GNU
 struct LocaleInfo {
 	LCID id;
@@ -72,6 +72,8 @@ HANDLE FileCreate(const char *file_name, uint32_t mode);
 bool FileClose(HANDLE h);
 size_t FileRead(HANDLE h, void *buf, size_t size);
 size_t FileWrite(HANDLE h, const void *buf, size_t size);
+size_t FileWriteAt(HANDLE h, uint64_t offset, const void * const *buffers, const size_t *sizes, size_t count);
+size_t FileCopyRange(HANDLE src, uint64_t src_offset, HANDLE dest, uint64_t dest_offset, size_t count);
 uint64_t FileSeek(HANDLE h, uint64_t offset, SeekOrigin origin);
 bool FileSetEnd(HANDLE h);
 bool FileGetCheckSum(const char *file_name, uint32_t *check_sum);
@@ -92,6 +94,7 @@ bool GetModuleInformation(HANDLE process, HMODULE module, MODULE_INFO *info, siz
 std::string GetSysAppDataDirectory();
 std::string CombineThisAppDataDirectory(const char *lastPathPart);
 bool PathCreate(const char *name);
+bool DirectoryDelete(const char *name);
 std::string GetLocaleName(const char *code);
 std::string GetCurrentLocale();
 void GetLocalTime(SYSTEM_TIME *res);
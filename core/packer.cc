@@ -117,6 +117,7 @@ bool Packer::WriteProps(Data *data)
 
 bool Packer::Code(IArchitecture *file, PackerInputStream &in, PackerOutputStream &out)
 {
+	TraceScope trace("Packer::Code");
 	out.data->clear();
 
 	PackerProgress progress(file);
@@ -2278,6 +2278,65 @@ public:
 	}
 };
 
+/**
+ * A stream of the MSF file, pages are resolved only when they are accessed.
+ */
+class pdb_stream_view
+{
+public:
+	pdb_stream_view() : fs_(NULL), block_size_(0), size_(0) {}
+	void assign(PdbFileStream *fs, size_t block_size, const std::vector<uint32_t> &block_list, size_t size);
+	size_t size() const { return size_; }
+	const uint8_t *data(size_t pos, size_t size, std::vector<uint8_t> &buffer) const;
+private:
+	PdbFileStream *fs_;
+	size_t block_size_;
+	std::vector<uint32_t> block_list_;
+	size_t size_;
+};
+
+void pdb_stream_view::assign(PdbFileStream *fs, size_t block_size, const std::vector<uint32_t> &block_list, size_t size)
+{
+	fs_ = fs;
+	block_size_ = block_size;
+	block_list_ = block_list;
+	size_ = size;
+}
+
+/**
+ * Returns a pointer to the stream bytes [pos, pos + size). Bytes from a single page point into the mapping,
+ * bytes that cross page boundaries (or a file that could not be mapped) are copied into the buffer.
+ */
+const uint8_t *pdb_stream_view::data(size_t pos, size_t size, std::vector<uint8_t> &buffer) const
+{
+	if (!size || pos > size_ || size > size_ - pos)
+		return NULL;
+
+	size_t block = pos / block_size_;
+	size_t block_pos = pos % block_size_;
+	const uint8_t *view = fs_->view();
+	if (view && block_pos + size <= block_size_) {
+		uint64_t offset = static_cast<uint64_t>(block_list_[block]) * block_size_ + block_pos;
+		return (offset + size <= fs_->view_size()) ? view + offset : NULL;
+	}
+
+	buffer.resize(size);
+	for (size_t i = 0; i < size; block++, block_pos = 0) {
+		size_t n = std::min(size - i, block_size_ - block_pos);
+		uint64_t offset = static_cast<uint64_t>(block_list_[block]) * block_size_ + block_pos;
+		if (view) {
+			if (offset + n > fs_->view_size())
+				return NULL;
+			memcpy(&buffer[i], view + offset, n);
+		} else {
+			if (fs_->Seek(offset, soBeginning) != offset || fs_->Read(&buffer[i], n) != n)
+				return NULL;
+		}
+		i += n;
+	}
+	return buffer.data();
+}
+
 class pdb_reader
 {
 protected:
@@ -2288,6 +2347,7 @@ public:
 	virtual ~pdb_reader() {}
 	virtual bool init() = 0;
 	virtual bool read_file(size_t idx, std::vector<uint8_t> &dest) = 0;
+	virtual bool open_file(size_t idx, pdb_stream_view &view) = 0;
 	template<class T> bool read(size_t block_size, const T* block_list, size_t size, std::vector<uint8_t> &dest);
 };
 
@@ -2297,6 +2357,7 @@ public:
 	pdb_jg_reader(PdbFileStream &fs) : pdb_reader(fs), toc(NULL), root(NULL) {}
 	bool init();
 	bool read_file(size_t idx, std::vector<uint8_t> &dest);
+	bool open_file(size_t idx, pdb_stream_view &view);
 
 	PDB_JG_HEADER header;
 	const struct PDB_JG_TOC*    toc;
@@ -2309,6 +2370,7 @@ public:
 	pdb_ds_reader(PdbFileStream &fs) : pdb_reader(fs), toc(NULL), root(NULL) {}
 	bool init();
 	bool read_file(size_t idx, std::vector<uint8_t> &dest);
+	bool open_file(size_t idx, pdb_stream_view &view);
 
 	PDB_DS_HEADER header;
 	const struct PDB_DS_TOC*    toc;
@@ -2349,6 +2411,26 @@ bool pdb_jg_reader::read_file(size_t file_nr, std::vector<uint8_t> &dest)
 	return read(header.block_size, block_list, toc->file[file_nr].size, dest);
 }
 
+bool pdb_jg_reader::open_file(size_t file_nr, pdb_stream_view &view)
+{
+	if (!toc || file_nr >= toc->num_files)
+		return false;
+
+	if (toc->file[file_nr].size == 0 || toc->file[file_nr].size == 0xFFFFFFFF)
+		return false;
+
+	const uint16_t *block_list = reinterpret_cast<const WORD*>(&toc->file[toc->num_files]);
+	for (size_t i = 0; i < file_nr; i++)
+		block_list += (toc->file[i].size + header.block_size - 1) / header.block_size;
+
+	size_t block_count = (toc->file[file_nr].size + header.block_size - 1) / header.block_size;
+	if (reinterpret_cast<const uint8_t *>(block_list + block_count) > vtoc_.data() + vtoc_.size())
+		return false;
+
+	view.assign(&fs_, header.block_size, std::vector<uint32_t>(block_list, block_list + block_count), toc->file[file_nr].size);
+	return true;
+}
+
 bool pdb_jg_reader::init()
 {
 	if(!fs_.RawRead(0, &header))
@@ -2385,6 +2467,26 @@ bool pdb_jg_reader::init()
 	return read(header.block_size, block_list, toc->file_size[file_number], dest);
 }
 
+bool pdb_ds_reader::open_file(size_t file_number, pdb_stream_view &view)
+{
+	if (!toc || file_number >= toc->num_files)
+		return false;
+
+	if (toc->file_size[file_number] == 0 || toc->file_size[file_number] == 0xFFFFFFFF)
+		return false;
+
+	const uint32_t *block_list = toc->file_size + toc->num_files;
+	for (size_t i = 0; i < file_number; i++)
+		block_list += (toc->file_size[i] + header.block_size - 1) / header.block_size;
+
+	size_t block_count = (toc->file_size[file_number] + header.block_size - 1) / header.block_size;
+	if (reinterpret_cast<const uint8_t *>(block_list + block_count) > vtoc_.data() + vtoc_.size())
+		return false;
+
+	view.assign(&fs_, header.block_size, std::vector<uint32_t>(block_list, block_list + block_count), toc->file_size[file_number]);
+	return true;
+}
+
 bool pdb_ds_reader::init()
 {
 	if (!fs_.RawRead(0, &header)) 
@@ -1277,7 +1277,7 @@ void PEExportList::AddAntidebug()
 	std::string name;
 	name.resize(3100);
 	for (i = 0; i < name.size(); i++) {
-		name[i] = 1 + rand() % 0xff;
+		name[i] = 1 + Random() % 0xff;
 	}
 	exp->set_name(name);
 }
@@ -2552,26 +2552,33 @@ size_t PEResource::WriteData(Data &data, PEArchitecture &file)
 	return data_entry_offset_;
 }
 
-void PEResource::WriteData(IFunction &func, PEArchitecture &file, uint32_t key)
+void PEResource::ReadData(PEArchitecture &file, Data &data)
 {
+	data.clear();
 	if (is_directory() || !data_.item.Size)
 		return;
 
 	if (!file.AddressSeek(address()))
 		throw std::runtime_error("Invalid data address");
 
-	std::vector<uint8_t> buf;
-	buf.resize(data_.item.Size);
-	file.Read(buf.data(), buf.size());
+	data.resize(data_.item.Size);
+	file.Read(&data[0], data.size());
+}
 
-	Data d;
-	for (size_t i = 0; i < buf.size(); i++) {
-		d.PushByte(buf[i] ^ static_cast<uint8_t>(_rotl32(key, static_cast<int>(i)) + i));
-	}
+ICommand *PEResource::WriteData(IFunction &func, PEArchitecture &file, const Data &data)
+{
+	if (is_directory() || !data_.item.Size)
+		return NULL;
 
-	ICommand *command = func.AddCommand(d);
+	ICommand *command = func.AddCommand(data);
 	command->include_option(roCreateNewBlock);
 
+	WriteDataLink(func, file, command);
+	return command;
+}
+
+void PEResource::WriteDataLink(IFunction &func, PEArchitecture &file, ICommand *command)
+{
 	CommandLink *link = func.item(data_entry_offset_)->AddLink(0, ltOffset, command);
 	link->set_sub_value(file.image_base());
 }
@@ -4180,8 +4187,18 @@ OpenStatus PEArchitecture::ReadFromFile(uint32_t mode)
 	if (resource_section_)
 		resource_section_->set_need_parse(false);
 
+	std::auto_ptr<AnalysisCache> cache;
+	bool is_cached = false;
 	if ((mode & foHeaderOnly) == 0) {
-		if (!owner()->file_name().empty()) {
+		if (mode & foUseCache) {
+			std::vector<std::string> file_list;
+			file_list.push_back(map_file_name());
+			file_list.push_back(pdb_file_name());
+			cache.reset(new AnalysisCache(this, file_list));
+			is_cached = cache->Load();
+		}
+
+		if (!is_cached && !owner()->file_name().empty()) {
 			std::vector<uint64_t> segments;
 			for (size_t i = 0; i < segment_list()->count(); i++) {
 				segments.push_back(segment_list()->item(i)->address());
@@ -4238,7 +4255,8 @@ OpenStatus PEArchitecture::ReadFromFile(uint32_t mode)
 			}
 		}
 
-		map_function_list()->ReadFromFile(*this);
+		if (!is_cached)
+			map_function_list()->ReadFromFile(*this);
 	}
 
 	switch (cpu_) {
@@ -4247,8 +4265,12 @@ OpenStatus PEArchitecture::ReadFromFile(uint32_t mode)
 		function_list_ = new PEIntelFunctionList(this);
 		virtual_machine_list_ = new IntelVirtualMachineList();
 		if ((mode & foHeaderOnly) == 0) {
-			IntelFileHelper helper;
-			helper.Parse(*this);
+			if (!is_cached) {
+				IntelFileHelper helper;
+				helper.Parse(*this);
+				if (cache.get())
+					cache->Save();
+			}
 
 			relocation_list_->ReadFromFile(*this);
 		}
@@ -4267,6 +4289,35 @@ std::string PEArchitecture::pdb_file_name() const
 	return os::ChangeFileExt(owner()->file_name().c_str(), ".pdb");
 }
 
+void PEArchitecture::SaveAnalysis(Data &data) const
+{
+	BaseArchitecture::SaveAnalysis(data);
+
+	// sections from the MAP file
+	data.PushDWord(static_cast<uint32_t>(section_list_->count()));
+	for (size_t i = 0; i < section_list_->count(); i++) {
+		PESection *section = section_list_->item(i);
+		data.PushDWord(static_cast<uint32_t>(segment_list_->IndexOf(section->parent())));
+		data.PushQWord(section->address());
+		data.PushQWord(section->size());
+		data.PushString(section->name());
+	}
+}
+
+void PEArchitecture::LoadAnalysis(Buffer &buffer)
+{
+	BaseArchitecture::LoadAnalysis(buffer);
+
+	section_list_->clear();
+	size_t c = buffer.ReadDWord();
+	for (size_t i = 0; i < c; i++) {
+		PESegment *segment = segment_list_->item(buffer.ReadDWord());
+		uint64_t address = buffer.ReadQWord();
+		uint64_t size = buffer.ReadQWord();
+		section_list_->Add(segment, address, size, buffer.ReadString());
+	}
+}
+
 bool PEArchitecture::ReadMapFile(IMapFile &map_file)
 {
 	if (!BaseArchitecture::ReadMapFile(map_file))
@@ -4789,7 +4840,7 @@ void PEArchitecture::Save(CompileContext &ctx)
 				continue;
 
 			for (j = 0; j < region->size(); j++) {
-				WriteByte((ctx.options.flags & cpDebugMode) ? 0xcc : rand());
+				WriteByte((ctx.options.flags & cpDebugMode) ? 0xcc : Random());
 			}
 		}
 	}
@@ -5544,6 +5595,8 @@ bool PDBFile::Parse(const char *file_name, const std::vector<uint64_t> &segments
 	PdbFileStream fs;
 	if (!fs.Open(file_name, fmOpenRead | fmShareDenyNone))
 		return false;
+	// symbol streams are read through the mapping if it is available
+	fs.Map();
 
 	segments_ = segments;
 
@@ -5603,15 +5656,16 @@ bool PDBFile::ReadSymbols(pdb_reader &reader)
 	}
 
 	PDB_SYMBOLS *symbols;
-	std::vector<uint8_t> vsymbols, vmodimage;
+	std::vector<uint8_t> vsymbols;
+	pdb_stream_view modimage;
 
 	if (!reader.read_file(PDB_STREAM_DBI, vsymbols)) 
 		return false;
 	symbols = reinterpret_cast<PDB_SYMBOLS*>(vsymbols.data());
 
 	// read global symbol table
-	if (reader.read_file(symbols->gsym_file, vmodimage))
-		codeview_dump_symbols(vmodimage, 0);
+	if (reader.open_file(symbols->gsym_file, modimage))
+		codeview_dump_symbols(modimage, 0);
 
 	// read per-module symbol / linenumber tables
 	const char *file = reinterpret_cast<const char*>(symbols) + sizeof(PDB_SYMBOLS);
@@ -5634,8 +5688,8 @@ bool PDBFile::ReadSymbols(pdb_reader &reader)
 			file_name = sym_file->filename;
 			symbol_size = sym_file->symbol_size;
 		}
-		if (symbol_size && reader.read_file(file_nr, vmodimage))
-			codeview_dump_symbols(vmodimage, sizeof(uint32_t));
+		if (symbol_size && reader.open_file(file_nr, modimage))
+			codeview_dump_symbols(modimage, sizeof(uint32_t));
 		file_name += strlen(file_name) + 1;
 		file = reinterpret_cast<char*>(reinterpret_cast<size_t>(file_name + strlen(file_name) + 1 + 3) & ~3);
 	}
@@ -5937,15 +5991,21 @@ std::string PDBFile::GetTypeName(size_t data_type, const std::string &name)
 	return res + name;
 }
 
-void PDBFile::codeview_dump_symbols(const std::vector<uint8_t> &root, size_t offset)
+void PDBFile::codeview_dump_symbols(const pdb_stream_view &root, size_t offset)
 {
 	size_t i;
 	int length;
+	std::vector<uint8_t> buffer;
 	for (i = offset; i < root.size(); i += length)
 	{
-		const union codeview_symbol* sym = reinterpret_cast<const union codeview_symbol*>(&root[0] + i);
+		const union codeview_symbol* sym = reinterpret_cast<const union codeview_symbol*>(root.data(i, sizeof(sym->generic), buffer));
+		if (!sym)
+			break;
 		length = sym->generic.len + 2;
 		if (!sym->generic.id || length < 4) break;
+		sym = reinterpret_cast<const union codeview_symbol*>(root.data(i, length, buffer));
+		if (!sym)
+			break;
 		switch (sym->generic.id)
 		{
 		case S_GDATA_V2:
@@ -6001,7 +6061,12 @@ void PDBFile::codeview_dump_symbols(const std::vector<uint8_t> &root, size_t off
 		case S_PROCREF_V1:
 		case S_DATAREF_V1:
 		case S_LPROCREF_V1:
-			length += (*(reinterpret_cast<const char *>(sym) + length) + 1 + 3) & ~3;
+			{
+				const uint8_t *name_length = root.data(i + length, 1, buffer);
+				if (!name_length)
+					return;
+				length += (*name_length + 1 + 3) & ~3;
+			}
 			break;
 		}
 	}
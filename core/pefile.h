@@ -575,7 +575,9 @@ public:
 	void WriteHeader(IFunction &data);
 	void WriteEntry(IFunction &data);
 	void WriteName(IFunction &data, size_t root_index, uint32_t key);
-	void WriteData(IFunction &data, PEArchitecture &file, uint32_t key);
+	void ReadData(PEArchitecture &file, Data &data);
+	ICommand *WriteData(IFunction &func, PEArchitecture &file, const Data &data);
+	void WriteDataLink(IFunction &func, PEArchitecture &file, ICommand *command);
 private:
 	PEResource *Add(PEResourceType type, uint32_t name_offset, uint32_t data_offset);
 
@@ -738,6 +740,7 @@ private:
 };
 
 class pdb_reader;
+class pdb_stream_view;
 
 class PDBFile : public BaseMapFile
 {
@@ -750,7 +753,7 @@ public:
 	void set_time_stamp(uint64_t value) { time_stamp_ = value; }
 private:
 	bool ReadSymbols(pdb_reader &reader);
-	void codeview_dump_symbols(const std::vector<uint8_t> &root, size_t offset);
+	void codeview_dump_symbols(const pdb_stream_view &root, size_t offset);
 	std::string GetTypeName(size_t type, const std::string &name);
 	void AddSymbol(size_t segment, size_t offset, const std::string &name);
 	void AddSection(size_t segment, size_t offset, uint64_t size, const std::string &name);
@@ -842,6 +845,8 @@ public:
 	uint32_t header_offset() const { return header_offset_; }
 	uint32_t header_size() const { return header_size_; }
 	virtual std::string ANSIToUTF8(const std::string &str) const;
+	virtual void SaveAnalysis(Data &data) const;
+	virtual void LoadAnalysis(Buffer &buffer);
 	uint16_t dll_characteristics() const { return dll_characteristics_; }
 	std::string pdb_file_name() const;
 	uint32_t operating_system_version() const { return operating_system_version_; }
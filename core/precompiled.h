@@ -17,6 +17,11 @@
 #include <queue>
 #include <time.h>
 #include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 #ifdef VMP_GNU
 #include <unistd.h>
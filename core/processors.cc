@@ -715,7 +715,7 @@ void ValueCryptor::Init(OperandSize size)
 	size_ = size;
 	CryptCommandType last_command = ccUnknown;
 	for (;;) {
-		CryptCommandType command = static_cast<CryptCommandType>(rand() % ccUnknown);
+		CryptCommandType command = static_cast<CryptCommandType>(Random() % ccUnknown);
 		if (command == last_command)
 			continue;
 
@@ -742,7 +742,7 @@ void ValueCryptor::Init(OperandSize size)
 			if (last_command == ccRol || last_command == ccRor)
 				continue;
 			
-			value = rand() % BYTES_TO_BITS(OperandSizeToValue(size_));
+			value = Random() % BYTES_TO_BITS(OperandSizeToValue(size_));
 			if (!value)
 				value = 1;
 			break;
@@ -752,7 +752,7 @@ void ValueCryptor::Init(OperandSize size)
 		Add(command, value);
 
 		size_t c = count();
-		if (c > 100 || (c > 3 && (rand() & 1)))
+		if (c > 100 || (c > 3 && (Random() & 1)))
 			break;
 	}
 }
@@ -775,7 +775,7 @@ OpcodeCryptor::OpcodeCryptor()
 void OpcodeCryptor::Init(OperandSize size)
 {
 	//static CryptCommandType opcode_commands[] = {ccAdd, ccSub, ccXor};
-	//type_ = opcode_commands[rand() % _countof(opcode_commands)];
+	//type_ = opcode_commands[Random() % _countof(opcode_commands)];
 	type_ = ccXor;
 	ValueCryptor::Init(size);
 }
@@ -946,9 +946,14 @@ CommandLink *CommandLinkList::Add(ICommand *from_command, int operand_index, Lin
 
 CommandLink *CommandLinkList::GetLinkByToAddress(LinkType type, uint64_t to_address)
 {
-	for (size_t i = 0; i < count(); i++) {
-		CommandLink *link = item(i);
-		if (link->to_address() == to_address && (type == ltNone || link->type() == type))
+	std::map<uint64_t, std::vector<CommandLink *> >::const_iterator it = to_address_map_.find(to_address);
+	if (it == to_address_map_.end())
+		return NULL;
+
+	const std::vector<CommandLink *> &link_list = it->second;
+	for (size_t i = 0; i < link_list.size(); i++) {
+		CommandLink *link = link_list[i];
+		if (type == ltNone || link->type() == type)
 			return link;
 	}
 
@@ -957,8 +962,54 @@ CommandLink *CommandLinkList::GetLinkByToAddress(LinkType type, uint64_t to_addr
 
 void CommandLinkList::Rebase(uint64_t delta_base)
 {
+	to_address_map_.clear();
 	for (size_t i = 0; i < count(); i++) {
-		item(i)->Rebase(delta_base);
+		CommandLink *link = item(i);
+		link->Rebase(delta_base);
+		to_address_map_[link->to_address()].push_back(link);
+	}
+}
+
+void CommandLinkList::AddObject(CommandLink *link)
+{
+	ObjectList<CommandLink>::AddObject(link);
+	to_address_map_[link->to_address()].push_back(link);
+}
+
+void CommandLinkList::InsertObject(size_t index, CommandLink *link)
+{
+	ObjectList<CommandLink>::InsertObject(index, link);
+	UpdateToAddressMap(link->to_address());
+}
+
+void CommandLinkList::RemoveObject(CommandLink *link)
+{
+	ObjectList<CommandLink>::RemoveObject(link);
+
+	std::map<uint64_t, std::vector<CommandLink *> >::iterator it = to_address_map_.find(link->to_address());
+	if (it == to_address_map_.end())
+		return;
+
+	std::vector<CommandLink *> &link_list = it->second;
+	for (size_t i = link_list.size(); i > 0; i--) {
+		if (link_list[i - 1] == link) {
+			link_list.erase(link_list.begin() + i - 1);
+			break;
+		}
+	}
+	if (link_list.empty())
+		to_address_map_.erase(it);
+}
+
+void CommandLinkList::UpdateToAddressMap(uint64_t to_address)
+{
+	// the links of each address are kept in the list order
+	std::vector<CommandLink *> &link_list = to_address_map_[to_address];
+	link_list.clear();
+	for (size_t i = 0; i < count(); i++) {
+		CommandLink *link = item(i);
+		if (link->to_address() == to_address)
+			link_list.push_back(link);
 	}
 }
 
@@ -1263,7 +1314,7 @@ uint8_t CommandBlock::GetRegistr(OperandSize size, uint8_t registr, bool is_writ
 	if (registr & regExtended) {
 		res = (uint8_t)(registr_count_ + (registr & 0xf));
 	} else if (registr == regEmpty && !is_write) {
-		res = (uint8_t)(rand() % registr_count_);
+		res = (uint8_t)(Random() % registr_count_);
 	} else {
 		if(registr >= _countof(registr_indexes_)) 
 			throw std::runtime_error("Runtime error at GetRegistr");
@@ -1287,7 +1338,7 @@ uint8_t CommandBlock::GetRegistr(OperandSize size, uint8_t registr, bool is_writ
 			}
 
 			if (empty_registr_count) {
-				res = empty_registr[rand() % empty_registr_count];
+				res = empty_registr[Random() % empty_registr_count];
 				if (registr != regEmpty)
 					registr_indexes_[registr] = res;
 			} else if (res == 0xff)
@@ -2221,7 +2272,7 @@ IVirtualMachine *BaseFunction::virtual_machine(IVirtualMachineList *virtual_mach
 			if (virtual_machine->processor()->cpu_address_size() == cpu_address_size())
 				list.push_back(virtual_machine);
 		}
-		return list[rand() % list.size()];
+		return list[Random() % list.size()];
 	}
 
 	return NULL;
@@ -2388,17 +2439,23 @@ IFunction *BaseFunctionList::AddUnknown(const std::string &name, CompilationType
 	return func;
 };
 
+bool BaseFunctionList::IsValidAddress(uint64_t address) const
+{
+	uint32_t memory_type = owner_->segment_list()->GetMemoryTypeByAddress(address);
+	if ((memory_type & mtExecutable) == 0) {
+		MapFunction *map_function = owner_->map_function_list()->GetFunctionByAddress(address);
+		if (!map_function || map_function->type() != otString)
+			return false;
+	}
+	return true;
+}
+
 IFunction *BaseFunctionList::AddByAddress(uint64_t address, CompilationType compilation_type, uint32_t compilation_options, bool need_compile, Folder *folder)
 {
 	IFunction *func = GetFunctionByAddress(address);
 	if (!func) {
-		// check address
-		uint32_t memory_type = owner_->segment_list()->GetMemoryTypeByAddress(address);
-		if ((memory_type & mtExecutable) == 0) {
-			MapFunction *map_function = owner_->map_function_list()->GetFunctionByAddress(address);
-			if (!map_function || map_function->type() != otString)
-				return NULL;
-		}
+		if (!IsValidAddress(address))
+			return NULL;
 
 		func = Add("", compilation_type, compilation_options, need_compile, folder);
 		if (func) {
@@ -2414,6 +2471,70 @@ IFunction *BaseFunctionList::AddByAddress(uint64_t address, CompilationType comp
 	return func;
 };
 
+/**
+ * Adds functions like AddByAddress does for every item of info_list, but reads the new functions by
+ * one ReadFunctions call. Returns the function of every item or NULL for invalid addresses.
+ */
+std::vector<IFunction *> BaseFunctionList::AddByAddressList(const std::vector<FunctionLoadInfo> &info_list)
+{
+	size_t i;
+	std::map<uint64_t, IFunction *> function_map;
+	std::vector<IFunction *> function_list;
+	std::vector<uint64_t> address_list;
+	std::vector<size_t> update_list;
+	std::vector<IFunction *> res(info_list.size());
+
+	for (i = 0; i < count(); i++) {
+		IFunction *func = item(i);
+		function_map.insert(std::make_pair(func->address(), func));
+	}
+
+	for (i = 0; i < info_list.size(); i++) {
+		const FunctionLoadInfo &info = info_list[i];
+		std::map<uint64_t, IFunction *>::const_iterator it = function_map.find(info.address);
+		if (it != function_map.end()) {
+			// existing functions are updated after reading the new ones
+			res[i] = it->second;
+			update_list.push_back(i);
+			continue;
+		}
+
+		if (!IsValidAddress(info.address))
+			continue;
+
+		IFunction *func = Add("", info.compilation_type, info.compilation_options, info.need_compile, info.folder);
+		if (func) {
+			function_map[info.address] = func;
+			function_list.push_back(func);
+			address_list.push_back(info.address);
+			res[i] = func;
+		}
+	}
+
+	ReadFunctions(function_list, address_list);
+
+	for (i = 0; i < function_list.size(); i++) {
+		Notify(mtAdded, function_list[i]);
+	}
+
+	for (i = 0; i < update_list.size(); i++) {
+		const FunctionLoadInfo &info = info_list[update_list[i]];
+		IFunction *func = res[update_list[i]];
+		func->set_compilation_type(info.compilation_type);
+		func->set_compilation_options(info.compilation_options);
+		func->set_need_compile(info.need_compile);
+		func->set_folder(info.folder);
+	}
+	return res;
+}
+
+void BaseFunctionList::ReadFunctions(const std::vector<IFunction *> &function_list, const std::vector<uint64_t> &address_list)
+{
+	for (size_t i = 0; i < function_list.size(); i++) {
+		function_list[i]->ReadFromFile(*owner_, address_list[i]);
+	}
+}
+
 IFunction *BaseFunctionList::GetFunctionByAddress(uint64_t address) const
 {
 	for (size_t i = 0; i < count(); i++) {
@@ -2479,6 +2600,7 @@ ICommand *BaseFunctionList::GetCommandByNearAddress(uint64_t address, bool need_
 
 bool BaseFunctionList::Prepare(const CompileContext &ctx)
 {
+	static const char *stage_names[] = {"FunctionList::Init", "FunctionList::Prepare", "FunctionList::PrepareExtCommands", "FunctionList::PrepareLinks"};
 	size_t i, j;
 
 	bool need_machines = (ctx.runtime != NULL);
@@ -2506,6 +2628,7 @@ bool BaseFunctionList::Prepare(const CompileContext &ctx)
 	}
 
 	for (j = 0; j < 4; j++) {
+		TraceScope trace(stage_names[j]);
 		for (i = 0; i < count(); i++) {
 			IFunction *func = item(i);
 			switch (j) {
@@ -2538,6 +2661,7 @@ bool BaseFunctionList::Prepare(const CompileContext &ctx)
 
 bool BaseFunctionList::Compile(const CompileContext &ctx)
 {
+	TraceScope trace("FunctionList::Compile");
 	size_t i, j, k;
 	IFunction *func;
 	CommandBlock *block;
@@ -2552,7 +2676,27 @@ bool BaseFunctionList::Compile(const CompileContext &ctx)
 			j += func->count();
 	}
 	ctx.file->StartProgress(string_format("%s...", language[lsCompiling].c_str()), j);
-		
+
+	std::vector<FunctionReportItem> report_list;
+	if (ctx.options.function_report) {
+		report_list.resize(count());
+		for (i = 0; i < count(); i++) {
+			func = item(i);
+			FunctionReportItem &report = report_list[i];
+			report.architecture = ctx.file->name();
+			report.name = func->display_name();
+			report.address = func->address();
+			report.compilation_type = func->compilation_type();
+			for (j = 0; j < func->count(); j++) {
+				ICommand *command = func->item(j);
+				if (!command->address())
+					continue;
+				report.native_count++;
+				report.native_size += command->original_dump_size();
+			}
+		}
+	}
+
 	for (i = 0; i < count(); i++) {
 		func = item(i);
 		if (!func->Compile(ctx))
@@ -2570,7 +2714,7 @@ bool BaseFunctionList::Compile(const CompileContext &ctx)
 	}
 
 	for (i = 0; i < block_list.size(); i++) {
-		std::swap(block_list[i], block_list[rand() % block_list.size()]);
+		std::swap(block_list[i], block_list[Random() % block_list.size()]);
 	}
 
 	if (ctx.file->runtime_function_list() && ctx.file->runtime_function_list()->count()) {
@@ -2605,7 +2749,7 @@ bool BaseFunctionList::Compile(const CompileContext &ctx)
 				size_t size = function_info->prolog_size() - prolog_size;
 				data.resize(size);
 				for (k = 0; k < data.size(); k++) {
-					data[k] = rand();
+					data[k] = Random();
 				}
 				CommandBlock *new_block = func->AddBlock(func->count(), true);
 				ICommand *command = func->AddCommand(data);
@@ -2626,6 +2770,36 @@ bool BaseFunctionList::Compile(const CompileContext &ctx)
 	CompileInfo(ctx);
 	CompileLinks(ctx);
 
+	if (ctx.options.function_report) {
+		for (i = 0; i < report_list.size(); i++) {
+			func = item(i);
+			if (func->tag() != ftNone || !func->need_compile())
+				continue;
+
+			FunctionReportItem &report = report_list[i];
+			std::set<IObject *> handler_list;
+			for (j = 0; j < func->count(); j++) {
+				ICommand *command = func->item(j);
+				block = command->block();
+				if (!block)
+					continue;
+				if (block->type() & mtExecutable) {
+					report.output_size += command->dump_size();
+					continue;
+				}
+				report.vm_size += command->vm_dump_size();
+				report.vm_command_count += command->count();
+				for (k = 0; k < command->count(); k++) {
+					IObject *handler = command->item(k)->handler();
+					if (handler)
+						handler_list.insert(handler);
+				}
+			}
+			report.handler_count = handler_list.size();
+			ctx.options.function_report->Add(report);
+		}
+	}
+
 	ctx.file->EndProgress();
 
 	return true;
@@ -2640,6 +2814,8 @@ void BaseFunctionList::CompileInfo(const CompileContext &ctx)
 
 void BaseFunctionList::CompileLinks(const CompileContext &ctx)
 {
+	TraceScope trace("FunctionList::CompileLinks");
+
 	for (size_t i = 0; i < count(); i++) {
 		IFunction *func = item(i);
 		if (func->compilation_type() != ctMutation)
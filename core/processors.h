@@ -117,6 +117,7 @@ public:
 	virtual uint64_t address() const = 0;
 	virtual ICommand *owner() const = 0;
 	virtual bool is_end() const = 0;
+	virtual IObject *handler() const = 0;
 };
 
 enum VMCommandOption {
@@ -523,7 +524,14 @@ public:
 	CommandLink *Add(ICommand *from_command, int operand_index, LinkType type, ICommand *to_command);
 	CommandLink *GetLinkByToAddress(LinkType type, uint64_t to_address);
 	void Rebase(uint64_t delta_base);
+	virtual void AddObject(CommandLink *link);
+	virtual void InsertObject(size_t index, CommandLink *link);
+	virtual void RemoveObject(CommandLink *link);
 private:
+	void UpdateToAddressMap(uint64_t to_address);
+
+	std::map<uint64_t, std::vector<CommandLink *> > to_address_map_;
+
 	// no assignment op
 	CommandLinkList &operator =(const CommandLinkList &);
 };
@@ -969,6 +977,16 @@ public:
 	void InitSearch();
 };
 
+struct FunctionLoadInfo {
+	uint64_t address;
+	CompilationType compilation_type;
+	uint32_t compilation_options;
+	bool need_compile;
+	Folder *folder;
+	FunctionLoadInfo(uint64_t address_, CompilationType compilation_type_, uint32_t compilation_options_, bool need_compile_, Folder *folder_)
+		: address(address_), compilation_type(compilation_type_), compilation_options(compilation_options_), need_compile(need_compile_), folder(folder_) {}
+};
+
 class IFunctionList : public ObjectList<IFunction>
 {
 public:
@@ -980,6 +998,7 @@ public:
 	virtual ICommand *GetCommandByNearAddress(uint64_t address, bool need_compile) const = 0;
 	virtual IFunction *AddUnknown(const std::string &name, CompilationType compilation_type, uint32_t compilation_options, bool need_compile, Folder *folder) = 0;
 	virtual IFunction *AddByAddress(uint64_t address, CompilationType compilation_type, uint32_t compilation_options, bool need_compile, Folder *folder) = 0;
+	virtual std::vector<IFunction *> AddByAddressList(const std::vector<FunctionLoadInfo> &info_list) = 0;
 	virtual IFunctionList *Clone(IArchitecture *owner) const = 0;
 	virtual bool Prepare(const CompileContext &ctx) = 0;
 	virtual bool Compile(const CompileContext &ctx) = 0;
@@ -1010,6 +1029,7 @@ public:
 	virtual ICommand *GetCommandByNearAddress(uint64_t address, bool need_compile) const;
 	virtual IFunction *AddUnknown(const std::string &name, CompilationType compilation_type, uint32_t compilation_options, bool need_compile, Folder *folder);
 	virtual IFunction *AddByAddress(uint64_t address, CompilationType compilation_type, uint32_t compilation_options, bool need_compile, Folder *folder);
+	virtual std::vector<IFunction *> AddByAddressList(const std::vector<FunctionLoadInfo> &info_list);
 	virtual bool Prepare(const CompileContext &ctx);
 	virtual bool Compile(const CompileContext &ctx);
 	virtual void CompileLinks(const CompileContext &ctx);
@@ -1023,7 +1043,11 @@ public:
 #ifdef CHECKED
 	virtual bool check_hash() const;
 #endif
+protected:
+	virtual void ReadFunctions(const std::vector<IFunction *> &function_list, const std::vector<uint64_t> &address_list);
 private:
+	bool IsValidAddress(uint64_t address) const;
+
 	IArchitecture *owner_;
 };
 
@@ -236,8 +236,15 @@ uint64_t ModuleStream::Seek(int64_t offset, SeekOrigin origin)
  * FileStream
  */
 
+static const size_t WRITE_BEHIND_BLOCK_SIZE = 0x100000;
+static const size_t COPY_RANGE_MIN_SIZE = 0x10000;
+
 FileStream::FileStream(size_t CACHE_ALLOC_SIZE /*= 0x10000*/)
-	:  h_(INVALID_HANDLE_VALUE), cache_mode_(cmNone), CACHE_ALLOC_SIZE_(CACHE_ALLOC_SIZE), cache_pos_(0), cache_size_(0), cache_offset_(0)
+	:  h_(INVALID_HANDLE_VALUE), cache_mode_(cmNone), CACHE_ALLOC_SIZE_(CACHE_ALLOC_SIZE), cache_pos_(0), cache_size_(0), cache_offset_(0),
+	write_behind_size_(0), dirty_size_(0), position_(0), end_(0), view_(NULL), view_size_(0)
+#ifndef VMP_GNU
+	, map_(NULL)
+#endif
 {
 
 }
@@ -257,7 +264,11 @@ bool FileStream::Open(const char *filename, int mode)
 
 void FileStream::Close()
 {
+	Unmap();
 	FlushCache();
+	FlushWriteBehind();
+	write_behind_size_ = 0;
+	free_block_list_.clear();
 
 	if (h_ != INVALID_HANDLE_VALUE) {
 		os::FileClose(h_);
@@ -265,6 +276,125 @@ void FileStream::Close()
 	}
 }
 
+/**
+ * In the write-behind mode writes and seeks don't touch the file. Written data is kept in blocks
+ * sorted by offset until buffer_size bytes are collected, then runs of adjacent blocks are written
+ * by one os::FileWriteAt call each. Reads flush the blocks first. A buffer_size of 0 turns the mode off.
+ */
+void FileStream::set_write_behind(size_t buffer_size)
+{
+	if ((write_behind_size_ != 0) == (buffer_size != 0)) {
+		write_behind_size_ = buffer_size;
+		return;
+	}
+
+	if (buffer_size) {
+		position_ = Tell();
+		FlushCache(true);
+		end_ = os::FileSeek(h_, 0, soEnd);
+		write_behind_size_ = buffer_size;
+	} else {
+		uint64_t pos = (cache_mode_ == cmRead) ? cache_offset_ + cache_pos_ : position_;
+		FlushCache();
+		FlushWriteBehind();
+		write_behind_size_ = 0;
+		free_block_list_.clear();
+		os::FileSeek(h_, pos, soBeginning);
+	}
+}
+
+void FileStream::WriteBehind(const uint8_t *buffer, size_t size)
+{
+	if (!size)
+		return;
+
+	uint64_t offset = position_;
+	position_ += size;
+	if (end_ < position_)
+		end_ = position_;
+
+	std::map<uint64_t, std::vector<uint8_t> >::iterator it = dirty_map_.upper_bound(offset);
+	if (it != dirty_map_.begin()) {
+		std::map<uint64_t, std::vector<uint8_t> >::iterator prev = it;
+		prev--;
+		std::vector<uint8_t> &block = prev->second;
+		uint64_t block_end = prev->first + block.size();
+		if (offset < block_end) {
+			size_t n = static_cast<size_t>(std::min<uint64_t>(size, block_end - offset));
+			memcpy(&block[static_cast<size_t>(offset - prev->first)], buffer, n);
+			offset += n;
+			buffer += n;
+			size -= n;
+		}
+		if (size && offset == block_end && block.size() < WRITE_BEHIND_BLOCK_SIZE) {
+			// sequential writes grow the last block
+			uint64_t limit = (it == dirty_map_.end()) ? offset + size : it->first;
+			size_t n = static_cast<size_t>(std::min<uint64_t>(std::min<uint64_t>(size, limit - offset), WRITE_BEHIND_BLOCK_SIZE - block.size()));
+			block.insert(block.end(), buffer, buffer + n);
+			dirty_size_ += n;
+			offset += n;
+			buffer += n;
+			size -= n;
+		}
+	}
+
+	while (size) {
+		size_t n;
+		if (it != dirty_map_.end() && it->first == offset) {
+			n = std::min(size, it->second.size());
+			memcpy(&it->second[0], buffer, n);
+			it++;
+		} else {
+			uint64_t limit = (it == dirty_map_.end()) ? offset + size : it->first;
+			n = static_cast<size_t>(std::min<uint64_t>(std::min<uint64_t>(size, limit - offset), WRITE_BEHIND_BLOCK_SIZE));
+			std::vector<uint8_t> &block = dirty_map_.insert(it, std::make_pair(offset, std::vector<uint8_t>()))->second;
+			// blocks of the previous flushes are reused to avoid allocating the buffer again
+			if (!free_block_list_.empty()) {
+				block.swap(free_block_list_.back());
+				free_block_list_.pop_back();
+			} else {
+				block.reserve(WRITE_BEHIND_BLOCK_SIZE);
+			}
+			block.assign(buffer, buffer + n);
+			dirty_size_ += n;
+		}
+		offset += n;
+		buffer += n;
+		size -= n;
+	}
+
+	if (dirty_size_ >= write_behind_size_)
+		FlushWriteBehind();
+}
+
+void FileStream::FlushWriteBehind()
+{
+	std::vector<const void *> buffer_list;
+	std::vector<size_t> size_list;
+	std::map<uint64_t, std::vector<uint8_t> >::const_iterator it = dirty_map_.begin();
+	while (it != dirty_map_.end()) {
+		uint64_t offset = it->first;
+		uint64_t next_offset = offset;
+		buffer_list.clear();
+		size_list.clear();
+		for (; it != dirty_map_.end() && it->first == next_offset; it++) {
+			buffer_list.push_back(it->second.data());
+			size_list.push_back(it->second.size());
+			next_offset += it->second.size();
+		}
+		if (os::FileWriteAt(h_, offset, buffer_list.data(), size_list.data(), buffer_list.size()) != next_offset - offset)
+			throw std::runtime_error("Runtime Error at Flush");
+	}
+	for (std::map<uint64_t, std::vector<uint8_t> >::iterator block = dirty_map_.begin(); block != dirty_map_.end(); block++) {
+		if (block->second.capacity() == WRITE_BEHIND_BLOCK_SIZE) {
+			free_block_list_.push_back(std::vector<uint8_t>());
+			free_block_list_.back().swap(block->second);
+		}
+	}
+	dirty_map_.clear();
+	dirty_size_ = 0;
+}
+
 uint8_t * FileStream::Cache()
 {
 	uint8_t *ret = cache_.get();
@@ -296,6 +426,11 @@ void FileStream::FlushCache(bool need_seek)
 
 size_t FileStream::Read(void *buffer, size_t size)
 {
+	if (write_behind_size_ && cache_mode_ != cmRead) {
+		FlushWriteBehind();
+		os::FileSeek(h_, position_, soBeginning);
+	}
+
 	size_t add_size = 0;
 	if (cache_mode_ == cmRead) {
 		size_t cache_size = cache_size_ - cache_pos_;
@@ -333,11 +468,22 @@ size_t FileStream::Read(void *buffer, size_t size)
 	// check error
 	if (res == (size_t)-1)
 		return res;
+	if (write_behind_size_)
+		position_ = os::FileSeek(h_, 0, soCurrent);
 	return res + add_size;
 }
 
 size_t FileStream::Write(const void *buffer, size_t size)
 {
+	if (write_behind_size_) {
+		if (cache_mode_ == cmRead) {
+			position_ = cache_offset_ + cache_pos_;
+			FlushCache();
+		}
+		WriteBehind(static_cast<const uint8_t *>(buffer), size);
+		return size;
+	}
+
 	size_t add_size = 0;
 	if (cache_mode_ == cmWrite) {
 		size_t cache_size = cache_size_ - cache_pos_;
@@ -374,6 +520,30 @@ size_t FileStream::Write(const void *buffer, size_t size)
 
 uint64_t FileStream::Seek(int64_t offset, SeekOrigin origin)
 {
+	if (write_behind_size_) {
+		uint64_t pos = (cache_mode_ == cmRead) ? cache_offset_ + cache_pos_ : position_;
+		switch (origin) {
+		case soBeginning:
+			pos = offset;
+			break;
+		case soCurrent:
+			pos += offset;
+			break;
+		case soEnd:
+			pos = end_ + offset;
+			break;
+		}
+		if (cache_mode_ == cmRead) {
+			if (pos >= cache_offset_ && pos <= cache_offset_ + cache_size_) {
+				cache_pos_ = static_cast<size_t>(pos - cache_offset_);
+				return pos;
+			}
+			FlushCache();
+		}
+		position_ = pos;
+		return pos;
+	}
+
 	if (cache_mode_ != cmNone) {
 		switch (origin) {
 		case soBeginning:
@@ -405,12 +575,50 @@ uint64_t FileStream::Seek(int64_t offset, SeekOrigin origin)
 
 uint64_t FileStream::Resize(uint64_t new_size)
 {
+	if (write_behind_size_) {
+		FlushCache();
+		FlushWriteBehind();
+		position_ = new_size;
+		end_ = new_size;
+		uint64_t res = os::FileSeek(h_, new_size, soBeginning);
+		os::FileSetEnd(h_);
+		return res;
+	}
+
 	uint64_t res = Seek(new_size, soBeginning);
 	FlushCache(true);
 	os::FileSetEnd(h_);
 	return res;
 }
 
+/**
+ * Large ranges between two files are copied by os::FileCopyRange without passing the data through
+ * the caches, small ones and unsupported file systems use the buffered copy.
+ */
+size_t FileStream::CopyFrom(AbstractStream &source, size_t count)
+{
+	FileStream *file = dynamic_cast<FileStream *>(&source);
+	if (!file || file == this || count < COPY_RANGE_MIN_SIZE)
+		return AbstractStream::CopyFrom(source, count);
+
+	uint64_t src_pos = file->Tell();
+	uint64_t dest_pos = Tell();
+	file->Flush();
+	Flush();
+
+	size_t res = os::FileCopyRange(file->h_, src_pos, h_, dest_pos, count);
+	if (res == (size_t)-1)
+		res = 0;
+	file->Seek(src_pos + res, soBeginning);
+	Seek(dest_pos + res, soBeginning);
+	if (write_behind_size_ && end_ < dest_pos + res)
+		end_ = dest_pos + res;
+
+	if (res < count)
+		res += AbstractStream::CopyFrom(source, count - res);
+	return res;
+}
+
 bool FileStream::ReadLine(std::string &out_line)
 {
 	bool res = true;
@@ -446,6 +654,53 @@ std::string FileStream::ReadAll()
 	return res;
 }
 
+/**
+ * Maps the whole file for reading, the view stays valid until Unmap() or Close().
+ */
+bool FileStream::Map()
+{
+	Unmap();
+	FlushWriteBehind();
+
+	uint64_t size = Size();
+	if (!size || size == (uint64_t)-1 || size != static_cast<size_t>(size))
+		return false;
+
+#ifdef VMP_GNU
+	void *view = mmap(0, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, h_, 0);
+	if (view == MAP_FAILED)
+		return false;
+#else
+	map_ = CreateFileMappingW(h_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!map_)
+		return false;
+	void *view = MapViewOfFile(map_, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(map_);
+		map_ = NULL;
+		return false;
+	}
+#endif
+	view_ = static_cast<const uint8_t *>(view);
+	view_size_ = size;
+	return true;
+}
+
+void FileStream::Unmap()
+{
+	if (view_) {
+#ifdef VMP_GNU
+		munmap(const_cast<uint8_t *>(view_), static_cast<size_t>(view_size_));
+#else
+		UnmapViewOfFile(view_);
+		CloseHandle(map_);
+		map_ = NULL;
+#endif
+		view_ = NULL;
+		view_size_ = 0;
+	}
+}
+
 /**
  * Buffer
  */
@@ -484,6 +739,14 @@ uint64_t Buffer::ReadQWord()
 	return res;
 }
 
+std::string Buffer::ReadString()
+{
+	size_t size = ReadDWord();
+	std::string res(reinterpret_cast<const char *>(&memory_[position_]), size);
+	position_ += size;
+	return res;
+}
+
 void Buffer::ReadBuff(void *buff, size_t size)
 {
 	memcpy(buff, &memory_[position_], size);
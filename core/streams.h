@@ -30,12 +30,21 @@ public:
 	virtual size_t Write(const void *buffer, size_t size);
 	virtual	uint64_t Seek(int64_t offset, SeekOrigin origin);
 	virtual uint64_t Resize(uint64_t new_size);
-	virtual void Flush() { FlushCache(); }
+	virtual size_t CopyFrom(AbstractStream &source, size_t count);
+	virtual void Flush() { FlushCache(); FlushWriteBehind(); }
 	bool ReadLine(std::string &line);
 	std::string ReadAll();
+	bool Map();
+	void Unmap();
+	const uint8_t *view() const { return view_; }
+	uint64_t view_size() const { return view_size_; }
+	size_t write_behind_size() const { return write_behind_size_; }
+	void set_write_behind(size_t buffer_size);
 protected:
 	uint8_t *Cache();
 	void FlushCache(bool need_seek = false);
+	void WriteBehind(const uint8_t *buffer, size_t size);
+	void FlushWriteBehind();
 
 	HANDLE h_;
 	enum CacheMode {
@@ -49,6 +58,18 @@ protected:
 	size_t cache_pos_;
 	size_t cache_size_;
 	uint64_t cache_offset_;
+	size_t write_behind_size_;
+	std::map<uint64_t, std::vector<uint8_t> > dirty_map_;
+	std::vector<std::vector<uint8_t> > free_block_list_;
+	size_t dirty_size_;
+	uint64_t position_;
+	uint64_t end_;
+private:
+	const uint8_t *view_;
+	uint64_t view_size_;
+#ifndef VMP_GNU
+	HANDLE map_;
+#endif
 };
 
 class MemoryStream : public AbstractStream
@@ -101,6 +122,7 @@ public:
 	uint16_t ReadWord();
 	uint32_t ReadDWord();
 	uint64_t ReadQWord();
+	std::string ReadString();
 private:
 	void ReadBuff(void *buff, size_t size);
 	const uint8_t *memory_;
@@ -6,6 +6,7 @@
 #include "../core/files.h"
 #include "../core/processors.h"
 #include "../core/core.h"
+#include "../core/intel.h"
 
 TEST(CoreTest, OpenAndCompile)
 {
@@ -73,6 +74,214 @@ TEST(CoreTest, IsUniqueWatermark)
 	ASSERT_TRUE(wm.IsUniqueWatermark("34587?B123"));
 }
 
+static uint8_t FileKeyStream(uint32_t key, uint64_t position)
+{
+	return static_cast<uint8_t>(_rotl32(key, static_cast<int>(position)) + position);
+}
+
+TEST(CoreTest, EncryptData)
+{
+	const uint32_t key = 0x9E3779B9;
+	std::vector<uint8_t> src(1000);
+	for (size_t i = 0; i < src.size(); i++) {
+		src[i] = static_cast<uint8_t>(i * 31 + 7);
+	}
+
+	// unaligned positions and sizes must give the same bytes as the byte-wise key stream
+	const uint64_t positions[] = {0, 1, 7, 255, 256, 0x100003, 0x80000005ull};
+	for (size_t p = 0; p < _countof(positions); p++) {
+		for (size_t size = 0; size < 300; size += 13) {
+			std::vector<uint8_t> buf(src.begin() + 3, src.begin() + 3 + size);
+			EncryptData(buf.data(), buf.size(), positions[p], key);
+			for (size_t i = 0; i < size; i++) {
+				ASSERT_EQ(buf[i], static_cast<uint8_t>(src[3 + i] ^ FileKeyStream(key, positions[p] + i)));
+			}
+		}
+	}
+}
+
+#ifdef ULTIMATE
+static uint64_t ResidentSize()
+{
+	uint64_t res = 0;
+#if defined(__unix__)
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f) {
+		unsigned long long size, resident;
+		if (fscanf(f, "%llu %llu", &size, &resident) == 2)
+			res = resident * sysconf(_SC_PAGESIZE);
+		fclose(f);
+	}
+#endif
+	return res;
+}
+
+TEST(InternalFileTest, ReadSparseFile)
+{
+	const uint32_t key = 0x12345678;
+	const uint64_t file_size = 0x4000003; // 64 MB, not a multiple of the read chunk
+	const char head[] = "MZ bundled file";
+	const char tail[] = "tail";
+
+	std::string file_name = os::GetTempFilePathName();
+	{
+		FileStream fs;
+		ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenWrite));
+		ASSERT_EQ(fs.Write(head, sizeof(head)), sizeof(head));
+		fs.Seek(file_size - sizeof(tail), soBeginning);
+		ASSERT_EQ(fs.Write(tail, sizeof(tail)), sizeof(tail));
+	}
+
+	Core core;
+	FileManager *file_manager = core.file_manager();
+	file_manager->Add("sparse.dll", file_name, faLoad, NULL);
+	ASSERT_TRUE(file_manager->OpenFiles());
+	InternalFile *file = file_manager->item(0);
+	IntelFunction func(NULL, osDWord);
+	file->WriteEntry(func);
+
+	// only one buffer of the file size is allocated, the command takes it over
+	const uint64_t max_growth = file_size + file_size / 8;
+	uint64_t resident_size = ResidentSize();
+	Data data;
+	InternalFile::ReadData(*file->stream(), data, key);
+	EXPECT_LE(ResidentSize() - resident_size, max_growth);
+	const uint8_t *buffer = data.data();
+	ICommand *command = file->WriteData(func, 0, data);
+	EXPECT_LE(ResidentSize() - resident_size, max_growth);
+	file_manager->CloseFiles();
+	os::FileDelete(file_name.c_str());
+
+	EXPECT_TRUE(data.empty());
+	Data &dump = static_cast<BaseCommand *>(command)->raw_dump();
+	EXPECT_EQ(dump.data(), buffer);
+	ASSERT_EQ(dump.size(), file_size);
+	for (size_t i = 0; i < dump.size(); i++) {
+		uint8_t value = dump[i] ^ FileKeyStream(key, i);
+		if (i < sizeof(head)) {
+			ASSERT_EQ(value, static_cast<uint8_t>(head[i]));
+		} else if (i >= file_size - sizeof(tail)) {
+			ASSERT_EQ(value, static_cast<uint8_t>(tail[i - (file_size - sizeof(tail))]));
+		} else {
+			ASSERT_EQ(value, 0);
+		}
+	}
+}
+
+TEST(InternalFileTest, ReadFilesInParallel)
+{
+	const uint32_t key = 0x5BD1E995;
+	const size_t file_count = 32;
+	size_t i;
+
+	Core core;
+	FileManager *file_manager = core.file_manager();
+	std::vector<std::string> file_name_list;
+	for (i = 0; i < file_count; i++) {
+		std::vector<uint8_t> buf(0x1000 + (i * 7919) % 0x8000);
+		for (size_t j = 0; j < buf.size(); j++) {
+			buf[j] = static_cast<uint8_t>(i + j * 13);
+		}
+		std::string file_name = os::GetTempFilePathName();
+		{
+			FileStream fs;
+			ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenWrite));
+			ASSERT_EQ(fs.Write(buf.data(), buf.size()), buf.size());
+		}
+		file_name_list.push_back(file_name);
+		file_manager->Add(string_format("file%d.dll", static_cast<int>(i)), file_name, faLoad, NULL);
+	}
+
+	std::vector<Data> single_list, parallel_list;
+	ASSERT_TRUE(file_manager->OpenFiles());
+	file_manager->ReadData(single_list, key, 1);
+	file_manager->CloseFiles();
+
+	ASSERT_TRUE(file_manager->OpenFiles());
+	file_manager->ReadData(parallel_list, key, 4);
+	file_manager->CloseFiles();
+
+	for (i = 0; i < file_name_list.size(); i++) {
+		os::FileDelete(file_name_list[i].c_str());
+	}
+
+	// the result must not depend on the number of threads
+	ASSERT_EQ(single_list.size(), file_count);
+	ASSERT_EQ(parallel_list.size(), file_count);
+	for (i = 0; i < file_count; i++) {
+		const Data &data = parallel_list[i];
+		ASSERT_EQ(data.size(), 0x1000 + (i * 7919) % 0x8000);
+		ASSERT_TRUE(data.size() == single_list[i].size() && memcmp(data.data(), single_list[i].data(), data.size()) == 0);
+		for (size_t j = 0; j < data.size(); j += 0x3FF) {
+			ASSERT_EQ(data[j] ^ FileKeyStream(key, j), static_cast<uint8_t>(i + j * 13));
+		}
+	}
+}
+
+TEST(InternalFileTest, WriteDuplicateData)
+{
+	const uint32_t key = 0x2545F491;
+	const size_t file_size = 3000;
+	// files 0, 2 and 3 have the same content
+	const uint8_t seed_list[] = {1, 2, 1, 1, 3};
+	size_t i, j;
+
+	Core core;
+	FileManager *file_manager = core.file_manager();
+	std::vector<std::string> file_name_list;
+	for (i = 0; i < _countof(seed_list); i++) {
+		std::vector<uint8_t> buf(file_size);
+		for (j = 0; j < buf.size(); j++) {
+			buf[j] = static_cast<uint8_t>(seed_list[i] * j);
+		}
+		std::string file_name = os::GetTempFilePathName();
+		{
+			FileStream fs;
+			ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenWrite));
+			ASSERT_EQ(fs.Write(buf.data(), buf.size()), buf.size());
+		}
+		file_name_list.push_back(file_name);
+		file_manager->Add(string_format("file%d.dll", static_cast<int>(i)), file_name, faLoad, NULL);
+	}
+
+	ASSERT_TRUE(file_manager->OpenFiles());
+	IntelFunction func(NULL, osDWord);
+	std::vector<size_t> entry_list;
+	for (i = 0; i < file_manager->count(); i++) {
+		entry_list.push_back(func.count());
+		file_manager->item(i)->WriteEntry(func);
+	}
+	size_t data_index = func.count();
+	file_manager->WriteData(func, 0, key, GetThreadCount());
+	file_manager->CloseFiles();
+
+	for (i = 0; i < file_name_list.size(); i++) {
+		os::FileDelete(file_name_list[i].c_str());
+	}
+
+	// three data blocks are stored for five files
+	size_t data_size = 0;
+	for (i = data_index; i < func.count(); i++) {
+		data_size += func.item(i)->dump_size();
+	}
+	EXPECT_EQ(func.count() - data_index, 3ul);
+	EXPECT_EQ(data_size, 3 * file_size);
+
+	// every name still extracts its own content
+	for (i = 0; i < entry_list.size(); i++) {
+		CommandLink *link = func.item(entry_list[i] + 1)->link();
+		ASSERT_TRUE(link != NULL);
+		ICommand *command = link->to_command();
+		ASSERT_TRUE(command != NULL);
+		ASSERT_EQ(command->dump_size(), file_size);
+		for (j = 0; j < file_size; j++) {
+			ASSERT_EQ(command->dump(j) ^ FileKeyStream(key, j), static_cast<uint8_t>(seed_list[i] * j));
+		}
+	}
+	EXPECT_EQ(func.item(entry_list[0] + 1)->link()->to_command(), func.item(entry_list[3] + 1)->link()->to_command());
+}
+#endif
+
 #ifndef VMP_GNU
 TEST(CoreTest, UTF8Validator)
 {
@@ -84,4 +293,187 @@ TEST(CoreTest, FromACP)
 {
 	ASSERT_TRUE(os::FromACP(std::string(" 1251")) == os::unicode_string(L" 1251"));
 }
-#endif
\ No newline at end of file
+#endif
+
+TEST(SearchIndexTest, Find)
+{
+	const char *names[] = { "GetProcAddress", "LoadLibraryA", "Folder\nLoadLibraryW", "std::vector<int>::push_back", "main" };
+	SearchIndex index;
+	for (size_t i = 0; i < _countof(names); i++) {
+		index.Add(names + i, names[i]);
+	}
+	ASSERT_EQ(index.count(), _countof(names));
+
+	std::vector<const void *> res = index.Find("loadlib");
+	ASSERT_EQ(res.size(), 2ul);
+	EXPECT_EQ(res[0], names + 1);
+	EXPECT_EQ(res[1], names + 2);
+	// literal runs of a wildcard pattern must be present in any order of checks
+	res = index.Find("LOAD*W");
+	ASSERT_EQ(res.size(), 1ul);
+	EXPECT_EQ(res[0], names + 2);
+	res = index.Find("pu?h_b[aeiou]ck");
+	ASSERT_EQ(res.size(), 1ul);
+	EXPECT_EQ(res[0], names + 3);
+	// patterns without trigrams check every item
+	EXPECT_EQ(index.Find("a").size(), 5ul);
+	EXPECT_EQ(index.Find("*").size(), _countof(names));
+	EXPECT_EQ(index.Find("").size(), _countof(names));
+	EXPECT_TRUE(index.Find("xyz").empty());
+	// a run can't cross the border of columns
+	EXPECT_TRUE(index.Find("rlo").empty());
+
+	index.Add(names + 4, "WinMain");
+	res = index.Find("winm");
+	ASSERT_EQ(res.size(), 1ul);
+	EXPECT_EQ(res[0], names + 4);
+	EXPECT_TRUE(index.Find("main").size() == 1);
+	index.Remove(names + 1);
+	EXPECT_FALSE(index.contains(names + 1));
+	res = index.Find("LoadLibrary");
+	ASSERT_EQ(res.size(), 1ul);
+	EXPECT_EQ(res[0], names + 2);
+	index.Add(names + 1, names[1]);
+	res = index.Find("LoadLibrary");
+	ASSERT_EQ(res.size(), 2ul);
+	EXPECT_EQ(res[0], names + 2);
+	EXPECT_EQ(res[1], names + 1);
+
+	for (size_t i = 0; i < _countof(names); i++) {
+		index.Remove(names + i);
+	}
+	EXPECT_EQ(index.count(), 0ul);
+	EXPECT_TRUE(index.Find("").empty());
+}
+
+static void TestSearchIndex(size_t count, uint64_t *build_time, uint64_t *scan_time, uint64_t *find_time)
+{
+	// symbols and addresses like they come from map files
+	const char *words[] = { "Get", "Set", "Load", "Save", "Create", "Destroy", "Read", "Write", "Open", "Close", "Find", "Update",
+		"Window", "File", "Stream", "Buffer", "Module", "Function", "Section", "Resource", "Import", "Export", "Node", "Item" };
+	std::vector<std::string> text_list(count);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < count; i++) {
+		std::string &text = text_list[i];
+		text = string_format("ns%u::", static_cast<uint32_t>(i % 97));
+		for (size_t j = 0; j < 3; j++) {
+			seed = seed * 1103515245 + 12345;
+			text += words[(seed >> 16) % _countof(words)];
+		}
+		text += string_format("%u\n%.8X", static_cast<uint32_t>(i % 1000), static_cast<uint32_t>(0x401000 + i * 0x10));
+	}
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	SearchIndex index;
+	for (size_t i = 0; i < count; i++) {
+		index.Add(&text_list[i], text_list[i]);
+	}
+	*build_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	const char *queries[] = { "l", "lo", "loa", "load", "loadf", "loadfi", "loadfil", "loadfile", "loadfilestream", "ns42::", "00431", "getwindowclose7" };
+	*scan_time = 0;
+	*find_time = 0;
+	for (size_t q = 0; q < _countof(queries); q++) {
+		std::string query = queries[q];
+
+		// a plain search walks all names and compares every text
+		start_time = std::chrono::steady_clock::now();
+		std::vector<const void *> expected;
+		for (size_t i = 0; i < count; i++) {
+			std::string text = text_list[i];
+			std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+			if (text.find(query) != std::string::npos)
+				expected.push_back(&text_list[i]);
+		}
+		*scan_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+		start_time = std::chrono::steady_clock::now();
+		std::vector<const void *> res = index.Find(query);
+		*find_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+		EXPECT_TRUE(res == expected) << query;
+	}
+}
+
+TEST(SearchIndexTest, FindMatchesScan)
+{
+	uint64_t build_time, scan_time, find_time;
+	TestSearchIndex(5000, &build_time, &scan_time, &find_time);
+}
+
+TEST(SearchIndexTest, DISABLED_Benchmark)
+{
+	const size_t count = 300000;
+	uint64_t build_time = 0, scan_time = 0, find_time = 0;
+	TestSearchIndex(count, &build_time, &scan_time, &find_time);
+	std::cout << "Build: " << build_time << " us for " << count << " names" << std::endl;
+	std::cout << "Scan:  " << scan_time << " us" << std::endl;
+	std::cout << "Index: " << find_time << " us" << std::endl;
+}
+
+static size_t new_handler_call_count = 0;
+
+static void TestNewHandler()
+{
+	new_handler_call_count++;
+	std::set_new_handler(NULL);
+}
+
+TEST(TracerTest, Allocate)
+{
+	uint64_t count, size, new_count, new_size;
+
+	// nothing is counted while tracing is disabled
+	Tracer::GetAllocations(count, size);
+	void *p = Tracer::Allocate(100);
+	ASSERT_TRUE(p != NULL);
+	Tracer::Free(p);
+	Tracer::GetAllocations(new_count, new_size);
+	EXPECT_EQ(new_count, count);
+	EXPECT_EQ(new_size, size);
+
+	Tracer::set_enabled(true);
+	p = Tracer::Allocate(100);
+	void *empty = Tracer::Allocate(0);
+	Tracer::GetAllocations(new_count, new_size);
+	Tracer::set_enabled(false);
+	ASSERT_TRUE(p != NULL);
+	ASSERT_TRUE(empty != NULL);
+	EXPECT_NE(p, empty);
+	Tracer::Free(p);
+	Tracer::Free(empty);
+	EXPECT_EQ(new_count, count + 2);
+	EXPECT_EQ(new_size, size + 100);
+
+	// a failed allocation calls the new handler before it throws
+	const size_t huge_size = static_cast<size_t>(-1) - 0x1000;
+	new_handler_call_count = 0;
+	std::set_new_handler(TestNewHandler);
+	EXPECT_THROW(Tracer::Allocate(huge_size), std::bad_alloc);
+	EXPECT_EQ(new_handler_call_count, 1ul);
+	EXPECT_TRUE(Tracer::Allocate(huge_size, std::nothrow) == NULL);
+	EXPECT_EQ(new_handler_call_count, 1ul);
+}
+
+TEST(CoreTest, RandomIsPerThread)
+{
+	const size_t count = 100000;
+	std::vector<int> expected(count);
+	SetRandomSeed(0);
+	for (size_t i = 0; i < count; i++) {
+		expected[i] = Random();
+		ASSERT_GE(expected[i], 0);
+	}
+
+	// concurrent compilations with the same seed must get the same sequence
+	std::vector<std::vector<int> > list(4);
+	ParallelFor(list.size(), list.size(), [&](size_t, size_t index) {
+		SetRandomSeed(0);
+		for (size_t i = 0; i < count; i++) {
+			list[index].push_back(Random());
+		}
+	});
+	for (size_t i = 0; i < list.size(); i++) {
+		EXPECT_TRUE(list[i] == expected);
+	}
+}
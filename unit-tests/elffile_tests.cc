@@ -250,6 +250,86 @@ TEST(ELFFileTest, Runtime_x64)
 	EXPECT_GT(arch->function_list()->count(), 0ul);
 }
 
+/**
+ * Fills the ELF header of a generated x64 shared object, PT_LOAD covers the whole image and PT_DYNAMIC holds dynamic_count
+ * entries at dynamic_offset.
+ */
+static void WriteTestHeaders(std::vector<uint8_t> &image, uint64_t entry, uint32_t flags, uint64_t dynamic_offset, size_t dynamic_count)
+{
+	Elf64_Ehdr *hdr = reinterpret_cast<Elf64_Ehdr *>(&image[0]);
+	hdr->e_ident[EI_MAG0] = 0x7f;
+	hdr->e_ident[EI_MAG1] = 'E';
+	hdr->e_ident[EI_MAG2] = 'L';
+	hdr->e_ident[EI_MAG3] = 'F';
+	hdr->e_ident[EI_CLASS] = ELFCLASS64;
+	hdr->e_ident[EI_DATA] = 1; // little endian
+	hdr->e_ident[EI_VERSION] = EV_CURRENT;
+	hdr->e_type = ET_DYN;
+	hdr->e_machine = EM_X86_64;
+	hdr->e_version = EV_CURRENT;
+	hdr->e_entry = entry;
+	hdr->e_phoff = sizeof(Elf64_Ehdr);
+	hdr->e_ehsize = sizeof(Elf64_Ehdr);
+	hdr->e_phentsize = sizeof(Elf64_Phdr);
+	hdr->e_phnum = 2;
+
+	Elf64_Phdr *phdr = reinterpret_cast<Elf64_Phdr *>(&image[sizeof(Elf64_Ehdr)]);
+	phdr[0].p_type = PT_LOAD;
+	phdr[0].p_flags = flags;
+	phdr[0].p_filesz = image.size();
+	phdr[0].p_memsz = image.size();
+	phdr[0].p_align = 0x1000;
+	phdr[1].p_type = PT_DYNAMIC;
+	phdr[1].p_flags = flags & ~PF_X;
+	phdr[1].p_offset = dynamic_offset;
+	phdr[1].p_vaddr = dynamic_offset;
+	phdr[1].p_paddr = dynamic_offset;
+	phdr[1].p_filesz = dynamic_count * sizeof(Elf64_Dyn);
+	phdr[1].p_memsz = dynamic_count * sizeof(Elf64_Dyn);
+	phdr[1].p_align = 8;
+}
+
+TEST(ELFFileTest, ReadRelr)
+{
+	const size_t image_size = 0x1000;
+	const uint64_t dynamic_offset = 0x100;
+	const uint64_t relr_offset = 0x180;
+	const uint64_t entry_offset = 0x200;
+	std::vector<uint8_t> image(image_size);
+
+	WriteTestHeaders(image, entry_offset, PF_R | PF_W | PF_X, dynamic_offset, 4);
+
+	// 0x400 and 0x800 are addresses, the odd word is a bitmap for 0x408 and 0x418
+	const uint64_t relr[] = {0x400, (((1 << 0) | (1 << 2)) << 1) | 1, 0x800};
+	Elf64_Dyn *dyn = reinterpret_cast<Elf64_Dyn *>(&image[dynamic_offset]);
+	dyn[0].d_tag = DT_RELR;
+	dyn[0].d_un.d_ptr = relr_offset;
+	dyn[1].d_tag = DT_RELRSZ;
+	dyn[1].d_un.d_val = sizeof(relr);
+	dyn[2].d_tag = DT_RELRENT;
+	dyn[2].d_un.d_val = sizeof(uint64_t);
+	dyn[3].d_tag = DT_NULL;
+	memcpy(&image[relr_offset], relr, sizeof(relr));
+	image[entry_offset] = 0xc3;
+
+	ELFFile file(NULL);
+	ASSERT_TRUE(file.OpenResource(image.data(), image.size(), false));
+	ASSERT_EQ(file.count(), 1ul);
+	ELFFixupList *fixup_list = file.item(0)->fixup_list();
+	EXPECT_TRUE(fixup_list->use_relr());
+	ASSERT_EQ(fixup_list->count(), 4ul);
+	const uint64_t addresses[] = {0x400, 0x408, 0x418, 0x800};
+	for (size_t i = 0; i < _countof(addresses); i++) {
+		EXPECT_EQ(fixup_list->item(i)->address(), addresses[i]);
+		EXPECT_EQ(fixup_list->item(i)->size(), osQWord);
+	}
+
+	Data data;
+	fixup_list->WriteRelrToData(data, osQWord);
+	ASSERT_EQ(data.size(), sizeof(relr));
+	EXPECT_EQ(memcmp(data.data(), relr, sizeof(relr)), 0);
+}
+
 #ifdef __unix__
 #ifndef DEMO
 static bool execFile(const std::string &fileName, DWORD &exitCode)
@@ -342,4 +422,123 @@ TEST(ELFFileTest, EXC_x64)
 	ASSERT_EQ(ret, 0u);
 }
 #endif // DEMO
-#endif // __unix__
\ No newline at end of file
+#endif // __unix__
+
+/**
+ * Writes the dynamic symbol table of a generated shared object with symbol_count symbols and checks the order of symbols.
+ */
+static void TestWriteDynamicTable(size_t symbol_count, uint64_t *write_time)
+{
+	const uint64_t dynamic_offset = 0x100;
+	const uint64_t hash_offset = 0x200;
+	const uint64_t symtab_offset = 0x1000;
+	size_t i;
+
+	// a generated shared object with a large .dynsym and nothing else
+	std::string strtab(1, 0);
+	std::vector<Elf64_Sym> symbols(symbol_count + 1);
+	for (i = 1; i < symbols.size(); i++) {
+		Elf64_Sym &sym = symbols[i];
+		sym.st_name = static_cast<uint32_t>(strtab.size());
+		sym.st_info = (STB_GLOBAL << 4) | STT_NOTYPE;
+		sym.st_shndx = 1;
+		sym.st_value = 0x1000 + i;
+		strtab += string_format("symbol_%d", static_cast<int>(i));
+		strtab.push_back(0);
+	}
+	uint64_t strtab_offset = symtab_offset + symbols.size() * sizeof(Elf64_Sym);
+	std::vector<uint8_t> image(static_cast<size_t>(strtab_offset) + strtab.size());
+
+	WriteTestHeaders(image, 0, PF_R, dynamic_offset, 7);
+
+	const uint64_t dyn_values[][2] = {
+		{DT_HASH, hash_offset},
+		{DT_GNU_HASH, hash_offset},
+		{DT_SYMTAB, symtab_offset},
+		{DT_STRTAB, strtab_offset},
+		{DT_STRSZ, strtab.size()},
+		{DT_SYMENT, sizeof(Elf64_Sym)},
+		{DT_NULL, 0}
+	};
+	Elf64_Dyn *dyn = reinterpret_cast<Elf64_Dyn *>(&image[dynamic_offset]);
+	for (i = 0; i < _countof(dyn_values); i++) {
+		dyn[i].d_tag = dyn_values[i][0];
+		dyn[i].d_un.d_val = dyn_values[i][1];
+	}
+	// only nchain of DT_HASH is used on reading
+	uint32_t *hash = reinterpret_cast<uint32_t *>(&image[hash_offset]);
+	hash[0] = 1;
+	hash[1] = static_cast<uint32_t>(symbols.size());
+	memcpy(&image[symtab_offset], symbols.data(), symbols.size() * sizeof(Elf64_Sym));
+	memcpy(&image[strtab_offset], strtab.data(), strtab.size());
+
+	ELFFile file(NULL);
+	ASSERT_TRUE(file.OpenResource(image.data(), image.size(), false));
+	ELFArchitecture *arch = file.item(0);
+	ELFSymbolList *symbol_list = arch->dynsymbol_list();
+	ASSERT_EQ(symbol_list->count(), symbols.size());
+
+	// the new tables are written after the end of the image
+	uint64_t pos = arch->size();
+	arch->Resize(pos + symbol_count * 0x100 + 0x10000);
+	arch->Seek(pos);
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	symbol_list->WriteToFile(*arch);
+	if (write_time)
+		*write_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	// hashed symbols must be grouped by GNU hash buckets after the unhashed ones
+	arch->Seek(pos);
+	uint32_t bucket_count = arch->ReadDWord();
+	uint32_t symbol_base = arch->ReadDWord();
+	ASSERT_EQ(symbol_list->count(), symbols.size());
+	EXPECT_EQ(symbol_base, 1u);
+	EXPECT_TRUE(symbol_list->item(0)->name().empty());
+	uint32_t prev_bucket = 0;
+	for (i = symbol_base; i < symbol_list->count(); i++) {
+		uint32_t h = 5381;
+		std::string name = symbol_list->item(i)->name();
+		for (size_t j = 0; j < name.size(); j++) {
+			h = (h << 5) + h + static_cast<uint8_t>(name[j]);
+		}
+		uint32_t bucket = h % bucket_count;
+		ASSERT_LE(prev_bucket, bucket);
+		prev_bucket = bucket;
+	}
+}
+
+TEST(ELFSymbolListTest, WriteDynamicTable)
+{
+	TestWriteDynamicTable(1000, NULL);
+}
+
+TEST(ELFSymbolListTest, DISABLED_WriteLargeDynamicTableBenchmark)
+{
+	const size_t symbol_count = 500000;
+	uint64_t time = 0;
+	TestWriteDynamicTable(symbol_count, &time);
+	std::cout << "Symbols: " << symbol_count << ", write " << time << " us" << std::endl;
+}
+
+TEST(ELFStringTableTest, Pack)
+{
+	ELFStringTable string_table;
+	string_table.clear();
+	const char *strings[] = {"init", "bar", "foo_init", "it", "_ZN3foo4initEv", "initEv"};
+	size_t i;
+	for (i = 0; i < _countof(strings); i++) {
+		string_table.AddString(strings[i]);
+	}
+	size_t size = string_table.size();
+	string_table.Pack();
+
+	// "init", "it" and "initEv" are tails of other strings
+	EXPECT_EQ(string_table.saved_size(), 5ul + 3ul + 7ul);
+	EXPECT_EQ(string_table.size(), size - string_table.saved_size());
+	for (i = 0; i < _countof(strings); i++) {
+		EXPECT_EQ(string_table.GetString(string_table.AddString(strings[i])), strings[i]);
+	}
+	EXPECT_EQ(string_table.AddString("init"), string_table.AddString("foo_init") + 4);
+	EXPECT_EQ(string_table.AddString("bar"), 1u);
+	EXPECT_EQ(string_table.size(), size - string_table.saved_size());
+}
@@ -184,6 +184,141 @@ TEST(MapFunctionListTest, Map_Test)
 	EXPECT_EQ(mf->address(), 0x40b460ull);
 }
 
+/**
+ * Parses and reads a generated MSVC map file with function_count publics written out of address order.
+ */
+static void TestReadMapFile(size_t function_count, uint64_t *parse_time, uint64_t *read_time)
+{
+	const uint64_t code_base = 0x00401000;
+	size_t i;
+
+	TestFile test_file(osDWord);
+	TestArchitecture &arch = *test_file.item(0);
+	TestSegmentList *segment_list = reinterpret_cast<TestSegmentList *>(arch.segment_list());
+	MapFunctionList *fl = arch.map_function_list();
+	segment_list->Add(code_base, function_count * 0x10, ".text", mtReadable | mtExecutable);
+
+	// the functions are written out of address order like the publics sorted by name
+	std::string text = " test\r\n\r\n Timestamp is 4f105118 (Fri Jan 13 21:43:20 2012)\r\n\r\n"
+		" Start         Length     Name                   Class\r\n"
+		" 0001:00000000 0003f3ddH .text                   CODE\r\n\r\n"
+		"  Address         Publics by Value              Rva+Base               Lib:Object\r\n\r\n";
+	for (i = 0; i < function_count; i++) {
+		size_t index = (i * 7919) % function_count;
+		text += string_format(" 0001:%.8X       func_%d %.16X f   test.obj\r\n", static_cast<uint32_t>(index * 0x10), static_cast<int>(index),
+			static_cast<uint32_t>(code_base + index * 0x10));
+	}
+
+	std::string file_name = os::GetTempFilePathName();
+	{
+		FileStream fs;
+		ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenWrite));
+		ASSERT_EQ(fs.Write(text.data(), text.size()), text.size());
+	}
+	text.clear();
+
+	std::vector<uint64_t> segments;
+	segments.push_back(0);
+	segments.push_back(code_base);
+	TestMapFile map_file;
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	bool res = map_file.ParseEx(file_name.c_str(), segments, 0);
+	*parse_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+	start_time = std::chrono::steady_clock::now();
+	arch.ReadTestMapFile(file_name.c_str());
+	*read_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+	os::FileDelete(file_name.c_str());
+
+	ASSERT_TRUE(res);
+	MapSection *functions = map_file.GetSectionByType(msFunctions);
+	ASSERT_TRUE(functions != NULL);
+	ASSERT_EQ(functions->count(), function_count);
+	EXPECT_EQ(functions->item(1)->address(), code_base + (7919 % function_count) * 0x10);
+	EXPECT_EQ(functions->item(1)->name(), string_format("func_%d", static_cast<int>(7919 % function_count)));
+
+	ASSERT_EQ(fl->count(), function_count);
+	for (i = 0; i < function_count; i += 997) {
+		MapFunction *mf = fl->GetFunctionByAddress(code_base + i * 0x10);
+		ASSERT_TRUE(mf != NULL);
+		EXPECT_EQ(mf->name(), string_format("func_%d", static_cast<int>(i)));
+		EXPECT_EQ(fl->GetFunctionByName(mf->name()), mf);
+	}
+}
+
+TEST(MapFunctionListTest, ReadUnsortedMapFile)
+{
+	uint64_t parse_time, read_time;
+	TestReadMapFile(5000, &parse_time, &read_time);
+}
+
+TEST(MapFunctionListTest, DISABLED_ReadLargeMapFileBenchmark)
+{
+	uint64_t parse_time = 0, read_time = 0;
+	TestReadMapFile(500000, &parse_time, &read_time);
+	std::cout << "Parse: " << parse_time << " us" << std::endl;
+	std::cout << "Read:  " << read_time << " us" << std::endl;
+}
+
+/**
+ * Demangles repeated names one by one and in a batch, both results must be equal.
+ */
+static void TestDemangleNames(size_t unique_count, size_t repeat_count, uint64_t *serial_time, uint64_t *batch_time)
+{
+	size_t i;
+
+	std::vector<std::string> names;
+	for (i = 0; i < unique_count * repeat_count; i++) {
+		size_t index = i % unique_count;
+		std::string id = std::to_string(index);
+		switch (index % 4) {
+		case 0:
+			names.push_back("?func" + id + "@space@@YAHPBDAAV?$vector@HV?$allocator@H@std@@@std@@@Z");
+			break;
+		case 1:
+			names.push_back("_ZN5space" + std::to_string(4 + id.size()) + "func" + id + "EPKcRSt6vectorIiSaIiEE");
+			break;
+		case 2:
+			names.push_back("@Unit" + id + "@Func$qqrpxci");
+			break;
+		default:
+			names.push_back("plain_" + id);
+			break;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	std::vector<FunctionName> serial_names;
+	for (i = 0; i < names.size(); i++) {
+		serial_names.push_back(DemangleName(names[i]));
+	}
+	*serial_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	start_time = std::chrono::steady_clock::now();
+	std::vector<FunctionName> batch_names = DemangleNames(names);
+	*batch_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	ASSERT_EQ(batch_names.size(), names.size());
+	for (i = 0; i < names.size(); i++) {
+		ASSERT_TRUE(batch_names[i] == serial_names[i]);
+	}
+	EXPECT_EQ(batch_names[1].name(), "space::func1(char const*, std::vector<int, std::allocator<int> >&)");
+	EXPECT_EQ(batch_names[3].name(), "plain_3");
+}
+
+TEST(MapFunctionListTest, DemangleNames)
+{
+	uint64_t serial_time, batch_time;
+	TestDemangleNames(1000, 3, &serial_time, &batch_time);
+}
+
+TEST(MapFunctionListTest, DISABLED_DemangleNamesBenchmark)
+{
+	uint64_t serial_time = 0, batch_time = 0;
+	TestDemangleNames(20000, 10, &serial_time, &batch_time);
+	std::cout << "Serial: " << serial_time << " us" << std::endl;
+	std::cout << "Batch:  " << batch_time << " us" << std::endl;
+}
+
 TEST(MemoryManager, Alloc)
 {
 	MemoryManager manager(NULL);
@@ -402,4 +537,302 @@ TEST(MemoryManager, ExtendedRemove)
 	EXPECT_EQ(region->address(), 3ull);
 	EXPECT_EQ(region->end_address(), 5ull);
 	EXPECT_EQ((int)region->type(), mtReadable);
-}
\ No newline at end of file
+}
+
+TEST(FunctionReport, Format)
+{
+	FunctionReport report;
+	FunctionReportItem item;
+	item.architecture = "x86";
+	item.name = "say \"hello\"";
+	item.address = 0x401000;
+	item.compilation_type = ctVirtualization;
+	item.native_count = 4;
+	item.native_size = 10;
+	item.output_size = 5;
+	item.vm_size = 120;
+	item.vm_command_count = 30;
+	item.handler_count = 12;
+	report.Add(item);
+	ASSERT_EQ(report.count(), 1ul);
+	EXPECT_EQ(report.item(0).dispatch_ratio(), 7.5);
+	EXPECT_EQ(report.item(0).mutation_ratio(), 0.5);
+
+	std::string csv = report.ToCSV();
+	EXPECT_EQ(csv.substr(csv.find('\n') + 1), "x86,00401000,\"say \"\"hello\"\"\",virtualization,4,10,5,120,30,12,0.50,7.50\n");
+
+	std::string json = report.ToJSON();
+	EXPECT_NE(json.find("\"name\": \"say \\\"hello\\\"\""), std::string::npos);
+	EXPECT_NE(json.find("\"handlers\": 12"), std::string::npos);
+	EXPECT_NE(json.find("\"dispatches_per_instruction\": 7.50"), std::string::npos);
+}
+
+TEST(FileStreamTest, WriteBehind)
+{
+	std::string file_name = os::GetTempFilePathName();
+	std::vector<uint8_t> image;
+	uint32_t seed = 1;
+	{
+		FileStream fs(0x40);
+		ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenReadWrite));
+		fs.set_write_behind(0x1000);
+		uint64_t pos = 0;
+		for (size_t i = 0; i < 20000; i++) {
+			seed = seed * 1103515245 + 12345;
+			size_t value = seed >> 16;
+			switch (value % 4) {
+			case 0:
+			case 1:
+				{
+					// write a piece of the image, sometimes across the end of the file
+					std::vector<uint8_t> buf(value % 100 + 1);
+					for (size_t j = 0; j < buf.size(); j++) {
+						buf[j] = static_cast<uint8_t>(value + j);
+					}
+					ASSERT_EQ(fs.Write(buf.data(), buf.size()), buf.size());
+					if (image.size() < pos + buf.size())
+						image.resize(static_cast<size_t>(pos + buf.size()));
+					memcpy(&image[static_cast<size_t>(pos)], buf.data(), buf.size());
+					pos += buf.size();
+				}
+				break;
+			case 2:
+				pos = value % (image.size() + 16);
+				ASSERT_EQ(fs.Seek(pos, soBeginning), pos);
+				break;
+			case 3:
+				{
+					uint8_t buf[32];
+					size_t size = fs.Read(buf, value % sizeof(buf));
+					size_t expected = (pos < image.size()) ? std::min(value % sizeof(buf), image.size() - static_cast<size_t>(pos)) : 0;
+					ASSERT_EQ(size, expected);
+					ASSERT_TRUE(!size || memcmp(buf, &image[static_cast<size_t>(pos)], size) == 0);
+					pos += size;
+				}
+				break;
+			}
+			ASSERT_EQ(fs.Tell(), pos);
+		}
+		ASSERT_EQ(fs.Size(), image.size());
+	}
+
+	FileStream fs;
+	ASSERT_TRUE(fs.Open(file_name.c_str(), fmOpenRead | fmShareDenyNone));
+	std::string data = fs.ReadAll();
+	fs.Close();
+	os::FileDelete(file_name.c_str());
+	ASSERT_EQ(data.size(), image.size());
+	EXPECT_TRUE(memcmp(data.data(), image.data(), image.size()) == 0);
+}
+
+static uint64_t WriteSyscallCount()
+{
+	uint64_t res = 0;
+#if defined(__unix__)
+	FILE *f = fopen("/proc/self/io", "r");
+	if (f) {
+		char line[100];
+		while (fgets(line, sizeof(line), f)) {
+			unsigned long long value;
+			if (sscanf(line, "syscw: %llu", &value) == 1)
+				res = value;
+		}
+		fclose(f);
+	}
+#endif
+	return res;
+}
+
+static void SaveTestImage(const std::string &file_name, uint64_t image_size, size_t write_behind_size)
+{
+	// the image is written like Save does it: section data by small pieces and a patch of the header after every section
+	const size_t section_size = 0x10000;
+	std::vector<uint8_t> buf(0x200, 0xCC);
+
+	FileStream fs;
+	ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenReadWrite));
+	fs.set_write_behind(write_behind_size);
+	fs.Write(buf.data(), 0x1000 - buf.size());
+	for (uint64_t pos = 0x1000; pos < image_size; pos += section_size) {
+		for (size_t i = 0; i < section_size; i += buf.size()) {
+			fs.Write(buf.data(), buf.size());
+		}
+		uint32_t value = static_cast<uint32_t>(pos);
+		fs.Seek((pos >> 16) % 0x400 * sizeof(value), soBeginning);
+		fs.Write(&value, sizeof(value));
+		fs.Seek(0, soEnd);
+	}
+}
+
+static std::string ReadTestImage(const std::string &file_name)
+{
+	FileStream fs;
+	if (!fs.Open(file_name.c_str(), fmOpenRead | fmShareDenyNone))
+		return std::string();
+	return fs.ReadAll();
+}
+
+TEST(FileStreamTest, WriteBehindSyscalls)
+{
+	const uint64_t image_size = 0x1000000;
+	std::string file_name = os::GetTempFilePathName();
+
+	uint64_t syscall_count = WriteSyscallCount();
+	SaveTestImage(file_name, image_size, 0);
+	uint64_t cache_syscall_count = WriteSyscallCount() - syscall_count;
+	std::string cache_image = ReadTestImage(file_name);
+
+	syscall_count = WriteSyscallCount();
+	SaveTestImage(file_name, image_size, 0x100000);
+	uint64_t write_behind_syscall_count = WriteSyscallCount() - syscall_count;
+	std::string write_behind_image = ReadTestImage(file_name);
+	os::FileDelete(file_name.c_str());
+
+	ASSERT_FALSE(cache_image.empty());
+	EXPECT_TRUE(cache_image == write_behind_image);
+	// header patches must not flush the whole write-behind buffer
+	EXPECT_LE(write_behind_syscall_count * 8, cache_syscall_count);
+}
+
+static void WriteTestFile(const std::string &file_name, size_t size, uint32_t seed)
+{
+	FileStream fs;
+	ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenWrite));
+	std::vector<uint32_t> buf(0x40000);
+	for (size_t pos = 0; pos < size; ) {
+		for (size_t i = 0; i < buf.size(); i++) {
+			seed = seed * 1103515245 + 12345;
+			buf[i] = seed;
+		}
+		size_t n = std::min(size - pos, buf.size() * sizeof(uint32_t));
+		ASSERT_EQ(fs.Write(buf.data(), n), n);
+		pos += n;
+	}
+}
+
+static bool SameFiles(const std::string &file_name1, const std::string &file_name2)
+{
+	FileStream fs1, fs2;
+	if (!fs1.Open(file_name1.c_str(), fmOpenRead | fmShareDenyNone) || !fs2.Open(file_name2.c_str(), fmOpenRead | fmShareDenyNone))
+		return false;
+	if (fs1.Size() != fs2.Size())
+		return false;
+	std::vector<uint8_t> buf1(0x100000), buf2(0x100000);
+	for (;;) {
+		size_t n = fs1.Read(buf1.data(), buf1.size());
+		if (fs2.Read(buf2.data(), buf2.size()) != n || memcmp(buf1.data(), buf2.data(), n) != 0)
+			return false;
+		if (n < buf1.size())
+			return true;
+	}
+}
+
+TEST(FileStreamTest, CopyFrom)
+{
+	const size_t source_size = 0x123456;
+	std::string source_name = os::GetTempFilePathName();
+	std::string file_name = os::GetTempFilePathName();
+	WriteTestFile(source_name, source_size, 1);
+
+	std::vector<uint8_t> source_image(source_size);
+	std::vector<uint8_t> image;
+	{
+		FileStream source;
+		ASSERT_TRUE(source.Open(source_name.c_str(), fmOpenRead | fmShareDenyNone));
+		ASSERT_EQ(source.Read(source_image.data(), source_size), source_size);
+
+		FileStream fs;
+		ASSERT_TRUE(fs.Open(file_name.c_str(), fmCreate | fmOpenReadWrite));
+		fs.set_write_behind(0x1000);
+		uint32_t seed = 1;
+		uint64_t pos = 0;
+		for (size_t i = 0; i < 200; i++) {
+			seed = seed * 1103515245 + 12345;
+			size_t value = seed >> 8;
+			// small copies go through the cache, large ones are copied by the kernel
+			size_t count = (value & 1) ? value % 0x100 : value % 0x40000;
+			size_t src_pos = (value >> 4) % (source_size + 0x10);
+			source.Seek(src_pos, soBeginning);
+			size_t expected = (src_pos < source_size) ? std::min(count, source_size - src_pos) : 0;
+			ASSERT_EQ(fs.CopyFrom(source, count), expected);
+			ASSERT_EQ(source.Tell(), src_pos + expected);
+			if (image.size() < pos + expected)
+				image.resize(static_cast<size_t>(pos + expected));
+			if (expected)
+				memcpy(&image[static_cast<size_t>(pos)], &source_image[src_pos], expected);
+			pos += expected;
+			ASSERT_EQ(fs.Tell(), pos);
+
+			// patch the copied data like Save does with headers
+			if (value & 2) {
+				uint32_t patch = seed;
+				pos = (value >> 8) % (image.size() + 1);
+				fs.Seek(pos, soBeginning);
+				fs.Write(&patch, sizeof(patch));
+				if (image.size() < pos + sizeof(patch))
+					image.resize(static_cast<size_t>(pos + sizeof(patch)));
+				memcpy(&image[static_cast<size_t>(pos)], &patch, sizeof(patch));
+				pos = fs.Seek(0, soEnd);
+				ASSERT_EQ(pos, image.size());
+			}
+		}
+		ASSERT_EQ(fs.Size(), image.size());
+	}
+
+	FileStream fs;
+	ASSERT_TRUE(fs.Open(file_name.c_str(), fmOpenRead | fmShareDenyNone));
+	std::string data = fs.ReadAll();
+	fs.Close();
+	os::FileDelete(file_name.c_str());
+	os::FileDelete(source_name.c_str());
+	ASSERT_EQ(data.size(), image.size());
+	EXPECT_TRUE(memcmp(data.data(), image.data(), image.size()) == 0);
+}
+
+TEST(FileStreamTest, DISABLED_CopyFromBenchmark)
+{
+	const size_t source_size = 0x10000000;
+	std::string source_name = os::GetTempFilePathName();
+	std::string buffered_name = os::GetTempFilePathName();
+	std::string file_name = os::GetTempFilePathName();
+	WriteTestFile(source_name, source_size, 1);
+
+	// the input file is copied to a temporary one before loading
+	uint32_t time = os::GetTickCount();
+	ASSERT_TRUE(os::FileCopy(source_name.c_str(), file_name.c_str()));
+	uint32_t file_copy_time = os::GetTickCount() - time;
+	EXPECT_TRUE(SameFiles(source_name, file_name));
+
+	// the output file is assembled from large pieces of the input one
+	uint32_t copy_time[2];
+	for (size_t i = 0; i < _countof(copy_time); i++) {
+		time = os::GetTickCount();
+		{
+			FileStream source;
+			ASSERT_TRUE(source.Open(source_name.c_str(), fmOpenRead | fmShareDenyNone));
+			FileStream fs;
+			ASSERT_TRUE(fs.Open((i == 0) ? buffered_name.c_str() : file_name.c_str(), fmCreate | fmOpenReadWrite));
+			fs.set_write_behind(0x100000);
+			uint32_t value = 0;
+			for (size_t pos = 0; pos < source_size; pos += 0x1000000) {
+				if (i == 0)
+					fs.AbstractStream::CopyFrom(source, 0x1000000 - sizeof(value));
+				else
+					fs.CopyFrom(source, 0x1000000 - sizeof(value));
+				fs.Write(&value, sizeof(value));
+				source.Seek(sizeof(value), soCurrent);
+				value++;
+			}
+		}
+		copy_time[i] = os::GetTickCount() - time;
+	}
+	EXPECT_TRUE(SameFiles(buffered_name, file_name));
+
+	os::FileDelete(file_name.c_str());
+	os::FileDelete(buffered_name.c_str());
+	os::FileDelete(source_name.c_str());
+
+	std::cout << "FileCopy:          " << file_copy_time << " ms" << std::endl;
+	std::cout << "Buffered CopyFrom: " << copy_time[0] << " ms" << std::endl;
+	std::cout << "Kernel CopyFrom:   " << copy_time[1] << " ms" << std::endl;
+}
@@ -88,3 +88,57 @@ TEST(ILTest, DisasmSmoke)
 		}
 	}*/
 }
+
+class TestILFunction : public ILFunction
+{
+public:
+	TestILFunction() : ILFunction(NULL, osDWord) {}
+	using ILFunction::CalcStack;
+};
+
+TEST(ILTest, CalcStackLargeMethod)
+{
+	const size_t block_count = 2500;
+	const int block_stack[] = {0, 1, 2, 1, 2, 1, 0, 0};
+	size_t i;
+
+	// one straight-line method of 20k instructions with a conditional branch into the middle of another block in every block
+	TestILFunction func;
+	std::vector<ILCommand *> branch_list;
+	for (i = 0; i < block_count; i++) {
+		func.AddCommand(icLdc_i4, i);
+		func.AddCommand(icLdc_i4, 1);
+		func.AddCommand(icAdd, 0);
+		func.AddCommand(icDup, 0);
+		branch_list.push_back(func.AddCommand(icBrtrue, 0));
+		func.AddCommand(icPop, 0);
+		func.AddCommand(icNop, 0);
+		func.AddCommand(icNop, 0);
+	}
+	func.AddCommand(icRet, 0);
+	for (i = 0; i < block_count; i++) {
+		size_t target_block = (i * 7919 + 13) % block_count;
+		branch_list[i]->AddLink(0, ltJmpWithFlag, func.item(target_block * _countof(block_stack) + 3));
+	}
+	// the entry point
+	func.AddCommand(icNop, 0)->AddLink(0, ltFinallyBlock, func.item(0));
+	ASSERT_EQ(func.count(), block_count * _countof(block_stack) + 2);
+
+	std::vector<int> stack_list;
+	func.CalcStack(stack_list);
+
+	ASSERT_EQ(stack_list.size(), func.count());
+	for (i = 0; i < block_count * _countof(block_stack); i++) {
+		ASSERT_EQ(stack_list[i], block_stack[i % _countof(block_stack)]) << i;
+	}
+	EXPECT_EQ(stack_list[block_count * _countof(block_stack)], 0);
+
+	// a branch that reaches the entry point with a different stack
+	TestILFunction bad_func;
+	bad_func.AddCommand(icLdc_i4, 1);
+	bad_func.AddCommand(icLdc_i4, 1);
+	bad_func.AddCommand(icBrtrue, 0)->AddLink(0, ltJmpWithFlag, bad_func.item(0));
+	bad_func.AddCommand(icRet, 0);
+	bad_func.AddCommand(icNop, 0)->AddLink(0, ltFinallyBlock, bad_func.item(0));
+	EXPECT_THROW(bad_func.CalcStack(stack_list), std::runtime_error);
+}
@@ -500,6 +500,76 @@ TEST(IntelTest, Clone)
 	delete clone_function_list;
 }
 
+TEST(IntelTest, AddByAddressList)
+{
+	PEFile pf(NULL);
+	PEFile pf_list(NULL);
+
+	ASSERT_EQ(pf.Open("test-binaries/win32-app-test1-i386", foRead), osSuccess);
+	ASSERT_EQ(pf_list.Open("test-binaries/win32-app-test1-i386", foRead), osSuccess);
+	IArchitecture *arch = pf.item(0);
+	IArchitecture *arch_list = pf_list.item(0);
+	std::vector<FunctionLoadInfo> info_list;
+	for (size_t i = 0; i < arch->map_function_list()->count(); i++) {
+		MapFunction *map_function = arch->map_function_list()->item(i);
+		if (map_function->type() != otCode)
+			continue;
+		arch->function_list()->AddByAddress(map_function->address(), ctVirtualization, 0, true, NULL);
+		info_list.push_back(FunctionLoadInfo(map_function->address(), ctVirtualization, 0, true, NULL));
+	}
+	// duplicate addresses must not create new functions
+	info_list.push_back(info_list[0]);
+	std::vector<IFunction *> added_list = arch_list->function_list()->AddByAddressList(info_list);
+	ASSERT_EQ(added_list.size(), info_list.size());
+	for (size_t i = 0; i < info_list.size(); i++) {
+		if (added_list[i])
+			EXPECT_EQ(added_list[i]->address(), info_list[i].address) << "i=" << i;
+	}
+	EXPECT_EQ(added_list.front(), added_list.back());
+	// Functions read by the parallel path must be identical to the sequential ones.
+	ASSERT_EQ(arch->function_list()->count(), arch_list->function_list()->count());
+	for (size_t i = 0; i < arch->function_list()->count(); i++) {
+		IFunction *func = arch->function_list()->item(i);
+		IFunction *func_list = arch_list->function_list()->item(i);
+		EXPECT_EQ(func->address(), func_list->address()) << "i=" << i;
+		ASSERT_EQ(func->count(), func_list->count()) << "i=" << i;
+		EXPECT_EQ(func->link_list()->count(), func_list->link_list()->count()) << "i=" << i;
+		for (size_t j = 0; j < func->count(); j++) {
+			EXPECT_EQ(func->item(j)->address(), func_list->item(j)->address());
+			EXPECT_EQ(func->item(j)->text(), func_list->item(j)->text());
+		}
+	}
+	EXPECT_EQ(arch->compiler_function_list()->count(), arch_list->compiler_function_list()->count());
+}
+
+TEST(IntelTest, AddByAddressListIsDeterministic)
+{
+	// compiler functions found by the workers must not depend on the way the functions were distributed
+	std::vector<std::pair<uint64_t, uint32_t> > expected_list;
+	for (size_t n = 0; n < 3; n++) {
+		PEFile pf(NULL);
+		ASSERT_EQ(pf.Open("test-binaries/win32-app-test1-i386", foRead), osSuccess);
+		IArchitecture *arch = pf.item(0);
+		std::vector<FunctionLoadInfo> info_list;
+		for (size_t i = 0; i < arch->map_function_list()->count(); i++) {
+			MapFunction *map_function = arch->map_function_list()->item(i);
+			if (map_function->type() == otCode)
+				info_list.push_back(FunctionLoadInfo(map_function->address(), ctVirtualization, 0, true, NULL));
+		}
+		arch->function_list()->AddByAddressList(info_list);
+
+		std::vector<std::pair<uint64_t, uint32_t> > compiler_function_list;
+		for (size_t i = 0; i < arch->compiler_function_list()->count(); i++) {
+			CompilerFunction *compiler_function = arch->compiler_function_list()->item(i);
+			compiler_function_list.push_back(std::make_pair(compiler_function->address(), compiler_function->options()));
+		}
+		if (n == 0)
+			expected_list = compiler_function_list;
+		else
+			EXPECT_TRUE(compiler_function_list == expected_list);
+	}
+}
+
 TEST(IntelTest, x86_Switch)
 {
 	uint8_t buf[] = {
@@ -1171,6 +1241,343 @@ TEST(IntelTest, x86_DisasmBranch4)
 	ASSERT_EQ(func->count(), 13ul);
 }
 
+static void GetFreeRegistersByScan(const IntelFunction &func, size_t index, CommandInfoList &free_registr_list)
+{
+	CommandInfoList used_registr_list;
+	IntelCommandInfoList command_info_list(func.cpu_address_size());
+
+	uint16_t free_flags = 0;
+	bool free_flags_extracted = false;
+	free_registr_list.clear();
+	for (size_t i = index; i < func.count(); i++) {
+		if (!func.item(i)->GetCommandInfo(command_info_list))
+			break;
+
+		if (!free_flags_extracted) {
+			if (command_info_list.change_flags()) {
+				free_flags = command_info_list.change_flags();
+				free_flags_extracted = true;
+			}
+			if (command_info_list.need_flags()) {
+				free_flags &= ~command_info_list.need_flags();
+				free_flags_extracted = true;
+			}
+		}
+
+		for (size_t j = 0; j < command_info_list.count(); j++) {
+			CommandInfo *command_info = command_info_list.item(j);
+			if ((command_info->operand_type() == otRegistr || command_info->operand_type() == otHiPartRegistr) && command_info->value() != regESP && command_info->value() != regEIP) {
+				OperandSize reg_size = command_info->size();
+				if (command_info->operand_type() == otHiPartRegistr)
+					reg_size = (reg_size == osByte) ? osWord : osQWord;
+				uint8_t reg = command_info->value();
+
+				if (command_info->type() == atRead) {
+					used_registr_list.Add(atRead, reg, otRegistr, reg_size);
+				} else if (!used_registr_list.GetInfo(atRead, otRegistr, reg) && (command_info->operand_type() != otHiPartRegistr || free_registr_list.GetInfo(atWrite, otRegistr, reg))) {
+					free_registr_list.Add(atWrite, reg, otRegistr, reg_size);
+				}
+			}
+		}
+		if (command_info_list.GetInfo(atWrite, otBaseRegistr, regEIP))
+			break;
+	}
+	free_registr_list.set_change_flags(free_flags);
+}
+
+/**
+ * Fills the function with one long straight-line block of register moves and arithmetic.
+ */
+static void AddRegisterCommands(IntelFunction &func, size_t command_count)
+{
+	uint32_t seed = 1;
+	for (size_t i = 0; i < command_count; i++) {
+		seed = seed * 1103515245 + 12345;
+		uint8_t dst = (seed >> 8) % 16;
+		uint8_t src = (seed >> 12) % 16;
+		if (dst == regESP)
+			dst = regEBP;
+		switch ((seed >> 16) % 8) {
+		case 0:
+			func.AddCommand(cmMov, IntelOperand(otRegistr, osQWord, dst), IntelOperand(otRegistr, osQWord, src));
+			break;
+		case 1:
+			func.AddCommand(cmMov, IntelOperand(otRegistr, osDWord, dst), IntelOperand(otValue, osDWord, 0, seed));
+			break;
+		case 2:
+			func.AddCommand(cmAdd, IntelOperand(otRegistr, osQWord, dst), IntelOperand(otRegistr, osQWord, src));
+			break;
+		case 3:
+			func.AddCommand(cmMov, IntelOperand(otRegistr, osByte, dst), IntelOperand(otMemory | otRegistr, osByte, src));
+			break;
+		case 4:
+			func.AddCommand(cmMov, IntelOperand(otHiPartRegistr, osByte, dst & 3), IntelOperand(otRegistr, osByte, src & 3));
+			break;
+		case 5:
+			func.AddCommand(cmMovzx, IntelOperand(otRegistr, osDWord, dst), IntelOperand(otRegistr, osWord, src));
+			break;
+		case 6:
+			func.AddCommand(cmCmp, IntelOperand(otRegistr, osDWord, dst), IntelOperand(otRegistr, osDWord, src));
+			break;
+		default:
+			func.AddCommand(cmAdc, IntelOperand(otRegistr, osWord, dst), IntelOperand(otValue, osWord, 0, 1));
+			break;
+		}
+	}
+	func.AddCommand(cmRet);
+}
+
+TEST(IntelTest, GetFreeRegisters)
+{
+	const size_t scan_count = 100;
+	size_t i, j;
+
+	IntelFunction func(NULL, osQWord);
+	AddRegisterCommands(func, 2000);
+
+	std::vector<IntelFreeRegisters> free_registr_list;
+	func.GetFreeRegisters(free_registr_list);
+	ASSERT_EQ(free_registr_list.size(), func.count() + 1);
+
+	// the backward pass must give the same result as a forward scan from every command
+	CommandInfoList scan_list;
+	for (i = 0; i < scan_count; i++) {
+		size_t index = i * func.count() / scan_count;
+		GetFreeRegistersByScan(func, index, scan_list);
+
+		const IntelFreeRegisters &free_registers = free_registr_list[index];
+		EXPECT_EQ(free_registers.flags, scan_list.change_flags());
+		for (uint8_t reg = 0; reg < 16; reg++) {
+			bool is_free = false;
+			OperandSize size = osByte;
+			for (j = 0; j < scan_list.count(); j++) {
+				CommandInfo *command_info = scan_list.item(j);
+				if (command_info->value() != reg)
+					continue;
+				if (!is_free || size < command_info->size())
+					size = command_info->size();
+				is_free = true;
+			}
+			ASSERT_EQ(free_registers.is_free(reg), is_free) << index;
+			if (is_free)
+				EXPECT_EQ(free_registers.size(reg), size) << index;
+		}
+	}
+}
+
+TEST(IntelTest, DISABLED_GetFreeRegistersBenchmark)
+{
+	const size_t scan_count = 100;
+
+	IntelFunction func(NULL, osQWord);
+	AddRegisterCommands(func, 50000);
+
+	std::vector<IntelFreeRegisters> free_registr_list;
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	func.GetFreeRegisters(free_registr_list);
+	uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	CommandInfoList scan_list;
+	start_time = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < scan_count; i++) {
+		GetFreeRegistersByScan(func, i * func.count() / scan_count, scan_list);
+	}
+	uint64_t scan_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	std::cout << "Backward pass: " << time << " us for " << func.count() << " commands" << std::endl;
+	std::cout << "Forward scans: " << scan_time << " us for " << scan_count << " of " << func.count() << " commands" << std::endl;
+}
+
+static bool IsSuitableByCommandInfo(IntelCommand *command, OperandSize cpu_address_size, const IntelFreeRegisters &free_registers)
+{
+	// the filter Mutate used before the template catalogue
+	IntelCommandInfoList command_info_list(cpu_address_size);
+	if (!command->GetCommandInfo(command_info_list))
+		return false;
+
+	for (size_t k = 0; k < command_info_list.count(); k++) {
+		CommandInfo *command_info = command_info_list.item(k);
+		if (command_info->type() == atWrite && (command_info->operand_type() == otRegistr || command_info->operand_type() == otHiPartRegistr)) {
+			if (command_info->value() == IntelCommandTemplate::regFree) {
+				if (free_registers.empty())
+					return false;
+			} else if (command_info->value() == regEFX) {
+				if ((command_info_list.change_flags() & free_registers.flags) != command_info_list.change_flags())
+					return false;
+			} else {
+				OperandSize registr_size;
+				if (command_info->operand_type() == otHiPartRegistr) {
+					switch (command_info->size()) {
+					case osByte:
+						registr_size = osWord;
+						break;
+					case osWord:
+						registr_size = osDWord;
+						break;
+					default:
+						registr_size = osQWord;
+						break;
+					}
+				} else {
+					registr_size = command_info->size();
+				}
+
+				if (!free_registers.is_free(command_info->value(), registr_size))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+TEST(IntelTest, MutationTemplates)
+{
+	const size_t sample_count = 2000;
+	size_t i, j, k;
+
+	for (size_t mode = 0; mode < 4; mode++) {
+		OperandSize cpu_address_size = (mode & 1) ? osQWord : osDWord;
+		bool for_virtualization = (mode & 2) != 0;
+
+		std::vector<IntelCommand *> command_list;
+		IntelCommandTemplate::CreateCommands(cpu_address_size, for_virtualization, command_list);
+		const std::vector<IntelCommandTemplate> &template_list = IntelFunction::GetMutationTemplates(cpu_address_size, for_virtualization);
+		ASSERT_FALSE(template_list.empty());
+
+		uint32_t seed = static_cast<uint32_t>(mode + 1);
+		for (i = 0; i < sample_count; i++) {
+			IntelFreeRegisters free_registers;
+			if (i == 1) {
+				// everything is free
+				for (uint8_t reg = 0; reg < ((cpu_address_size == osQWord) ? 16 : 8); reg++) {
+					free_registers.Add(reg, cpu_address_size);
+				}
+				free_registers.flags = 0xffff;
+			} else if (i > 1) {
+				for (uint8_t reg = 0; reg < ((cpu_address_size == osQWord) ? 16 : 8); reg++) {
+					seed = seed * 1103515245 + 12345;
+					if ((seed >> 16) & 1)
+						free_registers.Add(reg, static_cast<OperandSize>((seed >> 20) % (cpu_address_size + 1)));
+				}
+				seed = seed * 1103515245 + 12345;
+				free_registers.flags = static_cast<uint16_t>(seed >> 16);
+			}
+
+			std::vector<IntelCommand *> expected_list;
+			for (j = 0; j < command_list.size(); j++) {
+				if (IsSuitableByCommandInfo(command_list[j], cpu_address_size, free_registers))
+					expected_list.push_back(command_list[j]);
+			}
+			std::vector<const IntelCommandTemplate *> suitable_list;
+			for (j = 0; j < template_list.size(); j++) {
+				if (template_list[j].is_suitable(free_registers))
+					suitable_list.push_back(&template_list[j]);
+			}
+
+			ASSERT_EQ(suitable_list.size(), expected_list.size()) << "mode " << mode << ", sample " << i;
+			for (j = 0; j < expected_list.size(); j++) {
+				IntelCommand *command = expected_list[j];
+				const IntelCommandTemplate *command_template = suitable_list[j];
+				ASSERT_EQ(static_cast<uint16_t>(command_template->type), command->type()) << "mode " << mode << ", sample " << i;
+				ASSERT_EQ(command_template->flags, command->flags()) << "mode " << mode << ", sample " << i;
+				for (k = 0; k < _countof(command_template->operand); k++) {
+					ASSERT_TRUE(command_template->operand[k] == command->operand(k)) << "mode " << mode << ", sample " << i;
+				}
+			}
+		}
+
+		for (j = 0; j < command_list.size(); j++) {
+			delete command_list[j];
+		}
+	}
+}
+
+static CommandLink *GetLinkByScan(const CommandLinkList &link_list, LinkType type, uint64_t to_address)
+{
+	for (size_t i = 0; i < link_list.count(); i++) {
+		CommandLink *link = link_list.item(i);
+		if (link->to_address() == to_address && (type == ltNone || link->type() == type))
+			return link;
+	}
+	return NULL;
+}
+
+/**
+ * Adds links of a jump table where every case is reached by several entries and some cases by a jmp as well.
+ */
+static void AddJumpTableLinks(IntelFunction &func, size_t link_count, size_t case_count, uint64_t case_address)
+{
+	for (size_t i = 0; i < link_count; i++) {
+		uint64_t to_address = case_address + ((i * 7) % case_count) * 0x10;
+		IntelCommand *command = func.AddCommand(osDWord, to_address);
+		command->AddLink(0, (i % 10) ? ltCase : ltJmp, to_address);
+	}
+}
+
+TEST(IntelTest, GetLinkByToAddress)
+{
+	const size_t link_count = 10000;
+	const size_t case_count = 2000;
+	const size_t scan_count = 1000;
+	const uint64_t case_address = 0x00401000;
+	size_t i;
+
+	IntelFunction func(NULL, osDWord);
+	AddJumpTableLinks(func, link_count, case_count, case_address);
+	CommandLinkList *link_list = func.link_list();
+	ASSERT_EQ(link_list->count(), link_count);
+
+	for (i = 0; i < scan_count; i++) {
+		CommandLink *link = link_list->item(i * link_count / scan_count);
+		ASSERT_EQ(link_list->GetLinkByToAddress(ltNone, link->to_address()), GetLinkByScan(*link_list, ltNone, link->to_address()));
+		ASSERT_EQ(link_list->GetLinkByToAddress(ltJmp, link->to_address()), GetLinkByScan(*link_list, ltJmp, link->to_address()));
+	}
+
+	// the index must follow deletion and rebasing
+	for (i = link_count; i > link_count - 3000; i--) {
+		if (i % 3 == 0)
+			delete link_list->item(i - 1);
+	}
+	link_list->Rebase(0x10000);
+	EXPECT_TRUE(link_list->GetLinkByToAddress(ltNone, case_address) == NULL);
+	for (i = 0; i < scan_count; i++) {
+		uint64_t to_address = case_address + 0x10000 + (i * 13 % case_count) * 0x10;
+		ASSERT_EQ(link_list->GetLinkByToAddress(ltNone, to_address), GetLinkByScan(*link_list, ltNone, to_address));
+		ASSERT_EQ(link_list->GetLinkByToAddress(ltCase, to_address), GetLinkByScan(*link_list, ltCase, to_address));
+		ASSERT_EQ(link_list->GetLinkByToAddress(ltJmp, to_address), GetLinkByScan(*link_list, ltJmp, to_address));
+	}
+}
+
+TEST(IntelTest, DISABLED_GetLinkByToAddressBenchmark)
+{
+	const size_t link_count = 100000;
+	const size_t scan_count = 1000;
+	size_t i;
+
+	IntelFunction func(NULL, osDWord);
+	AddJumpTableLinks(func, link_count, 20000, 0x00401000);
+	CommandLinkList *link_list = func.link_list();
+
+	size_t found_count = 0;
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	for (i = 0; i < link_count; i++) {
+		if (link_list->GetLinkByToAddress(ltJmp, link_list->item(i)->to_address()))
+			found_count++;
+	}
+	uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	size_t scan_found_count = 0;
+	start_time = std::chrono::steady_clock::now();
+	for (i = 0; i < scan_count; i++) {
+		if (GetLinkByScan(*link_list, ltJmp, link_list->item(i * link_count / scan_count)->to_address()))
+			scan_found_count++;
+	}
+	uint64_t scan_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+	std::cout << "Indexed: " << time / link_count << " ns per lookup, " << found_count << " found" << std::endl;
+	std::cout << "Scan:    " << scan_time / scan_count << " ns per lookup, " << scan_found_count << " found" << std::endl;
+}
+
 #ifdef _WIN32
 void CompileFunction(void *src, void *dest)
 {
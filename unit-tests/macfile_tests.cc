@@ -6,6 +6,7 @@
 #include "../core/core.h"
 #include "../core/files.h"
 #include "../core/processors.h"
+#include "../core/dwarf.h"
 #include "../core/macfile.h"
 #include "../core/mac_runtime32.dylib.inc"
 #include "../core/mac_runtime64.dylib.inc"
@@ -237,6 +238,302 @@ TEST(MacFileTest, Runtime_x64)
 	EXPECT_GT(arch->function_list()->count(), 0ul);
 }
 
+TEST(MacFixupListTest, WriteRebaseInfo)
+{
+	MacFile file(NULL);
+
+	ASSERT_TRUE(file.OpenResource(mac_runtime64_dylib_file, sizeof(mac_runtime64_dylib_file), true));
+	MacArchitecture *arch = file.item(0);
+	ASSERT_TRUE(arch->dyld_info()->cmd != 0);
+	MacSegment *segment = arch->segment_list()->GetSectionByName(SEG_DATA);
+	ASSERT_TRUE(segment != NULL);
+	ASSERT_GE(segment->size(), 0x400ull);
+
+	// contiguous pointers, a pair, strided runs and a backward jump after the type change
+	const struct {
+		uint64_t offset;
+		size_t count;
+		size_t step;
+		bool is_code;
+	} runs[] = {
+		{0x100, 6, 0x08, false},
+		{0x200, 2, 0x10, false},
+		{0x300, 5, 0x18, false},
+		{0x3a0, 3, 0x20, false},
+		{0x080, 3, 0x10, true}
+	};
+	size_t i, j;
+	MacFixupList *fixup_list = arch->fixup_list();
+	fixup_list->clear();
+	std::vector<std::pair<uint8_t, uint64_t> > expected;
+	for (i = 0; i < _countof(runs); i++) {
+		for (j = 0; j < runs[i].count; j++) {
+			MacFixup *fixup = fixup_list->AddDefault(osQWord, runs[i].is_code);
+			fixup->set_address(segment->address() + runs[i].offset + j * runs[i].step);
+			expected.push_back(std::make_pair(fixup->bind_type(), fixup->address()));
+		}
+	}
+	std::sort(expected.begin(), expected.end());
+
+	uint64_t pos = arch->size();
+	arch->Resize(pos + 0x1000);
+	arch->Seek(pos);
+	fixup_list->WriteToFile(*arch);
+	// 28 bytes of opcodes padded to the pointer size
+	EXPECT_EQ(arch->dyld_info()->rebase_size, 32u);
+
+	MacFixupList read_list;
+	read_list.ReadFromFile(*arch);
+	ASSERT_EQ(read_list.count(), expected.size());
+	for (i = 0; i < read_list.count(); i++) {
+		MacFixup *fixup = read_list.item(i);
+		EXPECT_EQ(fixup->bind_type(), expected[i].first);
+		EXPECT_EQ(fixup->address(), expected[i].second);
+	}
+}
+
+typedef std::tuple<int, std::string, uint8_t, int64_t, uint64_t> BindEntry;
+
+static std::vector<BindEntry> ReadBindStream(MacArchitecture &arch, uint32_t offset, uint32_t size)
+{
+	std::vector<BindEntry> res;
+	if (!size)
+		return res;
+
+	EncodedData data;
+	arch.Seek(offset);
+	data.ReadFromFile(arch, size);
+	uint64_t ptr_size = OperandSizeToValue(arch.cpu_address_size());
+	int library_ordinal = 0;
+	std::string name;
+	uint8_t type = 0;
+	int64_t addend = 0;
+	uint64_t address = 0;
+	uint64_t count, skip;
+	for (size_t pos = 0; pos < data.size(); ) {
+		uint8_t b = data.ReadByte(&pos);
+		uint8_t imm = b & BIND_IMMEDIATE_MASK;
+		switch (b & BIND_OPCODE_MASK) {
+		case BIND_OPCODE_DONE:
+			return res;
+		case BIND_OPCODE_SET_DYLIB_ORDINAL_IMM:
+			library_ordinal = imm;
+			break;
+		case BIND_OPCODE_SET_DYLIB_ORDINAL_ULEB:
+			library_ordinal = static_cast<int>(data.ReadUleb128(&pos));
+			break;
+		case BIND_OPCODE_SET_DYLIB_SPECIAL_IMM:
+			library_ordinal = imm ? static_cast<int8_t>(BIND_OPCODE_MASK | imm) : 0;
+			break;
+		case BIND_OPCODE_SET_SYMBOL_TRAILING_FLAGS_IMM:
+			name = data.ReadString(&pos);
+			break;
+		case BIND_OPCODE_SET_TYPE_IMM:
+			type = imm;
+			break;
+		case BIND_OPCODE_SET_ADDEND_SLEB:
+			addend = data.ReadSleb128(&pos);
+			break;
+		case BIND_OPCODE_SET_SEGMENT_AND_OFFSET_ULEB:
+			address = arch.segment_list()->item(imm)->address() + data.ReadUleb128(&pos);
+			break;
+		case BIND_OPCODE_ADD_ADDR_ULEB:
+			address += data.ReadUleb128(&pos);
+			break;
+		case BIND_OPCODE_DO_BIND:
+			res.push_back(BindEntry(library_ordinal, name, type, addend, address));
+			address += ptr_size;
+			break;
+		case BIND_OPCODE_DO_BIND_ADD_ADDR_ULEB:
+			res.push_back(BindEntry(library_ordinal, name, type, addend, address));
+			address += data.ReadUleb128(&pos) + ptr_size;
+			break;
+		case BIND_OPCODE_DO_BIND_ADD_ADDR_IMM_SCALED:
+			res.push_back(BindEntry(library_ordinal, name, type, addend, address));
+			address += (imm + 1) * ptr_size;
+			break;
+		case BIND_OPCODE_DO_BIND_ULEB_TIMES_SKIPPING_ULEB:
+			count = data.ReadUleb128(&pos);
+			skip = data.ReadUleb128(&pos);
+			for (uint64_t i = 0; i < count; i++) {
+				res.push_back(BindEntry(library_ordinal, name, type, addend, address));
+				address += skip + ptr_size;
+			}
+			break;
+		default:
+			ADD_FAILURE() << "Invalid bind opcode " << static_cast<int>(b);
+			return res;
+		}
+	}
+	return res;
+}
+
+/**
+ * Adds binds of the runtime's weak operator new in runs like WriteRebaseInfo does,
+ * then writes the import list and returns the binds each stream has to contain.
+ */
+static void WriteBindTestImports(MacFile &file, std::vector<BindEntry> &bind_list, std::vector<BindEntry> &weak_bind_list)
+{
+	ASSERT_TRUE(file.OpenResource(mac_runtime64_dylib_file, sizeof(mac_runtime64_dylib_file), true));
+	MacArchitecture *arch = file.item(0);
+	ASSERT_TRUE(arch->dyld_info()->cmd != 0);
+	MacSegment *segment = arch->segment_list()->GetSectionByName(SEG_DATA);
+	ASSERT_TRUE(segment != NULL);
+	ASSERT_GE(segment->size(), 0x1000ull);
+
+	size_t i, j;
+	MacImportList *import_list = arch->import_list();
+	MacImportFunction *weak_func = NULL;
+	for (i = 0; i < import_list->count(); i++) {
+		MacImport *import = import_list->item(i);
+		for (j = 0; j < import->count(); j++) {
+			MacImportFunction *import_func = import->item(j);
+			if (import_func->name() == "__Znwm" && !import_func->is_lazy())
+				weak_func = import_func;
+		}
+	}
+	ASSERT_TRUE(weak_func != NULL);
+	ASSERT_TRUE(weak_func->is_weak());
+
+	// contiguous pointers, a pair, strided runs with an addend change and a backward jump after the type change
+	const struct {
+		uint64_t offset;
+		size_t count;
+		size_t step;
+		uint8_t bind_type;
+		int64_t addend;
+	} runs[] = {
+		{0x400, 6, 0x08, BIND_TYPE_POINTER, 0},
+		{0x500, 2, 0x10, BIND_TYPE_POINTER, 0},
+		{0x600, 5, 0x18, BIND_TYPE_POINTER, 0},
+		{0x700, 3, 0x20, BIND_TYPE_POINTER, 0x10},
+		{0x800, 4, 0x28, BIND_TYPE_POINTER, 0},
+		{0x480, 3, 0x10, BIND_TYPE_TEXT_ABSOLUTE32, 0}
+	};
+	MacImport *import = reinterpret_cast<MacImport *>(weak_func->owner());
+	for (i = 0; i < _countof(runs); i++) {
+		for (j = 0; j < runs[i].count; j++) {
+			import->Add(segment->address() + runs[i].offset + j * runs[i].step, runs[i].bind_type, 0, weak_func->name(), weak_func->flags(), runs[i].addend, false, weak_func->symbol());
+		}
+	}
+
+	bind_list.clear();
+	weak_bind_list.clear();
+	for (i = 0; i < import_list->count(); i++) {
+		import = import_list->item(i);
+		for (j = 0; j < import->count(); j++) {
+			MacImportFunction *import_func = import->item(j);
+			if (import_func->is_lazy())
+				continue;
+			bind_list.push_back(BindEntry(import_func->library_ordinal(), import_func->name(), import_func->bind_type(), import_func->addend(), import_func->address()));
+			// weak binds have no library ordinal
+			if (import_func->is_weak() && import_func->bind_type() != BIND_TYPE_OVERRIDE_OF_WEAKDEF_IN_DYLIB)
+				weak_bind_list.push_back(BindEntry(0, import_func->name(), import_func->bind_type(), import_func->addend(), import_func->address()));
+		}
+	}
+	std::sort(bind_list.begin(), bind_list.end());
+	std::sort(weak_bind_list.begin(), weak_bind_list.end());
+
+	uint64_t pos = arch->size();
+	arch->Resize(pos + 0x2000);
+	arch->Seek(pos);
+	import_list->WriteToFile(*arch);
+}
+
+TEST(MacImportListTest, WriteBindInfo)
+{
+	MacFile file(NULL);
+	std::vector<BindEntry> expected, weak_expected;
+	WriteBindTestImports(file, expected, weak_expected);
+	ASSERT_FALSE(HasFatalFailure());
+
+	MacArchitecture *arch = file.item(0);
+	std::vector<BindEntry> bind_list = ReadBindStream(*arch, arch->dyld_info()->bind_off, arch->dyld_info()->bind_size);
+	std::sort(bind_list.begin(), bind_list.end());
+	ASSERT_EQ(bind_list.size(), expected.size());
+	EXPECT_TRUE(bind_list == expected);
+}
+
+TEST(MacImportListTest, WriteWeakBindInfo)
+{
+	MacFile file(NULL);
+	std::vector<BindEntry> bind_expected, expected;
+	WriteBindTestImports(file, bind_expected, expected);
+	ASSERT_FALSE(HasFatalFailure());
+
+	MacArchitecture *arch = file.item(0);
+	std::vector<BindEntry> bind_list = ReadBindStream(*arch, arch->dyld_info()->weak_bind_off, arch->dyld_info()->weak_bind_size);
+	std::sort(bind_list.begin(), bind_list.end());
+	ASSERT_EQ(bind_list.size(), expected.size());
+	EXPECT_TRUE(bind_list == expected);
+}
+
+static void ReadExportTrie(const EncodedData &data, size_t pos, const std::string &name, std::map<std::string, uint64_t> &exports)
+{
+	size_t terminal_size = static_cast<size_t>(data.ReadUleb128(&pos));
+	size_t children_pos = pos + terminal_size;
+	if (terminal_size) {
+		data.ReadUleb128(&pos);
+		exports[name] = data.ReadUleb128(&pos);
+	}
+	size_t children_count = data[children_pos++];
+	for (size_t i = 0; i < children_count; i++) {
+		std::string children_name = name + data.ReadString(&children_pos);
+		ReadExportTrie(data, static_cast<size_t>(data.ReadUleb128(&children_pos)), children_name, exports);
+	}
+}
+
+TEST(MacExportListTest, WriteToData)
+{
+	// both tries were produced by ld64
+	const char *file_names[] = {
+		"test-binaries/exc-osx-x86",
+		"test-binaries/exc-osx-x64"
+	};
+
+	for (size_t i = 0; i < _countof(file_names); i++) {
+		MacFile mf(NULL);
+		ASSERT_EQ(mf.Open(file_names[i], foRead), osSuccess);
+		MacArchitecture *arch = mf.item(0);
+		dyld_info_command *dyld_info = arch->dyld_info();
+		ASSERT_NE(dyld_info->export_size, 0u);
+		ASSERT_EQ(arch->export_list()->count(), 3ul);
+
+		EncodedData original;
+		arch->Seek(dyld_info->export_off);
+		original.ReadFromFile(*arch, dyld_info->export_size);
+
+		EncodedData data;
+		arch->export_list()->WriteToData(data, arch->segment_list()->GetBaseSegment()->address());
+		data.resize(AlignValue(data.size(), OperandSizeToValue(arch->cpu_address_size())), 0);
+		EXPECT_TRUE(data == original) << file_names[i];
+	}
+}
+
+TEST(MacExportListTest, WriteSharedPrefixes)
+{
+	const size_t export_count = 10000;
+	const uint64_t base_address = 0x100000000ull;
+	size_t i;
+
+	// framework-like names sharing long prefixes, added in address order as ld64 does
+	MacExportList export_list(NULL);
+	std::map<std::string, uint64_t> expected;
+	for (i = 0; i < export_count; i++) {
+		std::string name = string_format("_OBJC_CLASS_$_Framework%dView%dController", static_cast<int>(i % 97), static_cast<int>(i));
+		uint64_t offset = 0x1000 + i * 0x10;
+		export_list.Add(base_address + offset, name, 0, 0);
+		expected[name] = offset;
+	}
+
+	EncodedData data;
+	export_list.WriteToData(data, base_address);
+
+	std::map<std::string, uint64_t> exports;
+	ReadExportTrie(data, 0, "", exports);
+	EXPECT_TRUE(exports == expected);
+}
+
 TEST(MacFileTest, Compile_x32)
 {
 	MacFile mf(NULL);
@@ -175,6 +175,133 @@ TEST(PEFileTest, Clone)
 	delete f;
 }
 
+static void TestAnalysisCache()
+{
+	PEFile pf(NULL);
+	ASSERT_EQ(pf.Open("test-binaries/win32-app-test1-i386", foRead), osSuccess);
+	PEArchitecture &src = *pf.arch_pe();
+
+	// Test: the first cached open stores the analysis, it should be restored into a file opened without analysis.
+	{
+		PEFile tmp(NULL);
+		ASSERT_EQ(tmp.Open("test-binaries/win32-app-test1-i386", foRead | foUseCache), osSuccess);
+	}
+	PEFile cached(NULL);
+	ASSERT_EQ(cached.Open("test-binaries/win32-app-test1-i386", foRead | foHeaderOnly), osSuccess);
+	PEArchitecture &dst = *cached.arch_pe();
+	std::vector<std::string> file_list;
+	file_list.push_back(dst.map_file_name());
+	file_list.push_back(dst.pdb_file_name());
+	AnalysisCache cache(&dst, file_list);
+	ASSERT_TRUE(cache.Load());
+
+	size_t i, j;
+	ASSERT_EQ(src.map_function_list()->count(), dst.map_function_list()->count());
+	for (i = 0; i < src.map_function_list()->count(); i++) {
+		MapFunction *src_func = src.map_function_list()->item(i);
+		MapFunction *dst_func = dst.map_function_list()->item(i);
+		EXPECT_EQ(src_func->address(), dst_func->address());
+		EXPECT_EQ(src_func->end_address(), dst_func->end_address());
+		EXPECT_EQ(src_func->type(), dst_func->type());
+		EXPECT_TRUE(src_func->full_name() == dst_func->full_name());
+		EXPECT_EQ(src_func->reference_list()->count(), dst_func->reference_list()->count());
+		EXPECT_EQ(dst.map_function_list()->GetFunctionByAddress(src_func->address())->address(), src.map_function_list()->GetFunctionByAddress(src_func->address())->address());
+	}
+	ASSERT_EQ(src.compiler_function_list()->count(), dst.compiler_function_list()->count());
+	for (i = 0; i < src.compiler_function_list()->count(); i++) {
+		EXPECT_EQ(src.compiler_function_list()->item(i)->type(), dst.compiler_function_list()->item(i)->type());
+		EXPECT_EQ(src.compiler_function_list()->item(i)->address(), dst.compiler_function_list()->item(i)->address());
+	}
+	EXPECT_EQ(src.end_marker_list()->count(), dst.end_marker_list()->count());
+	for (i = 0; i < src.import_list()->count(); i++) {
+		IImport *src_import = src.import_list()->item(i);
+		IImport *dst_import = dst.import_list()->item(i);
+		for (j = 0; j < src_import->count(); j++) {
+			ASSERT_TRUE(dst_import->item(j)->map_function() != NULL);
+			EXPECT_EQ(src_import->item(j)->map_function()->address(), dst_import->item(j)->map_function()->address());
+			EXPECT_EQ(src_import->item(j)->options(), dst_import->item(j)->options());
+		}
+	}
+
+	// Test: the key depends on contents only, the same image at another path finds the entry.
+	{
+		std::string copy_name = os::GetTempFilePathName();
+		ASSERT_TRUE(os::FileCopy("test-binaries/win32-app-test1-i386", copy_name.c_str()));
+		{
+			PEFile copy(NULL);
+			ASSERT_EQ(copy.Open(copy_name.c_str(), foRead | foHeaderOnly), osSuccess);
+			AnalysisCache copy_cache(copy.arch_pe(), file_list);
+			EXPECT_EQ(cache.file_name(), copy_cache.file_name());
+		}
+		EXPECT_TRUE(os::FileDelete(copy_name.c_str()));
+	}
+
+	// Test: symbol files with the same size and different contents give different keys.
+	{
+		std::string symbol_names[2];
+		std::string key_list[2];
+		for (i = 0; i < _countof(symbol_names); i++) {
+			symbol_names[i] = os::GetTempFilePathName();
+			FileStream stream;
+			ASSERT_TRUE(stream.Open(symbol_names[i].c_str(), fmCreate | fmOpenWrite | fmShareDenyNone));
+			std::vector<uint8_t> symbol_data(0x100, static_cast<uint8_t>(i));
+			ASSERT_EQ(stream.Write(symbol_data.data(), symbol_data.size()), symbol_data.size());
+			stream.Close();
+			AnalysisCache symbol_cache(&dst, std::vector<std::string>(1, symbol_names[i]));
+			key_list[i] = symbol_cache.file_name();
+			EXPECT_TRUE(os::FileDelete(symbol_names[i].c_str()));
+		}
+		EXPECT_NE(key_list[0], key_list[1]);
+	}
+
+	// Test: the least recently used entries are removed when the cache exceeds its size, the entry just saved is kept.
+	uint64_t entry_size;
+	{
+		FileStream stream;
+		ASSERT_TRUE(stream.Open(cache.file_name().c_str(), fmOpenRead | fmShareDenyNone));
+		entry_size = stream.Size();
+	}
+	std::vector<uint8_t> dummy(0x1000);
+	const char *dummy_names[] = {"0.cache", "1.cache"};
+	for (i = 0; i < _countof(dummy_names); i++) {
+		FileStream stream;
+		ASSERT_TRUE(stream.Open(os::CombinePaths(AnalysisCache::directory().c_str(), dummy_names[i]).c_str(), fmCreate | fmOpenWrite | fmShareDenyNone));
+		ASSERT_EQ(stream.Write(dummy.data(), dummy.size()), dummy.size());
+	}
+	uint64_t max_size = AnalysisCache::max_size();
+	AnalysisCache::set_max_size(entry_size + dummy.size());
+	cache.Save();
+	AnalysisCache::set_max_size(max_size);
+	EXPECT_FALSE(os::FileExists(os::CombinePaths(AnalysisCache::directory().c_str(), dummy_names[0]).c_str()));
+	EXPECT_TRUE(os::FileExists(os::CombinePaths(AnalysisCache::directory().c_str(), dummy_names[1]).c_str()));
+	EXPECT_TRUE(os::FileExists(cache.file_name().c_str()));
+
+	// Test: a zero size disables the cache.
+	AnalysisCache::set_max_size(0);
+	AnalysisCache disabled_cache(&dst, file_list);
+	AnalysisCache::set_max_size(max_size);
+	EXPECT_TRUE(disabled_cache.file_name().empty());
+	EXPECT_FALSE(disabled_cache.Load());
+}
+
+TEST(PEFileTest, AnalysisCache)
+{
+	// entries of the test go to a temporary directory instead of the application data directory
+	std::string directory = os::GetTempFilePathName();
+	ASSERT_FALSE(directory.empty());
+	os::FileDelete(directory.c_str());
+	AnalysisCache::set_directory(directory);
+
+	TestAnalysisCache();
+
+	std::vector<std::string> file_list = os::FindFiles(directory.c_str(), "*.cache");
+	for (size_t i = 0; i < file_list.size(); i++) {
+		EXPECT_TRUE(os::FileDelete(file_list[i].c_str()));
+	}
+	EXPECT_TRUE(os::DirectoryDelete(directory.c_str()));
+	AnalysisCache::set_directory(std::string());
+}
+
 TEST(PEFileTest, Runtime_x32)
 {
 	PEFile file(NULL);
@@ -419,6 +546,108 @@ TEST(PEFileTest, CalcCheckSum)
 	EXPECT_EQ(sum, 0x0000b8c9ul);
 }
 
+/**
+ * Writes a MSF 7.00 file, pages of every stream are placed in the reverse order.
+ */
+static bool WritePDB(const char *file_name, const std::vector<std::vector<uint8_t> > &streams)
+{
+	const uint32_t block_size = 0x1000;
+	size_t i, j;
+
+	std::vector<uint32_t> toc;
+	toc.push_back(static_cast<uint32_t>(streams.size()));
+	for (i = 0; i < streams.size(); i++) {
+		toc.push_back(static_cast<uint32_t>(streams[i].size()));
+	}
+	uint32_t page = 2; // the header and the list of TOC pages
+	for (i = 0; i < streams.size(); i++) {
+		uint32_t block_count = static_cast<uint32_t>((streams[i].size() + block_size - 1) / block_size);
+		for (j = 0; j < block_count; j++) {
+			toc.push_back(page + block_count - 1 - static_cast<uint32_t>(j));
+		}
+		page += block_count;
+	}
+	uint32_t toc_size = static_cast<uint32_t>(toc.size() * sizeof(uint32_t));
+	uint32_t toc_page = page;
+	page += (toc_size + block_size - 1) / block_size;
+
+	std::vector<uint8_t> image(page * block_size);
+	const char signature[] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS";
+	memcpy(&image[0], signature, sizeof(signature));
+	uint32_t *header = reinterpret_cast<uint32_t *>(&image[32]);
+	header[0] = block_size;
+	header[2] = page;
+	header[3] = toc_size;
+	header[5] = 1;
+	uint32_t *toc_pages = reinterpret_cast<uint32_t *>(&image[block_size]);
+	for (i = 0; i < (toc_size + block_size - 1) / block_size; i++) {
+		toc_pages[i] = toc_page + static_cast<uint32_t>(i);
+	}
+	memcpy(&image[toc_page * block_size], toc.data(), toc_size);
+
+	const uint32_t *block_list = toc.data() + 1 + streams.size();
+	for (i = 0; i < streams.size(); i++) {
+		for (j = 0; j < streams[i].size(); j += block_size) {
+			memcpy(&image[*block_list++ * block_size], &streams[i][j], std::min<size_t>(block_size, streams[i].size() - j));
+		}
+	}
+
+	FileStream fs;
+	return fs.Open(file_name, fmCreate | fmOpenWrite) && fs.Write(image.data(), image.size()) == image.size();
+}
+
+TEST(PDBFileTest, SyntheticPublics)
+{
+	const size_t symbol_count = 500000;
+	size_t i;
+
+	std::vector<std::vector<uint8_t> > streams(5);
+	// PDB_STREAM_PDB: version, time stamp, age, guid, names
+	streams[1].resize(32);
+	reinterpret_cast<uint32_t *>(streams[1].data())[0] = 20000404;
+	// PDB_STREAM_TPI without types
+	streams[2].resize(56);
+	reinterpret_cast<uint32_t *>(streams[2].data())[0] = 20040203;
+	reinterpret_cast<uint32_t *>(streams[2].data())[1] = 56;
+	// PDB_STREAM_DBI without modules, the global symbols are in the stream 4
+	streams[3].resize(64);
+	reinterpret_cast<uint32_t *>(streams[3].data())[0] = 0xffffffff;
+	reinterpret_cast<uint32_t *>(streams[3].data())[1] = 19990903;
+	reinterpret_cast<uint16_t *>(streams[3].data())[10] = 4;
+	// S_PUB_V3 records, most of pages end in the middle of a record
+	for (i = 0; i < symbol_count; i++) {
+		std::string name = string_format("public_symbol_%d", static_cast<int>(i));
+		size_t pos = streams[4].size();
+		size_t size = (14 + name.size() + 1 + 3) & ~3;
+		streams[4].resize(pos + size);
+		uint8_t *record = &streams[4][pos];
+		*reinterpret_cast<uint16_t *>(record) = static_cast<uint16_t>(size - 2);
+		*reinterpret_cast<uint16_t *>(record + 2) = 0x110e;
+		*reinterpret_cast<uint32_t *>(record + 8) = static_cast<uint32_t>(i * 0x10);
+		*reinterpret_cast<uint16_t *>(record + 12) = 1;
+		memcpy(record + 14, name.c_str(), name.size());
+	}
+
+	std::string file_name = os::GetTempFilePathName();
+	ASSERT_TRUE(WritePDB(file_name.c_str(), streams));
+	streams.clear();
+
+	std::vector<uint64_t> segments;
+	segments.push_back(0);
+	segments.push_back(0x401000);
+	PDBFile pdb_file;
+	bool res = pdb_file.Parse(file_name.c_str(), segments);
+	os::FileDelete(file_name.c_str());
+	ASSERT_TRUE(res);
+
+	MapSection *section = pdb_file.GetSectionByType(msFunctions);
+	ASSERT_TRUE(section != NULL);
+	ASSERT_EQ(section->count(), symbol_count);
+	EXPECT_EQ(section->item(0)->name(), "public_symbol_0");
+	EXPECT_EQ(section->item(symbol_count - 1)->name(), string_format("public_symbol_%d", static_cast<int>(symbol_count - 1)));
+	EXPECT_EQ(section->item(symbol_count - 1)->address(), 0x401000 + (symbol_count - 1) * 0x10);
+}
+
 #ifndef DEMO
 #ifndef __APPLE__
 static bool execFile(const std::string &fileName, DWORD &exitCode)